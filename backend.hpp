@@ -0,0 +1,136 @@
+/// Defines backends, which are the different ways a player can make a sound.
+
+// See note.hpp for an explanation of header guards.
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+// Players work out which note should sound when, and a backend makes the sound. Keeping the two apart means the same
+// player can play on the Arduino's tone(), on a hardware timer, on several pins at once, or (on a computer) into a
+// recording or a sound file (see host/host_backends.hpp). A backend can be any type with these member functions:
+//
+//   void play(uint16_t frequency, unsigned long duration);  // Plays frequency (at least 31 Hz) for duration
+//                                                           // milliseconds, or until stop() if duration is 0.
+//   void stop();                                            // Stops the sound.
+//
+// Like the sources of a StreamPlayer (see stream_player.hpp), backends are template parameters rather than classes with
+// virtual functions. The compiler knows exactly which play() to call, so it can inline it: playing on a ToneBackend
+// compiles to the very same tone() call the players used to make, without looking a function up every time.
+//
+// A player keeps its own copy of its backend, so backends hold where to play (pins) rather than what's playing.
+//
+// These are the backends the Arduino has:
+//
+//   * ToneBackend calls tone() on any pin. tone() uses Timer2, whose interrupt flips the pin in software twice per wave.
+//   * TimerBackend uses Timer1 to flip pin 9 (OC1A) in hardware, so the wave never wobbles even while other interrupts
+//     run, and its 16-bit count gets high notes closer to the right frequency than 8-bit Timer2. Its interrupt only
+//     counts waves, to end the note on time.
+//   * BitBangBackend flips several pins at once from the Timer1 interrupt. A piezo buzzer wired between two pins played
+//     in opposite phase (one high while the other is low) gets twice the voltage across it, so it's louder, and
+//     several buzzers on their own pins can play in unison.
+//
+// TimerBackend and BitBangBackend share Timer1, so only one of them plays at a time, and neither can be used with a
+// PwmBuzzer (see envelope.hpp) or the Servo library. They need an ATmega328P (Arduino Uno, Nano, and Pro Mini), like
+// PwmBuzzer. On other boards (and on a computer) they fall back to tone() on their first pin, so the same sketch still
+// works.
+//
+// The Timer1 interrupt is defined in backend.ino, and only one piece of code in a sketch can define it. The Servo
+// library defines it too, so if it were always there, every sketch that #includes Servo.h would stop compiling, even
+// one that only ever plays on a ToneBackend. So TimerBackend and BitBangBackend are opt-in: a sketch that wants them
+// puts
+//
+//   #define USE_TIMER1_BACKENDS
+//
+// at the very top of its main .ino file, before any #include. The Arduino IDE joins the .ino files together with the
+// main one first, so backend.ino sees it too. Without it, they fall back to tone() as on other boards, and Timer1 is
+// left alone.
+
+#if defined(__AVR_ATmega328P__) && defined(USE_TIMER1_BACKENDS)
+#define BACKEND_HARDWARE 1
+#else
+#define BACKEND_HARDWARE 0
+#endif
+
+/// The pin a TimerBackend plays on (OC1A, the output of Timer1).
+const uint8_t TIMER_BACKEND_PIN = 9;
+/// The most pins a BitBangBackend can play on.
+const uint8_t BITBANG_MAX_PINS = 4;
+
+/// Plays notes with tone().
+struct ToneBackend {
+
+  // This constructor isn't explicit, so a pin number can be passed wherever a ToneBackend is expected. That keeps the
+  // players' old constructors, like StreamPlayer<Source>(source, BUZZER_PIN), working as they did.
+  /// Constructs a backend that plays on the given pin.
+  ToneBackend(uint8_t pin) : m_pin(pin) {}
+
+  /// Plays the given frequency for the given duration in milliseconds (0 plays until stop()).
+  void play(uint16_t frequency, unsigned long duration) { tone(m_pin, frequency, duration); }
+
+  /// Stops the sound.
+  void stop() { noTone(m_pin); }
+
+private:
+
+  uint8_t m_pin;
+
+};
+
+/// Plays notes on TIMER_BACKEND_PIN with Timer1 flipping the pin in hardware.
+struct TimerBackend {
+
+  /// Plays the given frequency for the given duration in milliseconds (0 plays until stop()).
+  void play(uint16_t frequency, unsigned long duration);
+
+  /// Stops the sound.
+  void stop();
+
+};
+
+/// Plays notes on several pins at once, flipping them from the Timer1 interrupt.
+struct BitBangBackend {
+
+  // The pins aren't copied, so the array has to stay alive as long as the backend.
+  /// Constructs a backend that plays on count pins (up to BITBANG_MAX_PINS). The pins whose bits are set in inverted
+  /// (bit 0 for the first pin) are high whenever the others are low.
+  BitBangBackend(const uint8_t* pins, uint8_t count, uint8_t inverted = 0);
+
+  /// Plays the given frequency for the given duration in milliseconds (0 plays until stop()).
+  void play(uint16_t frequency, unsigned long duration);
+
+  /// Stops the sound.
+  void stop();
+
+  /// Flips every pin. The Timer1 interrupt calls this twice per wave.
+  void toggle();
+
+  /// Sets every pin low, so no current flows through the buzzers between notes.
+  void silence();
+
+private:
+
+  const uint8_t* m_pins;
+  uint8_t m_count;
+  uint8_t m_inverted;
+#if BACKEND_HARDWARE
+  // digitalWrite() looks up which port (a register of 8 pins) and which bit of it a pin is on every time, which is far
+  // too slow for an interrupt that runs thousands of times per second. The constructor looks them up once, and pins on
+  // the same port share one entry, so they flip with a single write at exactly the same moment.
+  volatile uint8_t* m_ports[BITBANG_MAX_PINS];
+  uint8_t m_masks[BITBANG_MAX_PINS];
+  uint8_t m_portCount;
+#endif
+
+};
+
+// The play() and stop() time is what a player spends on each note. The CPU time is what the backend's interrupt takes
+// from everything else while a note plays, worked out from how much slower a busy loop runs during a 4000 Hz note.
+/// Plays and stops notes runs times on the given backend, then plays one long note, and prints how many clock cycles
+/// play() and stop() took and how much of the CPU the note took.
+template <typename Backend>
+void benchmarkBackend(const char* label, Backend& backend, uint16_t runs);
+
+/// Runs benchmarkBackend() on a ToneBackend on tonePin, a TimerBackend, and a BitBangBackend on bitBangCount pins, with
+/// every other one inverted. Without USE_TIMER1_BACKENDS, the last two play on tone() too.
+void benchmarkBackends(uint8_t tonePin, const uint8_t* bitBangPins, uint8_t bitBangCount, uint16_t runs);
+
+#endif /* BACKEND_HPP */
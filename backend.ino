@@ -0,0 +1,200 @@
+// Implementations for the things declared in backend.hpp. See melody.ino for an explanation of why they're separated.
+#include "backend.hpp"
+
+#if BACKEND_HARDWARE
+// How many more times the Timer1 interrupt flips the pins before the note ends, or 0 if it plays until stop(). It's
+// volatile because the interrupt changes it.
+volatile unsigned long timer1TogglesLeft = 0;
+// The BitBangBackend whose pins the interrupt flips, or nullptr for a TimerBackend, whose pin the timer flips itself.
+BitBangBackend* volatile timer1BitBang = nullptr;
+
+/// Turns Timer1 and its interrupt off and sets the pins it was playing on low.
+void stopTimer1() {
+  TIMSK1 &= ~_BV(OCIE1A);
+  TCCR1B = 0;
+  // Without COM1A0, pin 9 goes back to being an ordinary output, which play() set low.
+  TCCR1A = 0;
+  BitBangBackend* bitBang = timer1BitBang;
+  if (bitBang != nullptr) {
+    bitBang->silence();
+  }
+}
+
+/// Starts Timer1 flipping twice per wave of the given frequency, for the given duration in milliseconds (0 for ever).
+/// Interrupts must be off.
+void startTimer1(uint16_t frequency, unsigned long duration, bool connectPin) {
+  if (frequency < 31) {
+    frequency = 31;
+  }
+  // Two flips per wave. A note always flips at least once, so a very short one doesn't play for ever.
+  unsigned long toggles = (unsigned long)frequency * duration / 500;
+  timer1TogglesLeft = duration > 0 && toggles == 0 ? 1 : toggles;
+  // Mode 4 ("clear timer on compare match", WGM12) counts from 0 up to OCR1A and starts over, and the prescaler of 8
+  // (CS11) makes it count 2 million times per second. Counting to OCR1A takes half a wave, so OCR1A is
+  // F_CPU / 8 / 2 / frequency - 1: 32257 for 31 Hz, which fits in its 16 bits. COM1A0 flips pin 9 on every match.
+  TCCR1A = connectPin ? _BV(COM1A0) : 0;
+  TCCR1B = _BV(WGM12) | _BV(CS11);
+  OCR1A = F_CPU / 16 / frequency - 1;
+  TCNT1 = 0;
+  TIMSK1 |= _BV(OCIE1A);
+}
+
+// TIMER1_COMPA_vect is the interrupt for Timer1 reaching OCR1A.
+ISR(TIMER1_COMPA_vect) {
+  BitBangBackend* bitBang = timer1BitBang;
+  if (bitBang != nullptr) {
+    bitBang->toggle();
+  }
+  if (timer1TogglesLeft > 0 && --timer1TogglesLeft == 0) {
+    stopTimer1();
+  }
+}
+#endif
+
+void TimerBackend::play(uint16_t frequency, unsigned long duration) {
+#if BACKEND_HARDWARE
+  pinMode(TIMER_BACKEND_PIN, OUTPUT);
+  digitalWrite(TIMER_BACKEND_PIN, LOW);
+  // The interrupt mustn't see the timer half set up, or a BitBangBackend that's no longer playing.
+  noInterrupts();
+  timer1BitBang = nullptr;
+  startTimer1(frequency, duration, true);
+  interrupts();
+#else
+  tone(TIMER_BACKEND_PIN, frequency, duration);
+#endif
+}
+
+void TimerBackend::stop() {
+#if BACKEND_HARDWARE
+  noInterrupts();
+  stopTimer1();
+  interrupts();
+#else
+  noTone(TIMER_BACKEND_PIN);
+#endif
+}
+
+BitBangBackend::BitBangBackend(const uint8_t* pins, uint8_t count, uint8_t inverted)
+  : m_pins(pins), m_count(count < BITBANG_MAX_PINS ? count : BITBANG_MAX_PINS), m_inverted(inverted) {
+#if BACKEND_HARDWARE
+  m_portCount = 0;
+  for (uint8_t pin = 0; pin < m_count; pin++) {
+    // These are the same lookups digitalWrite() does.
+    volatile uint8_t* port = portOutputRegister(digitalPinToPort(m_pins[pin]));
+    uint8_t mask = digitalPinToBitMask(m_pins[pin]);
+    uint8_t entry = 0;
+    while (entry < m_portCount && m_ports[entry] != port) {
+      entry++;
+    }
+    if (entry == m_portCount) {
+      m_ports[m_portCount] = port;
+      m_masks[m_portCount++] = 0;
+    }
+    m_masks[entry] |= mask;
+  }
+#endif
+}
+
+void BitBangBackend::play(uint16_t frequency, unsigned long duration) {
+  if (m_count == 0) {
+    return;
+  }
+#if BACKEND_HARDWARE
+  noInterrupts();
+  // Each pin starts on its side of the wave, and since every flip flips all of them, they stay that way.
+  for (uint8_t pin = 0; pin < m_count; pin++) {
+    pinMode(m_pins[pin], OUTPUT);
+    digitalWrite(m_pins[pin], (m_inverted >> pin) & 1 ? HIGH : LOW);
+  }
+  timer1BitBang = this;
+  startTimer1(frequency, duration, false);
+  interrupts();
+#else
+  tone(m_pins[0], frequency, duration);
+#endif
+}
+
+void BitBangBackend::stop() {
+  if (m_count == 0) {
+    return;
+  }
+#if BACKEND_HARDWARE
+  noInterrupts();
+  // Only if this backend is the one playing: stopping it mustn't cut off a TimerBackend.
+  if (timer1BitBang == this) {
+    stopTimer1();
+  }
+  interrupts();
+#else
+  noTone(m_pins[0]);
+#endif
+}
+
+void BitBangBackend::toggle() {
+#if BACKEND_HARDWARE
+  // ^= flips exactly the bits that are set in the mask and leaves the other pins of the port alone.
+  for (uint8_t entry = 0; entry < m_portCount; entry++) {
+    *m_ports[entry] ^= m_masks[entry];
+  }
+#endif
+}
+
+void BitBangBackend::silence() {
+#if BACKEND_HARDWARE
+  for (uint8_t entry = 0; entry < m_portCount; entry++) {
+    *m_ports[entry] &= ~m_masks[entry];
+  }
+#endif
+}
+
+/// Returns how many times an empty loop runs in the given number of microseconds. Interrupts that happen meanwhile
+/// take time away from the loop, so it runs fewer times.
+unsigned long countSpins(unsigned long length) {
+  // volatile stops the compiler from working out the loop's result without running it.
+  volatile unsigned long spins = 0;
+  unsigned long start = micros();
+  while (micros() - start < length) {
+    spins++;
+  }
+  return spins;
+}
+
+template <typename Backend>
+void benchmarkBackend(const char* label, Backend& backend, uint16_t runs) {
+  if (runs == 0) {
+    return;
+  }
+  const unsigned long SPIN_LENGTH = 100000UL;
+  unsigned long start = micros();
+  for (uint16_t run = 0; run < runs; run++) {
+    // A different frequency every time, so that nothing can be skipped for being the same as last time.
+    backend.play(400 + (run & 63) * 50, 1000);
+    backend.stop();
+  }
+  unsigned long elapsed = micros() - start;
+  unsigned long quiet = countSpins(SPIN_LENGTH);
+  backend.play(4000, 0);
+  unsigned long playing = countSpins(SPIN_LENGTH);
+  backend.stop();
+  Serial.print(label);
+  Serial.print(": ");
+  Serial.print(elapsed * clockCyclesPerMicrosecond() / runs);
+  Serial.print(" cycles per play() + stop(), ");
+  // The share of the loop's time the interrupt took, in tenths of a percent, so that it's a whole number.
+  unsigned long tenths = quiet > playing ? (quiet - playing) * 1000UL / quiet : 0;
+  Serial.print(tenths / 10);
+  Serial.print(".");
+  Serial.print(tenths % 10);
+  Serial.println("% of the CPU while playing 4000 Hz");
+}
+
+void benchmarkBackends(uint8_t tonePin, const uint8_t* bitBangPins, uint8_t bitBangCount, uint16_t runs) {
+  ToneBackend toneBackend(tonePin);
+  benchmarkBackend("ToneBackend", toneBackend, runs);
+  TimerBackend timerBackend;
+  benchmarkBackend("TimerBackend", timerBackend, runs);
+  // 0b1010 inverts the second and fourth pins, so pins 1 and 2 (and 3 and 4) are pairs in opposite phase.
+  BitBangBackend bitBangBackend(bitBangPins, bitBangCount, 0b1010);
+  benchmarkBackend("BitBangBackend", bitBangBackend, runs);
+}
@@ -0,0 +1,136 @@
+/// Defines a tiny virtual machine that plays melodies written as bytecode: a list of instructions instead of notes.
+
+// See note.hpp for an explanation of header guards.
+#ifndef BYTECODE_HPP
+#define BYTECODE_HPP
+
+#include "note.hpp"
+#include "tuning.hpp"
+
+// A Melody is a plain list of notes, which can't say "speed up here", "play this part three times", or "play the
+// chorus again, but higher". Bytecode can. It's a list of instructions, each one byte saying what to do (the opcode)
+// followed by the numbers it needs (its operands). A virtual machine (VM) is a small program that reads the
+// instructions one at a time and does what they say, like a very simple processor.
+//
+// Times are counted in ticks instead of milliseconds: there are BYTECODE_TICKS_PER_QUARTER ticks in a quarter note, and
+// the TEMPO instruction decides how long a quarter note is. Changing the tempo therefore changes the speed of
+// everything after it without changing any notes.
+//
+// melody_creator has an assembler that turns readable instructions (like "note C4 48 40") into bytecode, and a
+// disassembler that turns bytecode back into readable instructions (see melody_creator/melody_creator/bytecode.py).
+//
+//   Opcode          Operands                       What it does
+//   0 END                                          Stops the melody.
+//   1 NOTE          pitch, length, sound           Plays a MIDI note number (see tuning.hpp) for sound ticks, and
+//                                                  moves on by length ticks. All three are 1 byte.
+//   2 REST          length                         Moves on by length ticks (1 byte) without playing anything.
+//   3 TEMPO         beats per minute               Sets how many quarter notes are played per minute (1 byte).
+//   4 TRANSPOSE     semitones                      Adds semitones (1 signed byte) to the pitch of every later note.
+//   5 CALL          address                        Plays the instructions at address (2 bytes, little-endian) until a
+//                                                  RETURN, then carries on after the CALL. The transposition is
+//                                                  restored on RETURN.
+//   6 RETURN                                       Goes back to just after the latest CALL.
+//   7 LOOP          count                          Plays the instructions up to the matching END_LOOP count times (1
+//                                                  byte). Loops can be nested.
+//   8 END_LOOP                                     Marks the end of a LOOP.
+//   9 JUMP          address                        Carries on at address (2 bytes, little-endian).
+
+/// The opcodes of the instructions, in the order they appear in the dispatch table.
+enum BytecodeOpcode : uint8_t {
+  OP_END, OP_NOTE, OP_REST, OP_TEMPO, OP_TRANSPOSE, OP_CALL, OP_RETURN, OP_LOOP, OP_END_LOOP, OP_JUMP,
+  // Not an opcode: the number of opcodes.
+  OPCODE_COUNT
+};
+
+/// The number of ticks in a quarter note.
+const uint8_t BYTECODE_TICKS_PER_QUARTER = 48;
+
+/// The most CALLs and LOOPs that can be in progress at once.
+const uint8_t BYTECODE_STACK_DEPTH = 8;
+
+/// Runs bytecode and produces the notes it plays. Can be used as a source for StreamPlayer (see stream_player.hpp).
+struct BytecodeMachine {
+
+  /// Constructs a machine that runs the given bytecode, which is size bytes long.
+  BytecodeMachine(const uint8_t* code, uint16_t size);
+
+  /// Goes back to the first instruction, at 120 beats per minute with no transposition.
+  void rewind();
+
+  /// Runs instructions until one plays a note, and stores it in note. Returns false once the melody is over.
+  bool next(Note& note);
+
+  /// Returns the number of instructions run since the last rewind().
+  unsigned long instructionCount() const { return m_instructionCount; }
+
+private:
+
+  // What an instruction tells next() to do afterwards.
+  enum Result : uint8_t { CONTINUE, PLAYED_NOTE, STOP };
+
+  // Every instruction is carried out by a handler function. The handlers are kept in an array indexed by opcode (a
+  // dispatch table), so finding the handler for an instruction is a single array lookup instead of a long chain of ifs
+  // or a switch, and it takes the same time for every opcode.
+  typedef Result (*Handler)(BytecodeMachine& machine, Note& note);
+  static const Handler HANDLERS[OPCODE_COUNT];
+
+  static Result end(BytecodeMachine& machine, Note& note);
+  static Result playNote(BytecodeMachine& machine, Note& note);
+  static Result rest(BytecodeMachine& machine, Note& note);
+  static Result setTempo(BytecodeMachine& machine, Note& note);
+  static Result transpose(BytecodeMachine& machine, Note& note);
+  static Result call(BytecodeMachine& machine, Note& note);
+  static Result returnFromCall(BytecodeMachine& machine, Note& note);
+  static Result loop(BytecodeMachine& machine, Note& note);
+  static Result endLoop(BytecodeMachine& machine, Note& note);
+  static Result jump(BytecodeMachine& machine, Note& note);
+
+  // Reads the next operand and moves past it.
+  uint8_t readByte() { return m_position < m_size ? m_code[m_position++] : (uint8_t)OP_END; }
+  uint16_t readWord();
+
+  // Prints an error and stops the melody.
+  Result fail(const char* message);
+
+  // Sets the length of a tick for the given tempo (in quarter notes per minute).
+  void setTickLength(uint8_t beatsPerMinute);
+  // Converts a number of ticks into microseconds at the current tempo, rounded to the nearest microsecond.
+  unsigned long ticksToMicros(uint8_t ticks) const {
+    return ticks * m_microsPerTick + (((uint32_t)ticks * m_tickFraction + 0x8000) >> 16);
+  }
+  // Moves the time of the next note on by the given number of ticks, keeping the fraction of a microsecond.
+  void advance(uint8_t ticks);
+
+  // A CALL remembers where to return to and the transposition to restore. A LOOP remembers where its body starts and
+  // how many more times to play it.
+  struct Frame {
+    uint16_t position;
+    uint8_t remaining;
+    int8_t transpose;
+    bool isLoop;
+  };
+
+  const uint8_t* m_code;
+  uint16_t m_size;
+  uint16_t m_position;
+  Frame m_stack[BYTECODE_STACK_DEPTH];
+  uint8_t m_depth;
+  int8_t m_transpose;
+  // The length of a tick in whole microseconds, plus the fraction of a microsecond left over in 65536ths.
+  unsigned long m_microsPerTick;
+  uint16_t m_tickFraction;
+  // The time of the next note, in microseconds from the start of the melody, plus the fraction of a microsecond.
+  unsigned long m_time;
+  uint16_t m_timeFraction;
+  unsigned long m_instructionCount;
+
+};
+
+// Arduino boards count time in microseconds, but a clock cycle on a 16 MHz board is only 1/16 of a microsecond. The
+// benchmark gets around that by running each instruction thousands of times and dividing the total time by the number
+// of instructions run.
+/// Prints how many clock cycles each kind of instruction takes to run, on average, and the same for the given bytecode.
+/// Each program is run runs times.
+void benchmarkBytecode(const uint8_t* code, uint16_t size, uint16_t runs);
+
+#endif /* BYTECODE_HPP */
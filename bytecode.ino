@@ -0,0 +1,243 @@
+// Implementations for the things declared in bytecode.hpp. See melody.ino for an explanation of why they're separated.
+#include "bytecode.hpp"
+
+// The order must match BytecodeOpcode, since the opcode is the position in this array.
+const BytecodeMachine::Handler BytecodeMachine::HANDLERS[OPCODE_COUNT] = {
+  end, playNote, rest, setTempo, transpose, call, returnFromCall, loop, endLoop, jump
+};
+
+BytecodeMachine::BytecodeMachine(const uint8_t* code, uint16_t size) : m_code(code), m_size(size) {
+  rewind();
+}
+
+void BytecodeMachine::rewind() {
+  m_position = 0;
+  m_depth = 0;
+  m_transpose = 0;
+  setTickLength(120);
+  m_time = 0;
+  m_timeFraction = 0;
+  m_instructionCount = 0;
+}
+
+void BytecodeMachine::setTickLength(uint8_t beatsPerMinute) {
+  // A tick is rarely a whole number of microseconds: at 120 beats per minute it's 10416.67. Dropping the .67 on every
+  // tick would put a three-minute song more than 10 ms behind, so, like tickMultiplier() in ticks.hpp, the length keeps
+  // its fraction in 65536ths of a microsecond. At 1 beat per minute a tick is too long for the whole microseconds to
+  // fit in 16 bits, so the two parts are kept separately instead of in one 32-bit number. The remainder is less than
+  // ticksPerMinute (at most 12240), so shifting it by 16 fits in 32 bits.
+  unsigned long ticksPerMinute = (unsigned long)beatsPerMinute * BYTECODE_TICKS_PER_QUARTER;
+  m_microsPerTick = 60000000UL / ticksPerMinute;
+  m_tickFraction = ((60000000UL % ticksPerMinute) << 16) / ticksPerMinute;
+}
+
+void BytecodeMachine::advance(uint8_t ticks) {
+  // The fractions are added up and every whole microsecond they make is carried over into m_time, so no rounding
+  // builds up however many notes there are.
+  uint32_t fraction = m_timeFraction + (uint32_t)ticks * m_tickFraction;
+  m_time += ticks * m_microsPerTick + (fraction >> 16);
+  m_timeFraction = fraction & 0xFFFF;
+}
+
+bool BytecodeMachine::next(Note& note) {
+  while (true) {
+    uint8_t opcode = readByte();
+    m_instructionCount++;
+    if (opcode >= OPCODE_COUNT) {
+      fail("ERROR: Unknown bytecode opcode");
+      return false;
+    }
+    // This is the dispatch: look up the handler and call it.
+    Result result = HANDLERS[opcode](*this, note);
+    if (result != CONTINUE) {
+      return result == PLAYED_NOTE;
+    }
+  }
+}
+
+uint16_t BytecodeMachine::readWord() {
+  uint8_t low = readByte();
+  return low | (uint16_t)readByte() << 8;
+}
+
+BytecodeMachine::Result BytecodeMachine::fail(const char* message) {
+  Serial.println(message);
+  // Park at the end so that calling next() again keeps returning false.
+  m_position = m_size;
+  return STOP;
+}
+
+// The handlers below all take the note as an argument, even though only playNote() uses it, because every function in
+// a dispatch table must have the same parameters.
+
+BytecodeMachine::Result BytecodeMachine::end(BytecodeMachine& machine, Note&) {
+  // See fail().
+  machine.m_position = machine.m_size;
+  return STOP;
+}
+
+BytecodeMachine::Result BytecodeMachine::playNote(BytecodeMachine& machine, Note& note) {
+  uint8_t pitch = machine.readByte();
+  uint8_t length = machine.readByte();
+  uint8_t sound = machine.readByte();
+  // The offset keeps its fraction of a millisecond (see note.hpp). Adding 500 before dividing the duration by 1000
+  // rounds it to the nearest millisecond instead of always rounding down.
+  note = noteAtMicros(tunedFrequency(pitch + machine.m_transpose), machine.m_time,
+                      (machine.ticksToMicros(sound) + 500) / 1000);
+  machine.advance(length);
+  return PLAYED_NOTE;
+}
+
+BytecodeMachine::Result BytecodeMachine::rest(BytecodeMachine& machine, Note&) {
+  machine.advance(machine.readByte());
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::setTempo(BytecodeMachine& machine, Note&) {
+  uint8_t beatsPerMinute = machine.readByte();
+  if (beatsPerMinute == 0) {
+    return machine.fail("ERROR: Tempo of 0 beats per minute");
+  }
+  machine.setTickLength(beatsPerMinute);
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::transpose(BytecodeMachine& machine, Note&) {
+  machine.m_transpose += (int8_t)machine.readByte();
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::call(BytecodeMachine& machine, Note&) {
+  uint16_t address = machine.readWord();
+  if (machine.m_depth == BYTECODE_STACK_DEPTH) {
+    return machine.fail("ERROR: Bytecode calls and loops nested too deeply");
+  }
+  machine.m_stack[machine.m_depth++] = Frame{machine.m_position, 0, machine.m_transpose, false};
+  machine.m_position = address;
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::returnFromCall(BytecodeMachine& machine, Note&) {
+  if (machine.m_depth == 0 || machine.m_stack[machine.m_depth - 1].isLoop) {
+    return machine.fail("ERROR: RETURN without a CALL");
+  }
+  const Frame& frame = machine.m_stack[--machine.m_depth];
+  machine.m_position = frame.position;
+  machine.m_transpose = frame.transpose;
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::loop(BytecodeMachine& machine, Note&) {
+  uint8_t count = machine.readByte();
+  if (machine.m_depth == BYTECODE_STACK_DEPTH) {
+    return machine.fail("ERROR: Bytecode calls and loops nested too deeply");
+  }
+  // The body starts right after this instruction. The first time through is starting now, so count - 1 remain (a
+  // count of 0 plays the body once, like 1).
+  machine.m_stack[machine.m_depth++] = Frame{machine.m_position, (uint8_t)(count > 0 ? count - 1 : 0), 0, true};
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::endLoop(BytecodeMachine& machine, Note&) {
+  if (machine.m_depth == 0 || !machine.m_stack[machine.m_depth - 1].isLoop) {
+    return machine.fail("ERROR: END_LOOP without a LOOP");
+  }
+  Frame& frame = machine.m_stack[machine.m_depth - 1];
+  if (frame.remaining > 0) {
+    frame.remaining--;
+    machine.m_position = frame.position;
+  } else {
+    machine.m_depth--;
+  }
+  return CONTINUE;
+}
+
+BytecodeMachine::Result BytecodeMachine::jump(BytecodeMachine& machine, Note&) {
+  machine.m_position = machine.readWord();
+  return CONTINUE;
+}
+
+/// Runs the given bytecode runs times without playing it, and prints the average number of clock cycles per
+/// instruction after the given label.
+void benchmarkProgram(const char* label, const uint8_t* code, uint16_t size, uint16_t runs) {
+  BytecodeMachine machine(code, size);
+  Note note;
+  unsigned long instructions = 0;
+  unsigned long start = micros();
+  for (uint16_t run = 0; run < runs; run++) {
+    machine.rewind();
+    while (machine.next(note)) {}
+    instructions += machine.instructionCount();
+  }
+  unsigned long elapsed = micros() - start;
+  Serial.print(label);
+  Serial.print(": ");
+  Serial.print(instructions);
+  Serial.print(" instructions, ");
+  // Dividing last keeps the fractions of a cycle that dividing first would throw away.
+  Serial.print(instructions == 0 ? 0 : elapsed * clockCyclesPerMicrosecond() / instructions);
+  Serial.println(" cycles per instruction");
+}
+
+void benchmarkBytecode(const uint8_t* code, uint16_t size, uint16_t runs) {
+  // Each test program is mostly one kind of instruction, repeated REPEATS times.
+  const uint8_t REPEATS = 32;
+  uint8_t program[REPEATS * 4 + 2];
+  uint16_t length;
+
+  length = 0;
+  for (uint8_t i = 0; i < REPEATS; i++) {
+    program[length++] = OP_NOTE;
+    program[length++] = 60;
+    program[length++] = 12;
+    program[length++] = 10;
+  }
+  program[length++] = OP_END;
+  benchmarkProgram("NOTE", program, length, runs);
+
+  // REST, TEMPO, and TRANSPOSE all have one 1-byte operand.
+  const uint8_t oneOperand[][2] = {{OP_REST, 12}, {OP_TEMPO, 120}, {OP_TRANSPOSE, 1}};
+  const char* const labels[] = {"REST", "TEMPO", "TRANSPOSE"};
+  for (uint8_t kind = 0; kind < 3; kind++) {
+    length = 0;
+    for (uint8_t i = 0; i < REPEATS; i++) {
+      program[length++] = oneOperand[kind][0];
+      program[length++] = oneOperand[kind][1];
+    }
+    program[length++] = OP_END;
+    benchmarkProgram(labels[kind], program, length, runs);
+  }
+
+  // Every JUMP jumps to the instruction right after it.
+  length = 0;
+  for (uint8_t i = 0; i < REPEATS; i++) {
+    uint16_t nextInstruction = length + 3;
+    program[length++] = OP_JUMP;
+    program[length++] = (uint8_t)nextInstruction;
+    program[length++] = (uint8_t)(nextInstruction >> 8);
+  }
+  program[length++] = OP_END;
+  benchmarkProgram("JUMP", program, length, runs);
+
+  // Every CALL calls a RETURN at the end of the program, so half of the instructions are CALLs and half are RETURNs.
+  uint16_t returnPosition = REPEATS * 3 + 1;
+  length = 0;
+  for (uint8_t i = 0; i < REPEATS; i++) {
+    program[length++] = OP_CALL;
+    program[length++] = (uint8_t)returnPosition;
+    program[length++] = (uint8_t)(returnPosition >> 8);
+  }
+  program[length++] = OP_END;
+  program[length++] = OP_RETURN;
+  benchmarkProgram("CALL + RETURN", program, length, runs);
+
+  // One LOOP whose body is just its END_LOOP, so almost every instruction is an END_LOOP.
+  length = 0;
+  program[length++] = OP_LOOP;
+  program[length++] = REPEATS;
+  program[length++] = OP_END_LOOP;
+  program[length++] = OP_END;
+  benchmarkProgram("LOOP + END_LOOP", program, length, runs);
+
+  benchmarkProgram("Song", code, size, runs);
+}
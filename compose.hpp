@@ -0,0 +1,159 @@
+/// Defines functions that build new melodies out of other ones while the program compiles.
+
+// See note.hpp for an explanation of header guards.
+#ifndef COMPOSE_HPP
+#define COMPOSE_HPP
+
+#include "melody.hpp"
+#include "pitches.hpp"
+
+// Every function here is constexpr, so when its result is stored in a constexpr variable and the melodies it's given
+// are constexpr too (like the ones in songs.hpp), the compiler works out every note of the new melody while compiling.
+// The Arduino only gets the finished notes, exactly as if they had been copied and pasted into songs.hpp by hand. The
+// functions can be combined, and "auto" lets the compiler work out how many notes the result has:
+//
+//   constexpr auto THRILLER_TWICE = repeat<2>(THRILLER);
+//   constexpr auto THRILLER_UP_A_FOURTH = transpose(THRILLER, 5);
+//   constexpr auto SLOW_THRILLER = timeStretch(THRILLER, 3, 2);
+//   constexpr auto MEDLEY = concat(THRILLER, timeStretch(transpose(THRILLER, -12), 1, 2));
+//
+// Each function passes Melody's constexpr constructor a Generator (see melody.hpp): a small struct that holds the
+// melodies it was given and works out the note at any index from them.
+//
+// A melody ends when its last note stops sounding, and that's where concat() and repeat() start the next one. To leave
+// a gap, use a longer melody or timeStretch() the first one's notes apart.
+
+// If a new melody doesn't fit in a Note (see note.hpp), one of these is called. They aren't constexpr, so the compiler
+// stops and prints something like "call to non-constexpr function 'unsigned long long composeErrorMelodyTooLong()'".
+// They're never defined because they're never actually called.
+unsigned long long composeErrorMelodyTooLong();
+unsigned long long composeErrorNoteTooLong();
+unsigned long long composeErrorZeroDenominator();
+int composeErrorPitchOutOfRange();
+
+// Offsets here are in 256ths of a millisecond (see Note::m_offset). unsigned long long is big enough that adding and
+// multiplying them can't overflow before they're checked.
+/// Returns the given offset if it fits in a Note.
+constexpr unsigned long long checkedOffset(unsigned long long offset) {
+  return offset <= (MAX_NOTE_OFFSET << 8 | 0xFF) ? offset : composeErrorMelodyTooLong();
+}
+
+// Arduino.h defines max() in a way that doesn't work at compile time, so this is its own function.
+/// Returns the later of two times.
+constexpr unsigned long long later(unsigned long long a, unsigned long long b) { return a > b ? a : b; }
+
+/// Returns the time (in 256ths of a millisecond) at which the given note stops sounding.
+constexpr unsigned long long noteEnd(const Note& note) {
+  return note.fixedPointOffset() + (unsigned long long)note.duration() * 256;
+}
+
+// A constexpr function can't have loops, so this splits the notes in half and calls itself on each half, like
+// Melody::isSorted().
+/// Returns the time (in 256ths of a millisecond) at which the notes in [first, last) of a melody have all stopped.
+template <size_t N>
+constexpr unsigned long long melodyEnd(const Melody<N>& melody, size_t first = 0, size_t last = N) {
+  return last - first == 0 ? 0
+       : last - first == 1 ? noteEnd(melody[first])
+       : later(melodyEnd(melody, first, (first + last) / 2), melodyEnd(melody, (first + last) / 2, last));
+}
+
+/// Returns a copy of the note, starting shift (in 256ths of a millisecond) later.
+constexpr Note shiftNote(const Note& note, unsigned long long shift) {
+  return Note(FixedPointOffset(), note.frequency(), checkedOffset(note.fixedPointOffset() + shift), note.duration());
+}
+
+/// Generator for concat(): the notes of first, then the notes of second starting at secondStart.
+template <size_t A, size_t B>
+struct Concatenation {
+  const Melody<A>& first;
+  const Melody<B>& second;
+  unsigned long long secondStart;
+  constexpr Note note(size_t index) const {
+    return index < A ? first[index] : shiftNote(second[index - A], secondStart);
+  }
+};
+
+/// Returns a melody that plays first, then second as soon as first ends.
+template <size_t A, size_t B>
+constexpr Melody<A + B> concat(const Melody<A>& first, const Melody<B>& second) {
+  return Melody<A + B>(Concatenation<A, B>{first, second, melodyEnd(first)});
+}
+
+// % gives the remainder of a division, so index % N goes through the notes of the melody over and over, and index / N
+// counts how many times it has gone through them.
+/// Generator for repeat(): the notes of melody over and over, each time starting length later.
+template <size_t N>
+struct Repetition {
+  const Melody<N>& melody;
+  unsigned long long length;
+  constexpr Note note(size_t index) const { return shiftNote(melody[index % N], index / N * length); }
+};
+
+// Times comes first in the template, so it can be given while N is worked out from the melody: repeat<3>(THRILLER).
+/// Returns a melody that plays the given one Times times in a row.
+template <size_t Times, size_t N>
+constexpr Melody<Times * N> repeat(const Melody<N>& melody) {
+  return Melody<Times * N>(Repetition<N>{melody, melodyEnd(melody)});
+}
+
+/// Returns the given pitch if it's in the table in pitches.hpp.
+constexpr int checkedPitch(int pitch) {
+  return pitch >= LOWEST_PITCH && pitch <= HIGHEST_PITCH ? pitch : composeErrorPitchOutOfRange();
+}
+
+/// Generator for transpose(): the notes of melody, semitones higher (or lower, if it's negative).
+template <size_t N>
+struct Transposition {
+  const Melody<N>& melody;
+  int semitones;
+  constexpr Note note(size_t index) const {
+    return Note(FixedPointOffset(), pitchFrequency(checkedPitch(nearestPitch(melody[index].frequency()) + semitones)),
+                melody[index].fixedPointOffset(), melody[index].duration());
+  }
+};
+
+// Each frequency is turned into the nearest pitch in pitches.hpp, moved, and turned back into a frequency, so the
+// result is always in tune even though frequencies are rounded to whole Hertz. pitchFrequency() would quietly play
+// pitches moved past the ends of the table (B0 to D#8) at the nearest end instead, so that's an error here, like a
+// melody that gets too long.
+/// Returns a melody with every note moved the given number of semitones (12 is an octave) up, or down if negative.
+template <size_t N>
+constexpr Melody<N> transpose(const Melody<N>& melody, int semitones) {
+  return Melody<N>(Transposition<N>{melody, semitones});
+}
+
+// Adding half the denominator before dividing rounds to the nearest whole number instead of always down.
+/// Returns value * numerator / denominator, rounded.
+constexpr unsigned long long scaleTime(unsigned long long value, unsigned long numerator, unsigned long denominator) {
+  return denominator == 0 ? composeErrorZeroDenominator() : (value * numerator + denominator / 2) / denominator;
+}
+
+// Durations are checked against the largest unsigned int on an Arduino Uno (65535), where an int is only 16 bits.
+/// Returns the given duration (in milliseconds) if it fits in a Note.
+constexpr unsigned long long checkedDuration(unsigned long long duration) {
+  return duration <= 0xFFFF ? duration : composeErrorNoteTooLong();
+}
+
+/// Generator for timeStretch(): the notes of melody, with every offset and duration scaled by numerator / denominator.
+template <size_t N>
+struct Stretch {
+  const Melody<N>& melody;
+  unsigned long numerator;
+  unsigned long denominator;
+  constexpr Note note(size_t index) const {
+    return Note(FixedPointOffset(), melody[index].frequency(),
+                checkedOffset(scaleTime(melody[index].fixedPointOffset(), numerator, denominator)),
+                checkedDuration(scaleTime(melody[index].duration(), numerator, denominator)));
+  }
+};
+
+// The ratio is a fraction rather than a float so the result is exact, and so nothing here ever needs the Arduino's slow
+// floating point code. Scaling keeps the notes in order, so the result is still sorted.
+/// Returns a melody that takes numerator / denominator times as long to play: timeStretch(melody, 2) is half as fast,
+/// and timeStretch(melody, 2, 3) is one and a half times as fast.
+template <size_t N>
+constexpr Melody<N> timeStretch(const Melody<N>& melody, unsigned long numerator, unsigned long denominator = 1) {
+  return Melody<N>(Stretch<N>{melody, numerator, denominator});
+}
+
+#endif /* COMPOSE_HPP */
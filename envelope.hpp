@@ -0,0 +1,237 @@
+/// Defines volume envelopes and a player that uses them to give notes dynamics, an attack, and a decay.
+
+// See note.hpp for an explanation of header guards.
+#ifndef ENVELOPE_HPP
+#define ENVELOPE_HPP
+
+#include "melody.hpp"
+#include "modulation.hpp"
+
+// tone() always plays a square wave that's high half of the time and low the other half (a 50% "duty cycle"), so every
+// note is equally loud from start to end. A buzzer gets quieter as the duty cycle gets further from 50%: at 10% it's
+// pushed for only a tenth of each wave, so it barely moves. Changing the duty cycle while a note plays changes its
+// volume without changing its pitch, and that's how a PwmBuzzer works. It uses Timer1 of the Arduino instead of tone(),
+// with the frequency set by how far the timer counts (its "TOP") and the duty cycle by when the pin goes low.
+//
+// The volume of a note follows an ADSR envelope, like on most synthesizers:
+//
+//   volume
+//     255 |   /\                        Attack: rise to 255 when the note starts.
+//         |  /  \________________       Decay: fall to the sustain volume.
+//  sustain| /                    \      Sustain: stay there until the note ends.
+//         |/                      \     Release: fall to 0.
+//       0 +--------------------------- time
+//           A  D       S          R
+//
+// An EnvelopeGenerator works the envelope out one tick at a time, ENVELOPE_TICK_HZ times per second, from a Timer0
+// interrupt. An interrupt stops whatever the Arduino is doing, runs a short function, and carries on, so the volume is
+// updated on time no matter how busy loop() is. Each tick only adds a precomputed step to the volume: it's kept in
+// "fixed point", a whole number counting 256ths, so no slow floating point math (or division) is needed in the
+// interrupt. The loudest volume is scaled by the note's velocity (0 to 127, like in MIDI), which melody_creator works
+// out from dynamics markings like p and ff and prints as an array next to the melody. The same interrupt also bends the
+// pitch of notes that glide, bend, or have vibrato (see modulation.hpp).
+//
+// The Arduino already runs Timer0 for millis(), going around once every 256 counts (1.024 ms on a 16 MHz board), and
+// its "compare match A" interrupt happens once per time around whatever OCR0A is set to (analogWrite() on pin 6 sets
+// it), so the envelope only has to turn that interrupt on. That leaves Timer2 to tone(), which defines the Timer2
+// interrupt itself, so a sketch can't define it too. The Servo library uses Timer1, so it can't be used with a
+// PwmBuzzer. Only the ATmega328P (Arduino Uno, Nano, and Pro Mini) is supported, with the buzzer on pin 9. On other
+// boards, notes are played with tone() on that pin at full volume, and the envelope is ticked from update() instead of
+// an interrupt, so that the same sketch still works (and can be checked on a computer).
+
+#if defined(__AVR_ATmega328P__)
+#define ENVELOPE_HARDWARE 1
+#else
+#define ENVELOPE_HARDWARE 0
+#endif
+
+/// The pin the buzzer of a PwmBuzzer must be connected to (OC1A, the output of Timer1).
+const uint8_t PWM_BUZZER_PIN = 9;
+// Timer0 counts F_CPU / 64 times per second, so it goes around F_CPU / 64 / 256 times per second: 976.5625 on a 16 MHz
+// board, which rounds down to 976. Envelopes and glides come out 0.06% slower than asked for, which nobody can hear.
+/// How many times per second envelopes are updated.
+const unsigned int ENVELOPE_TICK_HZ = F_CPU / 64 / 256;
+/// The velocity of notes that don't have one.
+const uint8_t DEFAULT_VELOCITY = 80;
+
+/// The shape of the volume of a note (see the picture above).
+struct Envelope {
+  /// How long the volume takes to rise from silent to full when a note starts, in milliseconds.
+  uint16_t attack;
+  /// How long it then takes to fall to the sustain volume, in milliseconds.
+  uint16_t decay;
+  /// The volume (0 to 255) held until the note ends.
+  uint8_t sustain;
+  /// How long the volume takes to fall to silent after the note ends, in milliseconds.
+  uint16_t release;
+};
+
+/// A short attack and a quick fall to a softer sustain, a bit like a plucked string.
+const Envelope DEFAULT_ENVELOPE = {5, 120, 150, 60};
+
+/// Works out the volume of a note one tick at a time.
+struct EnvelopeGenerator {
+
+  /// Constructs a silent generator.
+  EnvelopeGenerator();
+
+  // The volume rises from wherever it is, so a note that cuts off another one doesn't click.
+  /// Starts the attack of a note with the given envelope and velocity (0 to 127).
+  void noteOn(const Envelope& envelope, uint8_t velocity);
+
+  /// Starts the release of the note.
+  void noteOff();
+
+  /// Moves the envelope one tick forward and returns the new volume (0 to 255).
+  uint8_t tick();
+
+  /// Returns false once the release is over and the note is silent.
+  bool isActive() const { return m_stage != IDLE; }
+
+private:
+
+  // "enum" makes a type with a fixed list of named values, and ": uint8_t" makes it take only one byte.
+  enum Stage : uint8_t { IDLE, ATTACK, DECAY, SUSTAIN, RELEASE };
+
+  // Starts the given stage. Stages that take no time are skipped straight to their end.
+  void enterStage(Stage stage);
+
+  const Envelope* m_envelope;
+  Stage m_stage;
+  uint8_t m_velocity;
+  // The volume in 256ths, so that it can change by less than 1 per tick.
+  uint16_t m_level;
+  // How much m_level changes each tick, and how many ticks are left in the stage. The step can be as large as the
+  // whole range of m_level (when a stage takes one tick) and can be negative, so it needs a long.
+  long m_step;
+  uint16_t m_ticksLeft;
+  // Where m_level ends up at the end of the stage. It's set exactly at the end, so rounding in m_step never builds up.
+  uint8_t m_target;
+
+};
+
+/// Plays square waves on PWM_BUZZER_PIN with a volume that can change while they play.
+struct PwmBuzzer {
+
+  /// Constructs a silent buzzer. Call begin() before using it.
+  PwmBuzzer();
+
+  /// Sets up the pin and Timer1. Call it in setup().
+  void begin();
+
+  /// Starts playing the given frequency (at least 31 Hz) at the current volume.
+  void play(uint16_t frequency);
+
+  /// Changes the pitch of the note that's playing to the given period (see timerPeriodOf()) without starting it over.
+  void bend(uint16_t period);
+
+  /// Sets the volume (0 to 255). 0 is silent, and 255 is as loud as tone().
+  void setVolume(uint8_t volume);
+
+  /// Stops playing.
+  void stop();
+
+private:
+
+  uint16_t m_frequency;
+  // How far Timer1 counts for each wave (TOP), which is the period. The duty cycle is a fraction of it.
+  uint16_t m_top;
+  uint8_t m_volume;
+
+};
+
+// Like MelodyPlayer (see player.hpp), this is updated a step at a time and never blocks, so it can run as a Scheduler
+// task. It only plays one note at a time, and a new note cuts off the one before it (which then starts its attack from
+// the volume the old one was at).
+/// Plays a melody on a PwmBuzzer, shaping each note with an envelope and its velocity, and bending its pitch.
+struct EnvelopePlayer {
+
+  /// Constructs a new player that shapes every note with the given envelope and bends them with the given modulation.
+  explicit EnvelopePlayer(const Envelope& envelope = DEFAULT_ENVELOPE,
+                          const Modulation& modulation = DEFAULT_MODULATION);
+
+  /// Sets up the buzzer and the timer interrupt that updates the envelope. Call it in setup(). Only one EnvelopePlayer
+  /// can be set up at a time.
+  void begin();
+
+  // velocities is an array with one velocity for each note of the melody, in the same order, like the ones
+  // melody_creator prints with -d.
+  /// Starts playing the given melody with the given velocities. The first note plays at the given time (in
+  /// microseconds) plus its offset.
+  template <size_t N>
+  void start(const Melody<N>& melody, const uint8_t (&velocities)[N], unsigned long now) {
+    start(melody.cbegin(), melody.cend(), velocities, nullptr, now);
+  }
+
+  // expressions is an array of the expression flags of each note (see modulation.hpp), like the ones melody_creator
+  // prints with -e.
+  /// Starts playing the given melody with the given velocities and expressions.
+  template <size_t N>
+  void start(const Melody<N>& melody, const uint8_t (&velocities)[N], const uint8_t (&expressions)[N],
+             unsigned long now) {
+    start(melody.cbegin(), melody.cend(), velocities, expressions, now);
+  }
+
+  /// Starts playing the given melody with every note at DEFAULT_VELOCITY.
+  template <size_t N>
+  void start(const Melody<N>& melody, unsigned long now) {
+    start(melody.cbegin(), melody.cend(), nullptr, nullptr, now);
+  }
+
+  /// Starts playing the sorted notes in [first, last), with the given velocities (or DEFAULT_VELOCITY if nullptr) and
+  /// expressions (or none if nullptr).
+  void start(const Note* first, const Note* last, const uint8_t* velocities, const uint8_t* expressions,
+             unsigned long now);
+
+  /// Stops playback immediately, without a release.
+  void stop();
+
+  /// Returns true if the player still has notes to play (or a note to finish).
+  bool isPlaying() const { return m_playing; }
+
+  /// Plays whatever note is due. Returns false once the melody is over (including the release of the last note), or
+  /// true after storing the time (in microseconds) at which update() next needs to be called in nextEvent.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  /// A TaskFunction (see scheduler.hpp) that updates the EnvelopePlayer that context points to.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+  /// Moves the envelope and the pitch one tick forward and sets them on the buzzer. The timer interrupt calls this.
+  void tick();
+
+private:
+
+  unsigned long startOf(const Note& note) const { return m_startTime + note.offsetMicros(); }
+
+  Envelope m_envelope;
+  Modulation m_modulation;
+  EnvelopeGenerator m_generator;
+  Modulator m_modulator;
+  PwmBuzzer m_buzzer;
+  // The next note to play, its velocity (or nullptr if every note is at DEFAULT_VELOCITY), its expression (or nullptr
+  // if no note has any), and the end of the notes.
+  const Note* m_next;
+  const uint8_t* m_nextVelocity;
+  const uint8_t* m_nextExpression;
+  const Note* m_end;
+  unsigned long m_startTime;
+  bool m_playing;
+  // Whether a note is being held (its release hasn't started), and when it ends, in microseconds.
+  bool m_holding;
+  unsigned long m_holdEnd;
+  // "volatile" tells the compiler that the timer interrupt can change this at any moment, so it has to read it again
+  // every time instead of keeping an old copy. It's true once the release of the last note has finished.
+  volatile bool m_silent;
+  // When the envelope was last ticked, on boards where update() ticks it.
+  unsigned long m_lastTick;
+
+};
+
+// The interrupt updates the volume and the pitch of one voice, but a synthesizer with several voices would need an
+// envelope and a modulator for each, so this shows how many voices the Arduino could keep up with. Every modulator
+// glides, trills, and has vibrato, which is the most work a tick can take.
+/// Ticks the envelopes and modulators of the given number of voices (at most 8) ticks times, and prints how long a tick
+/// took per voice, in clock cycles, and how much of the Arduino's time they'd take at ENVELOPE_TICK_HZ.
+void benchmarkEnvelopes(uint8_t voices, uint16_t ticks);
+
+#endif /* ENVELOPE_HPP */
@@ -0,0 +1,333 @@
+// Implementations for the things declared in envelope.hpp. See melody.ino for an explanation of why they're separated.
+#include "envelope.hpp"
+
+EnvelopeGenerator::EnvelopeGenerator()
+  : m_envelope(nullptr), m_stage(IDLE), m_velocity(0), m_level(0), m_step(0), m_ticksLeft(0), m_target(0) {}
+
+void EnvelopeGenerator::noteOn(const Envelope& envelope, uint8_t velocity) {
+  m_envelope = &envelope;
+  m_velocity = velocity > 127 ? 127 : velocity;
+  enterStage(ATTACK);
+}
+
+void EnvelopeGenerator::noteOff() {
+  if (m_stage != IDLE) {
+    enterStage(RELEASE);
+  }
+}
+
+uint8_t EnvelopeGenerator::tick() {
+  if (m_stage == ATTACK || m_stage == DECAY || m_stage == RELEASE) {
+    m_ticksLeft--;
+    if (m_ticksLeft == 0) {
+      m_level = (uint16_t)m_target << 8;
+      enterStage(m_stage == ATTACK ? DECAY : m_stage == DECAY ? SUSTAIN : IDLE);
+    } else {
+      m_level += m_step;
+    }
+  }
+  // Multiplying by velocity * 2 (at most 254) and dividing by 256 (>> 8) scales the volume by the velocity without a
+  // slow division. Adding velocity >> 6 makes the loudest velocity (127) multiply by 255 instead, so it isn't lost.
+  return ((m_level >> 8) * (m_velocity * 2 + (m_velocity >> 6))) >> 8;
+}
+
+void EnvelopeGenerator::enterStage(Stage stage) {
+  // This loops instead of calling itself so that an envelope with no attack and no decay goes straight to its sustain.
+  while (stage != IDLE && stage != SUSTAIN) {
+    uint16_t length = stage == ATTACK ? m_envelope->attack : stage == DECAY ? m_envelope->decay : m_envelope->release;
+    uint8_t target = stage == ATTACK ? 255 : stage == DECAY ? m_envelope->sustain : 0;
+    uint16_t ticks = (unsigned long)length * ENVELOPE_TICK_HZ / 1000;
+    if (ticks > 0) {
+      m_stage = stage;
+      m_target = target;
+      m_ticksLeft = ticks;
+      // The one division per stage happens here, outside of tick().
+      m_step = (((long)target << 8) - (long)m_level) / (long)ticks;
+      return;
+    }
+    m_level = (uint16_t)target << 8;
+    stage = stage == ATTACK ? DECAY : stage == DECAY ? SUSTAIN : IDLE;
+  }
+  m_stage = stage;
+}
+
+PwmBuzzer::PwmBuzzer() : m_frequency(0), m_top(0), m_volume(0) {}
+
+void PwmBuzzer::begin() {
+  pinMode(PWM_BUZZER_PIN, OUTPUT);
+#if ENVELOPE_HARDWARE
+  // These are the registers that control Timer1 (see chapter 15 of the ATmega328P datasheet). Mode 14 ("fast PWM" with
+  // WGM11, WGM12, and WGM13 set) counts from 0 up to ICR1 and starts over, and the prescaler of 8 (CS11) makes it count
+  // 2 million times per second. The pin isn't connected to the timer until play() sets COM1A1.
+  TCCR1A = _BV(WGM11);
+  TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS11);
+#endif
+}
+
+void PwmBuzzer::play(uint16_t frequency) {
+  m_frequency = frequency < 31 ? 31 : frequency;
+  m_top = timerPeriodOf(m_frequency);
+#if ENVELOPE_HARDWARE
+  // Starting the count over stops it from running past a TOP that's lower than before, which would make it count all
+  // the way to 65535 first.
+  ICR1 = m_top;
+  TCNT1 = 0;
+  setVolume(m_volume);
+  // With COM1A1 set, the pin goes high when the count starts over and low when it reaches OCR1A.
+  TCCR1A = _BV(COM1A1) | _BV(WGM11);
+#else
+  if (m_volume > 0) {
+    tone(PWM_BUZZER_PIN, m_frequency);
+  }
+#endif
+}
+
+void PwmBuzzer::bend(uint16_t period) {
+  // Nothing changes if the period is the same (which it is on most ticks) or nothing is playing.
+  if (m_frequency == 0 || period == 0 || period == m_top) {
+    return;
+  }
+  m_top = period;
+#if ENVELOPE_HARDWARE
+  // Unlike in play(), the count carries on, so the wave doesn't jump. It only starts over if it's already past the new
+  // TOP.
+  ICR1 = m_top;
+  if (TCNT1 > m_top) {
+    TCNT1 = 0;
+  }
+  setVolume(m_volume);
+#else
+  // tone() needs a frequency, so the period is turned back into one. Boards without the interrupt aren't short on time.
+  uint16_t frequency = F_CPU / 8 / ((unsigned long)m_top + 1);
+  if (frequency != m_frequency) {
+    m_frequency = frequency;
+    if (m_volume > 0) {
+      tone(PWM_BUZZER_PIN, m_frequency);
+    }
+  }
+#endif
+}
+
+void PwmBuzzer::setVolume(uint8_t volume) {
+#if ENVELOPE_HARDWARE
+  // A volume of 255 makes the pin high for 255/512 of each wave, just under half, which is as loud as it gets.
+  OCR1A = ((unsigned long)m_top * volume) >> 9;
+#else
+  // tone() can only turn the sound on or off, so that's all that changes.
+  if (m_frequency > 0 && (volume > 0) != (m_volume > 0)) {
+    if (volume > 0) {
+      tone(PWM_BUZZER_PIN, m_frequency);
+    } else {
+      noTone(PWM_BUZZER_PIN);
+    }
+  }
+#endif
+  m_volume = volume;
+}
+
+void PwmBuzzer::stop() {
+#if ENVELOPE_HARDWARE
+  TCCR1A = _BV(WGM11);
+  digitalWrite(PWM_BUZZER_PIN, LOW);
+#else
+  if (m_frequency > 0 && m_volume > 0) {
+    noTone(PWM_BUZZER_PIN);
+  }
+#endif
+  m_frequency = 0;
+}
+
+#if ENVELOPE_HARDWARE
+// The player that the timer interrupt ticks. It's volatile because begin() sets it while the interrupt might be running.
+EnvelopePlayer* volatile envelopeTimerPlayer = nullptr;
+
+// ISR ("interrupt service routine") defines the function that runs when the interrupt happens. TIMER0_COMPA_vect is the
+// one for Timer0 reaching OCR0A.
+ISR(TIMER0_COMPA_vect) {
+  if (envelopeTimerPlayer != nullptr) {
+    envelopeTimerPlayer->tick();
+  }
+}
+#endif
+
+EnvelopePlayer::EnvelopePlayer(const Envelope& envelope, const Modulation& modulation)
+  : m_envelope(envelope), m_modulation(modulation), m_next(nullptr), m_nextVelocity(nullptr),
+    m_nextExpression(nullptr), m_end(nullptr), m_startTime(0), m_playing(false), m_holding(false), m_holdEnd(0),
+    m_silent(true), m_lastTick(0) {}
+
+void EnvelopePlayer::begin() {
+  m_buzzer.begin();
+#if ENVELOPE_HARDWARE
+  // noInterrupts() stops interrupts from happening until interrupts() is called, so that the interrupt never runs
+  // before the player is set.
+  noInterrupts();
+  envelopeTimerPlayer = this;
+  // Timer0 is already running (see the top of envelope.hpp), so OCIE0A only turns its compare match A interrupt on. The
+  // overflow interrupt millis() uses stays on too.
+  TIMSK0 |= _BV(OCIE0A);
+  interrupts();
+#endif
+}
+
+void EnvelopePlayer::start(const Note* first, const Note* last, const uint8_t* velocities, const uint8_t* expressions,
+                           unsigned long now) {
+  stop();
+  m_next = first;
+  m_nextVelocity = velocities;
+  m_nextExpression = expressions;
+  m_end = last;
+  m_startTime = now;
+  m_lastTick = now;
+  m_playing = first < last;
+}
+
+void EnvelopePlayer::stop() {
+  // The interrupt uses the generator and the buzzer too, so it has to wait while they change.
+  noInterrupts();
+  m_generator = EnvelopeGenerator();
+  m_modulator = Modulator();
+  m_buzzer.stop();
+  m_silent = true;
+  interrupts();
+  m_next = m_end;
+  m_playing = false;
+  m_holding = false;
+}
+
+bool EnvelopePlayer::update(unsigned long now, unsigned long& nextEvent) {
+  if (!m_playing) {
+    return false;
+  }
+  const unsigned long tickPeriod = 1000000UL / ENVELOPE_TICK_HZ;
+#if !ENVELOPE_HARDWARE
+  // Without the timer interrupt, the ticks that should have happened since the last update happen now.
+  while ((long)(now - (m_lastTick + tickPeriod)) >= 0) {
+    m_lastTick += tickPeriod;
+    tick();
+  }
+#endif
+  // As in MelodyPlayer::update(), only the last of several notes that are due at once is worth playing.
+  const Note* due = nullptr;
+  uint8_t velocity = DEFAULT_VELOCITY;
+  uint8_t expression = 0;
+  while (m_next < m_end && (long)(now - startOf(*m_next)) >= 0) {
+    due = m_next;
+    m_next++;
+    if (m_nextVelocity != nullptr) {
+      velocity = *m_nextVelocity;
+      m_nextVelocity++;
+    }
+    if (m_nextExpression != nullptr) {
+      expression = *m_nextExpression;
+      m_nextExpression++;
+    }
+  }
+  if (due != nullptr) {
+    // A note can only glide from a note that's still held (the notes of a slur end right as the next one starts). It
+    // carries on the sound of that note instead of starting over with a new attack, so it only changes the pitch.
+    bool glide = (expression & EXPRESSION_GLIDE) && m_holding;
+    if (!glide) {
+      expression &= ~EXPRESSION_GLIDE;
+    }
+    noInterrupts();
+    m_modulator.noteOn(m_modulation, due->frequency(), expression, due->duration());
+    if (!glide) {
+      m_buzzer.play(due->frequency());
+      m_generator.noteOn(m_envelope, velocity);
+    }
+    // A bend starts away from the note's own pitch.
+    m_buzzer.bend(m_modulator.period());
+    m_silent = false;
+    interrupts();
+    m_holding = true;
+    m_holdEnd = startOf(*due) + due->duration() * 1000UL;
+  }
+  if (m_holding && (long)(now - m_holdEnd) >= 0) {
+    noInterrupts();
+    m_generator.noteOff();
+    interrupts();
+    m_holding = false;
+  }
+
+  if (m_next < m_end) {
+    nextEvent = startOf(*m_next);
+    if (m_holding && (long)(m_holdEnd - nextEvent) < 0) {
+      nextEvent = m_holdEnd;
+    }
+  } else if (m_holding) {
+    nextEvent = m_holdEnd;
+  } else if (m_silent) {
+    m_buzzer.stop();
+    m_playing = false;
+    return false;
+  } else {
+    // The release of the last note is still going. It ends on a tick, so there's no need to check more often.
+    nextEvent = now + tickPeriod;
+  }
+#if !ENVELOPE_HARDWARE
+  // The envelope only moves when update() ticks it, so update() can't wait past the next tick while it's moving.
+  if (!m_silent && (long)(m_lastTick + tickPeriod - nextEvent) < 0) {
+    nextEvent = m_lastTick + tickPeriod;
+  }
+#endif
+  return true;
+}
+
+bool EnvelopePlayer::task(void* context, unsigned long now, unsigned long& nextRun) {
+  return static_cast<EnvelopePlayer*>(context)->update(now, nextRun);
+}
+
+void EnvelopePlayer::tick() {
+  m_buzzer.bend(m_modulator.tick());
+  m_buzzer.setVolume(m_generator.tick());
+  if (!m_generator.isActive()) {
+    m_silent = true;
+  }
+}
+
+void benchmarkEnvelopes(uint8_t voices, uint16_t ticks) {
+  const uint8_t MAX_VOICES = 8;
+  if (voices > MAX_VOICES) {
+    voices = MAX_VOICES;
+  }
+  if (voices == 0 || ticks == 0) {
+    return;
+  }
+  EnvelopeGenerator generators[MAX_VOICES];
+  Modulator modulators[MAX_VOICES];
+  for (uint8_t voice = 0; voice < voices; voice++) {
+    generators[voice].noteOn(DEFAULT_ENVELOPE, DEFAULT_VELOCITY);
+    // The first note gives the glide of the second one somewhere to start from.
+    modulators[voice].noteOn(DEFAULT_MODULATION, 440, 0, 1000);
+    modulators[voice].noteOn(DEFAULT_MODULATION, 494, EXPRESSION_GLIDE | EXPRESSION_VIBRATO | 0x10, 60000);
+  }
+  // Adding every result into a volatile variable stops the compiler from skipping ticks whose results aren't used.
+  volatile uint16_t sink = 0;
+  unsigned long start = micros();
+  for (uint16_t tick = 0; tick < ticks; tick++) {
+    // Halfway through, every note is released, so that every stage is measured.
+    if (tick == ticks / 2) {
+      for (uint8_t voice = 0; voice < voices; voice++) {
+        generators[voice].noteOff();
+      }
+    }
+    for (uint8_t voice = 0; voice < voices; voice++) {
+      sink += generators[voice].tick();
+      sink += modulators[voice].tick();
+    }
+  }
+  unsigned long elapsed = micros() - start;
+  unsigned long voiceTicks = (unsigned long)voices * ticks;
+  Serial.print(voices);
+  Serial.print(" voices: ");
+  Serial.print(elapsed * clockCyclesPerMicrosecond() / voiceTicks);
+  Serial.print(" cycles per voice per tick, ");
+  // elapsed / ticks microseconds per tick, ENVELOPE_TICK_HZ times per second, out of 1,000,000 microseconds, is
+  // elapsed * ENVELOPE_TICK_HZ / ticks / 10000 percent. Printing hundredths of a percent keeps it to whole numbers.
+  unsigned long hundredths = elapsed * ENVELOPE_TICK_HZ / ticks / 100;
+  Serial.print(hundredths / 100);
+  Serial.print(".");
+  Serial.print(hundredths % 100 < 10 ? "0" : "");
+  Serial.print(hundredths % 100);
+  Serial.println("% of the CPU, not counting the time it takes to start and end the interrupt");
+}
@@ -0,0 +1,87 @@
+/// Defines note events and a table of callbacks that are notified about them, e.g. for synchronized lighting.
+
+// See note.hpp for an explanation of header guards.
+#ifndef EVENTS_HPP
+#define EVENTS_HPP
+
+#include "note.hpp"
+
+// An enum (enumeration) is a type whose values are a fixed list of names. The ": uint8_t" after the name makes each
+// value take up a single byte, which matters when we store several events in a queue.
+/// The kinds of events a MelodyPlayer reports.
+enum NoteEventType : uint8_t {
+  NOTE_ON,   // A note has just started playing.
+  NOTE_OFF,  // A note has just stopped, either because it ended or because the next note replaced it.
+  BEAT       // A beat boundary has been reached.
+};
+
+// Callbacks choose which events they want to hear about with a mask: a number where each bit stands for one kind of
+// event. The << operator shifts 1 left by the value of the event type, so NOTE_ON is bit 0, NOTE_OFF is bit 1, and
+// BEAT is bit 2. Masks are combined with |, e.g. NOTE_ON_MASK | NOTE_OFF_MASK.
+const uint8_t NOTE_ON_MASK = 1 << NOTE_ON;
+const uint8_t NOTE_OFF_MASK = 1 << NOTE_OFF;
+const uint8_t BEAT_MASK = 1 << BEAT;
+const uint8_t ALL_EVENTS_MASK = NOTE_ON_MASK | NOTE_OFF_MASK | BEAT_MASK;
+
+/// Describes something that happened during playback.
+struct NoteEvent {
+  /// What happened.
+  NoteEventType type;
+  /// The note that started or stopped, or nullptr for beats.
+  const Note* note;
+  /// The number of the beat (starting from 0) for beats, or 0 otherwise.
+  unsigned long beat;
+  /// When the event happened, in microseconds (like micros()).
+  unsigned long time;
+};
+
+/// A function called when a note event happens. The context is whatever pointer was given when it was added.
+typedef void (*NoteEventCallback)(const NoteEvent& event, void* context);
+
+/// The maximum number of callbacks in a CallbackTable.
+const size_t MAX_NOTE_CALLBACKS = 4;
+
+// Callbacks run in the gaps between notes, so they must be quick. Each callback has a time budget; the table measures
+// how long every call takes and counts the calls that took longer than the budget ("overruns"). A callback with many
+// overruns should be made faster, or it risks making notes late.
+/// A fixed-size table of callbacks that are called for note events.
+struct CallbackTable {
+
+  /// Constructs an empty table.
+  CallbackTable();
+
+  /// Adds a callback for the events in the given mask that should take at most budget microseconds. Returns false if
+  /// the table is full.
+  bool add(NoteEventCallback callback, void* context, uint8_t eventMask, unsigned long budget);
+
+  /// Calls every callback interested in the given event and counts the ones that overran their budget.
+  void dispatch(const NoteEvent& event);
+
+  /// Returns the largest budget of any callback in the table. Events are only dispatched when there's at least this
+  /// much time before the next note.
+  unsigned long largestBudget() const { return m_largestBudget; }
+
+  /// Returns how many times the callback at the given position (in the order they were added) overran its budget.
+  unsigned long overruns(size_t index) const { return m_entries[index].overruns; }
+
+  /// Prints the number of calls and overruns of every callback to Serial.
+  void printReport() const;
+
+private:
+
+  struct Entry {
+    NoteEventCallback callback;
+    void* context;
+    uint8_t eventMask;
+    unsigned long budget;
+    unsigned long calls;
+    unsigned long overruns;
+  };
+
+  Entry m_entries[MAX_NOTE_CALLBACKS];
+  size_t m_count;
+  unsigned long m_largestBudget;
+
+};
+
+#endif /* EVENTS_HPP */
@@ -0,0 +1,43 @@
+// Implementations for the things declared in events.hpp. See melody.ino for an explanation of why they're separated.
+#include "events.hpp"
+
+CallbackTable::CallbackTable() : m_count(0), m_largestBudget(0) {}
+
+bool CallbackTable::add(NoteEventCallback callback, void* context, uint8_t eventMask, unsigned long budget) {
+  if (m_count >= MAX_NOTE_CALLBACKS) {
+    return false;
+  }
+  m_entries[m_count++] = Entry{callback, context, eventMask, budget, 0, 0};
+  if (budget > m_largestBudget) {
+    m_largestBudget = budget;
+  }
+  return true;
+}
+
+void CallbackTable::dispatch(const NoteEvent& event) {
+  uint8_t eventBit = 1 << event.type;
+  for (size_t i = 0; i < m_count; i++) {
+    Entry& entry = m_entries[i];
+    // & (a single ampersand) keeps only the bits that are set in both numbers, so this is only nonzero when the
+    // callback asked for this kind of event.
+    if (entry.eventMask & eventBit) {
+      unsigned long callStart = micros();
+      entry.callback(event, entry.context);
+      entry.calls++;
+      if (micros() - callStart > entry.budget) {
+        entry.overruns++;
+      }
+    }
+  }
+}
+
+void CallbackTable::printReport() const {
+  for (size_t i = 0; i < m_count; i++) {
+    Serial.print("callback ");
+    Serial.print(i);
+    Serial.print(": calls=");
+    Serial.print(m_entries[i].calls);
+    Serial.print(" overruns=");
+    Serial.println(m_entries[i].overruns);
+  }
+}
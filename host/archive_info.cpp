@@ -0,0 +1,61 @@
+/// Opens a melody archive (library file), prints a summary, and reports how long loading and reading it took.
+
+// Build and run it from the host folder with:
+//
+//   g++ -std=c++11 -O2 -o archive_info archive_info.cpp melody_archive.cpp
+//   ./archive_info songs.mlib            # summary of every song
+//   ./archive_info songs.mlib THRILLER   # the notes of one song
+
+#include <chrono>
+#include <cstdio>
+
+#include "melody_archive.hpp"
+
+/// Returns the number of milliseconds between two times.
+double millisecondsBetween(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+int main(int argc, char* argv[]) {
+  if (argc != 2 && argc != 3) {
+    std::fprintf(stderr, "usage: %s ARCHIVE [SONG_NAME]\n", argv[0]);
+    return 2;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  MelodyArchive archive;
+  if (!archive.open(argv[1])) {
+    std::fprintf(stderr, "ERROR: %s: %s\n", argv[1], archive.error());
+    return 1;
+  }
+  auto opened = std::chrono::steady_clock::now();
+
+  if (argc == 3) {
+    MelodyView song;
+    if (!archive.find(argv[2], song)) {
+      std::fprintf(stderr, "ERROR: no song called %s\n", argv[2]);
+      return 1;
+    }
+    for (const NoteRecord& note : song) {
+      std::printf("{%u, %u, %u}\n", note.frequency(), note.offset(), note.duration());
+    }
+    return 0;
+  }
+
+  // Touch every note of every song, so the time below includes actually reading all of the data.
+  unsigned long long notes = 0;
+  unsigned long long checksum = 0;
+  for (size_t i = 0; i < archive.size(); i++) {
+    MelodyView song = archive.song(i);
+    notes += song.length;
+    for (const NoteRecord& note : song) {
+      checksum += note.frequency() + note.offset() + note.duration();
+    }
+  }
+  auto read = std::chrono::steady_clock::now();
+
+  std::printf("%zu songs, %llu notes (checksum %llu)\n", archive.size(), notes, checksum);
+  std::printf("open: %.3f ms, read every note: %.3f ms\n", millisecondsBetween(start, opened),
+              millisecondsBetween(opened, read));
+  return 0;
+}
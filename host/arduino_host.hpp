@@ -0,0 +1,66 @@
+/// Provides just enough of the Arduino environment for the melody code to run on a computer.
+
+// See note.hpp for an explanation of header guards.
+#ifndef ARDUINO_HOST_HPP
+#define ARDUINO_HOST_HPP
+
+// The Arduino IDE automatically #includes Arduino.h at the top of every sketch, which is where things like uint8_t,
+// Serial, tone(), and micros() come from. None of that exists on a computer, so programs in the host folder #include
+// this header before any of the melody headers instead. Only what the melody code actually uses is provided.
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+/// Prints what the melody code would send over Serial to the standard error stream.
+struct HostSerial {
+  void print(const char* text) { std::fputs(text, stderr); }
+  void print(unsigned long value) { std::fprintf(stderr, "%lu", value); }
+  void println(const char* text) { std::fprintf(stderr, "%s\n", text); }
+  void println(unsigned long value) { std::fprintf(stderr, "%lu\n", value); }
+};
+
+// "static" gives every file that #includes this header its own Serial, which is fine because it has no data.
+static HostSerial Serial;
+
+// On an Arduino, Serial and the other serial ports are all Streams, so code that takes a Stream& (like MelodyReceiver in
+// receiver.hpp) works with any of them. Programs here derive from this one to connect such code to something on the
+// computer instead, e.g. a pseudo-terminal (see host_pty.hpp).
+/// The parts of the Arduino's Stream type that the melody code uses.
+struct Stream {
+  virtual ~Stream() {}
+  /// Returns the number of bytes that can be read right away.
+  virtual int available() = 0;
+  /// Returns the next byte, or -1 if there isn't one.
+  virtual int read() = 0;
+  /// Sends size bytes from buffer and returns how many were sent.
+  virtual size_t write(const uint8_t* buffer, size_t size) = 0;
+};
+
+/// Returns the number of microseconds since the program started.
+inline unsigned long micros() {
+  // static means start is only set the first time micros() is called.
+  static const auto start = std::chrono::steady_clock::now();
+  return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start)
+      .count();
+}
+
+/// Returns the number of milliseconds since the program started.
+inline unsigned long millis() { return micros() / 1000; }
+
+/// Waits for the given number of milliseconds. Like the Arduino's, it does nothing else meanwhile.
+inline void delay(unsigned long length) {
+  unsigned long start = micros();
+  while (micros() - start < length * 1000UL) {
+  }
+}
+
+// On a computer there's no buzzer, so tone() and noTone() print what they would have done instead.
+inline void tone(uint8_t pin, unsigned int frequency, unsigned long duration = 0) {
+  std::printf("%lu us: tone(pin %u, %u Hz, %lu ms)\n", micros(), (unsigned)pin, frequency, duration);
+}
+
+inline void noTone(uint8_t pin) { std::printf("%lu us: noTone(pin %u)\n", micros(), (unsigned)pin); }
+
+#endif /* ARDUINO_HOST_HPP */
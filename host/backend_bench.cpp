@@ -0,0 +1,106 @@
+/// Plays THRILLER through the same StreamPlayer on different backends (see backend.hpp) and compares how long each one
+/// takes per note, and optionally writes what a buzzer would play to a WAV file.
+
+// Build and run it from the host folder with:
+//
+//   g++ -std=c++11 -O2 -o backend_bench backend_bench.cpp
+//   ./backend_bench [thriller.wav]
+//
+// Time is made up rather than waited for (see host_backends.hpp), so the whole song plays as fast as the computer can
+// go. The backends on the Arduino itself are compared by benchmarkBackends() in backend.hpp.
+
+#include "arduino_host.hpp"
+
+#include <chrono>
+#include <vector>
+
+#include "../songs.hpp"
+#include "../melody.ino"
+#include "../stream_player.hpp"
+#include "../stream_player.ino"
+#include "host_backends.hpp"
+
+// How many times each backend plays the song. PCM renders 44100 samples per second of music, so it gets fewer runs.
+const int EVENT_RUNS = 2000;
+const int PCM_RUNS = 20;
+const uint32_t SAMPLE_RATE = 44100;
+
+/// A source (see stream_player.hpp) for the notes of an array.
+struct ArraySource {
+  ArraySource(const Note* first, const Note* last) : m_first(first), m_next(first), m_last(last) {}
+  void rewind() { m_next = m_first; }
+  bool next(Note& note) {
+    if (m_next == m_last) {
+      return false;
+    }
+    note = *m_next++;
+    return true;
+  }
+  const Note* m_first;
+  const Note* m_next;
+  const Note* m_last;
+};
+
+/// Does nothing, so that the time of the player on its own can be taken away from the other backends' times.
+struct NullBackend {
+  void play(uint16_t, unsigned long) {}
+  void stop() {}
+};
+
+/// The time the backends read (see host_backends.hpp), in microseconds.
+unsigned long hostClock = 0;
+
+/// Plays the song runs times on the given backend with made-up time, and returns how long that took in nanoseconds.
+/// clear runs before each time, so that recordings don't keep growing.
+template <typename Backend, typename Clear>
+double playRuns(const Backend& backend, int runs, Clear clear) {
+  ArraySource source(THRILLER.cbegin(), THRILLER.cend());
+  StreamPlayer<ArraySource, Backend> player(source, backend);
+  std::chrono::nanoseconds total(0);
+  for (int run = 0; run < runs; run++) {
+    clear();
+    source.rewind();
+    auto start = std::chrono::steady_clock::now();
+    hostClock = 0;
+    player.start(hostClock);
+    unsigned long nextEvent = 0;
+    // Jumping straight to the time of the next event is what the scheduler would do, minus the waiting.
+    while (player.update(hostClock, nextEvent)) {
+      hostClock = nextEvent;
+    }
+    total += std::chrono::steady_clock::now() - start;
+  }
+  return (double)total.count();
+}
+
+/// Prints the time per note of a backend, beyond the time of the player on its own.
+void printResult(const char* label, double nanoseconds, int runs, double baseline) {
+  double perNote = nanoseconds / runs / THRILLER.length();
+  std::printf("%-16s %10.1f ns per note (%8.1f ns more than the player alone)\n", label, perNote, perNote - baseline);
+}
+
+int main(int argc, char* argv[]) {
+  std::vector<BackendEvent> events;
+  std::vector<int16_t> samples;
+
+  double null = playRuns(NullBackend(), EVENT_RUNS, [] {});
+  double baseline = null / EVENT_RUNS / THRILLER.length();
+  printResult("NullBackend", null, EVENT_RUNS, baseline);
+  printResult("RecordingBackend", playRuns(RecordingBackend(hostClock, events), EVENT_RUNS, [&] { events.clear(); }),
+              EVENT_RUNS, baseline);
+  PcmBackend pcm(hostClock, samples, SAMPLE_RATE);
+  // The last note only ends after the player's final stop(), which renders it, so nothing is left to render after.
+  printResult("PcmBackend", playRuns(pcm, PCM_RUNS, [&] { samples.clear(); }), PCM_RUNS, baseline);
+
+  std::printf("%zu events recorded, the first at %lu us (%u Hz) and the last at %lu us\n", events.size(),
+              events.front().time, events.front().frequency, events.back().time);
+  std::printf("%zu samples rendered (%.2f seconds)\n", samples.size(), (double)samples.size() / SAMPLE_RATE);
+  if (argc > 1) {
+    if (!writeWav(argv[1], samples, SAMPLE_RATE)) {
+      std::fprintf(stderr, "ERROR: couldn't write %s\n", argv[1]);
+      return 1;
+    }
+    std::printf("Wrote %s\n", argv[1]);
+  }
+  return 0;
+}
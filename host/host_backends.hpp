@@ -0,0 +1,134 @@
+/// Defines backends (see backend.hpp) that record the notes a player plays, or render them as sound, on a computer.
+
+// See note.hpp for an explanation of header guards.
+#ifndef HOST_BACKENDS_HPP
+#define HOST_BACKENDS_HPP
+
+// <vector> is the C++ standard library's growable array. Like <cstdio> in host_file.hpp, it's only used on a computer,
+// which has plenty of memory to grow it in.
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// A player on a computer doesn't have to run in real time: a program can call its update() with made-up times (see
+// backend_bench.cpp), so a four minute song plays in a few milliseconds. The backends read the time from the same
+// variable the program passes to update(), instead of from micros(), so that they see the made-up times too.
+//
+// A player keeps its own copy of its backend (see backend.hpp), so these only hold references to the clock and to
+// where the notes go. Every copy adds to the same recording or sound.
+
+/// One call to a backend: play() (frequency > 0) or stop() (frequency 0).
+struct BackendEvent {
+  /// When the call happened, in microseconds.
+  unsigned long time;
+  /// The frequency played, or 0 for stop().
+  uint16_t frequency;
+  /// The duration played, in milliseconds (0 for until stop()).
+  unsigned long duration;
+};
+
+/// Records every play() and stop() with the time it happened.
+struct RecordingBackend {
+
+  /// Constructs a backend that reads the time (in microseconds) from clock and adds events to events.
+  RecordingBackend(const unsigned long& clock, std::vector<BackendEvent>& events) : m_clock(clock), m_events(events) {}
+
+  void play(uint16_t frequency, unsigned long duration) { m_events.push_back({m_clock, frequency, duration}); }
+
+  void stop() { m_events.push_back({m_clock, 0, 0}); }
+
+private:
+
+  const unsigned long& m_clock;
+  std::vector<BackendEvent>& m_events;
+
+};
+
+/// Renders the notes as the square wave a buzzer plays, as 16-bit samples.
+struct PcmBackend {
+
+  /// The loudest a sample gets. A full-scale square wave is painfully loud, so this is about a quarter of it.
+  static const int16_t AMPLITUDE = 8000;
+
+  /// Constructs a backend that reads the time (in microseconds) from clock and adds samples (sampleRate per second) to
+  /// samples.
+  PcmBackend(const unsigned long& clock, std::vector<int16_t>& samples, uint32_t sampleRate)
+    : m_clock(clock), m_samples(samples), m_sampleRate(sampleRate), m_frequency(0), m_end(0), m_phase(0) {}
+
+  void play(uint16_t frequency, unsigned long duration) {
+    // The sound up to now is whatever played before, so it's rendered before the note changes.
+    render(m_clock);
+    m_frequency = frequency;
+    m_end = duration > 0 ? m_clock + duration * 1000UL : 0;
+  }
+
+  void stop() {
+    render(m_clock);
+    m_frequency = 0;
+  }
+
+  /// Renders the samples up to the given time (in microseconds). Call it after the last note, so that it's heard.
+  void render(unsigned long until) {
+    // The phase counts through each wave from 0 to 2^32, so adding frequency * 2^32 / m_sampleRate per sample wraps it
+    // around exactly frequency times per second, and the top bit says which half of the wave it's in. Keeping the phase
+    // from note to note, like the buzzer does, avoids clicks where one note changes into the next.
+    while (true) {
+      // The time of the next sample, in microseconds.
+      unsigned long time = (uint64_t)m_samples.size() * 1000000UL / m_sampleRate;
+      if (time >= until) {
+        return;
+      }
+      if (m_frequency > 0 && (m_end == 0 || time < m_end)) {
+        m_phase += (uint32_t)(((uint64_t)m_frequency << 32) / m_sampleRate);
+        m_samples.push_back(m_phase & 0x80000000UL ? AMPLITUDE : -AMPLITUDE);
+      } else {
+        m_samples.push_back(0);
+      }
+    }
+  }
+
+private:
+
+  const unsigned long& m_clock;
+  std::vector<int16_t>& m_samples;
+  uint32_t m_sampleRate;
+  uint16_t m_frequency;
+  // When the note ends (in microseconds), or 0 if it plays until stop().
+  unsigned long m_end;
+  uint32_t m_phase;
+
+};
+
+/// Writes the samples to a WAV file at the given path. Returns false if the file couldn't be written.
+inline bool writeWav(const char* path, const std::vector<int16_t>& samples, uint32_t sampleRate) {
+  std::FILE* file = std::fopen(path, "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  // A WAV file is a 44-byte header saying how the samples are stored, then the samples. Every number in it is
+  // little-endian (lowest byte first), whatever the computer uses, so they're written a byte at a time.
+  auto write = [file](uint32_t value, int bytes) {
+    for (int byte = 0; byte < bytes; byte++) {
+      std::fputc((value >> (8 * byte)) & 0xFF, file);
+    }
+  };
+  uint32_t dataSize = samples.size() * 2;
+  std::fputs("RIFF", file);
+  write(36 + dataSize, 4);
+  std::fputs("WAVEfmt ", file);
+  write(16, 4);              // The size of the rest of the "fmt " part.
+  write(1, 2);               // Plain samples (PCM), not compressed.
+  write(1, 2);               // One channel.
+  write(sampleRate, 4);
+  write(sampleRate * 2, 4);  // Bytes per second.
+  write(2, 2);               // Bytes per sample.
+  write(16, 2);              // Bits per sample.
+  std::fputs("data", file);
+  write(dataSize, 4);
+  for (int16_t sample : samples) {
+    write((uint16_t)sample, 2);
+  }
+  return std::fclose(file) == 0;
+}
+
+#endif /* HOST_BACKENDS_HPP */
@@ -0,0 +1,49 @@
+/// Defines a stand-in for the Arduino SD library's File type that reads a file on a computer.
+
+// See note.hpp for an explanation of header guards.
+#ifndef HOST_FILE_HPP
+#define HOST_FILE_HPP
+
+// <cstdio> is the C++ standard library's header for reading and writing files. It doesn't exist on an Arduino, which is
+// why this header lives in the host folder: it's only used when running the melody code on a computer.
+#include <cstdint>
+#include <cstdio>
+
+// MelodyLibrary and NoteStream (see library.hpp) only need seek() and read(), so a file on a computer can stand in for
+// a file on an SD card. This lets a library file written by melody_creator be checked without any hardware.
+/// A read-only file on the computer with the same seek() and read() member functions as the SD library's File.
+struct HostFile {
+
+  /// Opens the file at the given path. Check isOpen() to find out whether that worked.
+  explicit HostFile(const char* path) : m_file(std::fopen(path, "rb")) {}
+
+  // A destructor (the name of the type after a ~) runs automatically when an object is destroyed. This one closes the
+  // file, so it can't be forgotten.
+  ~HostFile() {
+    if (m_file != nullptr) {
+      std::fclose(m_file);
+    }
+  }
+
+  // Copying a HostFile would close the same file twice, so copying is forbidden with "= delete".
+  HostFile(const HostFile&) = delete;
+  HostFile& operator=(const HostFile&) = delete;
+
+  /// Returns true if the file was opened.
+  bool isOpen() const { return m_file != nullptr; }
+
+  /// Moves to the given position (in bytes from the start of the file). Returns false if that failed.
+  bool seek(uint32_t position) { return m_file != nullptr && std::fseek(m_file, position, SEEK_SET) == 0; }
+
+  /// Reads up to size bytes into buffer and returns how many were read.
+  int read(void* buffer, uint16_t size) {
+    return m_file == nullptr ? -1 : (int)std::fread(buffer, 1, size, m_file);
+  }
+
+private:
+
+  std::FILE* m_file;
+
+};
+
+#endif /* HOST_FILE_HPP */
@@ -0,0 +1,89 @@
+/// Defines a pseudo-terminal that programs on a computer use in place of the Arduino's serial port.
+
+// See note.hpp for an explanation of header guards.
+#ifndef HOST_PTY_HPP
+#define HOST_PTY_HPP
+
+// These are the POSIX headers for pseudo-terminals. They don't exist on Windows, so programs that #include this header
+// only work on Linux and macOS.
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "arduino_host.hpp"
+
+// A pseudo-terminal is a pair of connected fake serial ports: whatever is written to one end (the one another program
+// opens by name, like melody_creator's upload or live replay) can be read from the other (this one), and the other way
+// around. This reads and writes it with the same available(), read(), and write() as Serial.
+/// A pseudo-terminal, used like the Arduino's serial port.
+struct HostPty : Stream {
+
+  /// Opens a pseudo-terminal. Check isOpen() to find out whether that worked.
+  HostPty() : m_master(posix_openpt(O_RDWR | O_NOCTTY)), m_slave(-1), m_position(0), m_size(0) {
+    if (m_master < 0 || grantpt(m_master) != 0 || unlockpt(m_master) != 0) {
+      return;
+    }
+    // The other end is kept open here too. Otherwise reads would fail whenever nothing has it open, e.g. before the
+    // other program starts. Raw mode stops the terminal from changing bytes (like turning 0x0D into 0x0A) on the way
+    // through.
+    m_slave = open(ptsname(m_master), O_RDWR | O_NOCTTY);
+    struct termios settings;
+    if (m_slave < 0 || tcgetattr(m_slave, &settings) != 0) {
+      return;
+    }
+    cfmakeraw(&settings);
+    tcsetattr(m_slave, TCSANOW, &settings);
+    fcntl(m_master, F_SETFL, O_NONBLOCK);
+  }
+
+  ~HostPty() {
+    if (m_slave >= 0) {
+      close(m_slave);
+    }
+    if (m_master >= 0) {
+      close(m_master);
+    }
+  }
+
+  // Copying a HostPty would close the same file descriptors twice (see host_file.hpp).
+  HostPty(const HostPty&) = delete;
+  HostPty& operator=(const HostPty&) = delete;
+
+  /// Returns true if the pseudo-terminal was opened.
+  bool isOpen() const { return m_slave >= 0; }
+
+  /// Returns the name another program opens the other end by, e.g. /dev/pts/3.
+  const char* name() const { return ptsname(m_master); }
+
+  /// Returns the file descriptor bytes arrive on, e.g. to wait for them with poll().
+  int descriptor() const { return m_master; }
+
+  int available() override {
+    if (m_position == m_size) {
+      // The file descriptor is non-blocking, so read() returns right away (with -1) if nothing has arrived.
+      ssize_t count = ::read(m_master, m_buffer, sizeof(m_buffer));
+      m_position = 0;
+      m_size = count > 0 ? count : 0;
+    }
+    return m_size - m_position;
+  }
+
+  int read() override { return available() > 0 ? m_buffer[m_position++] : -1; }
+
+  size_t write(const uint8_t* buffer, size_t size) override {
+    ssize_t count = ::write(m_master, buffer, size);
+    return count > 0 ? count : 0;
+  }
+
+private:
+
+  int m_master;
+  int m_slave;
+  uint8_t m_buffer[256];
+  size_t m_position;
+  size_t m_size;
+
+};
+
+#endif /* HOST_PTY_HPP */
@@ -0,0 +1,44 @@
+/// Prints the notes of a song in a library file exactly as the Arduino would read them, for checking library files on a
+/// computer.
+
+// Build and run it from the host folder with:
+//
+//   g++ -std=c++11 -o library_dump library_dump.cpp
+//   ./library_dump songs.mlib THRILLER
+//
+// Library files are written by melody_creator (python3 -m melody_creator.library).
+
+#include "arduino_host.hpp"
+#include "host_file.hpp"
+
+// Templates need their definitions (not just their declarations) wherever they are used. The Arduino IDE takes care of
+// that by joining every .ino file together; here the ones we need are #included directly.
+#include "../library.hpp"
+#include "../library.ino"
+
+int main(int argc, char* argv[]) {
+  if (argc != 3) {
+    std::fprintf(stderr, "usage: %s LIBRARY_FILE SONG_NAME\n", argv[0]);
+    return 2;
+  }
+  HostFile file(argv[1]);
+  MelodyLibrary<HostFile> library(file);
+  if (!file.isOpen() || !library.begin()) {
+    std::fprintf(stderr, "ERROR: %s is not a melody library\n", argv[1]);
+    return 1;
+  }
+  // The stream is the same size no matter how long the song is: two halves of 8 notes.
+  NoteStream<HostFile> stream;
+  if (!library.open(argv[2], stream)) {
+    std::fprintf(stderr, "ERROR: no song called %s among the %u songs in %s\n", argv[2], library.songCount(), argv[1]);
+    return 1;
+  }
+  Note note;
+  unsigned long count = 0;
+  while (stream.next(note)) {
+    std::printf("{%u, %lu, %u}\n", note.frequency(), note.offset(), note.duration());
+    count++;
+  }
+  std::fprintf(stderr, "%lu notes streamed using %u bytes of buffer\n", count, (unsigned)sizeof(stream));
+  return 0;
+}
@@ -0,0 +1,59 @@
+/// Runs the live instrument (see live.hpp) on a computer, reading MIDI from a pseudo-terminal, so that recorded MIDI can
+/// be replayed into it without an Arduino.
+
+// Build and run it from the host folder with (Linux and macOS only):
+//
+//   g++ -std=c++11 -O2 -o live_host live_host.cpp
+//   ./live_host
+//
+// It prints the name of a pseudo-terminal (e.g. /dev/pts/3), which works like the Arduino's serial port. In another
+// terminal, replay a MIDI file into it with:
+//
+//   python3 -m melody_creator.live song.mid -p /dev/pts/3
+//
+// Every tone() and noTone() call is printed as it happens. Once no bytes have arrived for two seconds, the latency
+// measurements are printed and the program ends.
+
+#include "arduino_host.hpp"
+
+// select() waits for bytes to arrive on a file descriptor. Like the pseudo-terminal itself, it doesn't exist on Windows.
+#include <sys/select.h>
+
+#include "host_pty.hpp"
+#include "../live.hpp"
+#include "../live.ino"
+#include "../tuning.ino"
+
+// How long (in microseconds) to wait for more bytes after the last one before stopping.
+const unsigned long IDLE_TIMEOUT = 2000000UL;
+
+int main() {
+  HostPty pty;
+  if (!pty.isOpen()) {
+    std::perror("ERROR: could not open a pseudo-terminal");
+    return 1;
+  }
+  std::printf("Send MIDI to %s\n", pty.name());
+  std::fflush(stdout);
+
+  LiveInstrument<HostPty> instrument(pty, 8);
+  bool started = false;
+  unsigned long lastByte = 0;
+  while (!started || micros() - lastByte < IDLE_TIMEOUT) {
+    // Wait until a byte arrives, instead of checking over and over, but for no longer than the Scheduler waits between
+    // updates on an Arduino. The instrument measures latency from the last update that found nothing to read, so
+    // waiting longer would make every note look later than it is.
+    fd_set readable;
+    FD_ZERO(&readable);
+    FD_SET(pty.descriptor(), &readable);
+    struct timeval timeout = {0, (suseconds_t)LIVE_POLL_PERIOD};
+    if (select(pty.descriptor() + 1, &readable, nullptr, nullptr, &timeout) > 0) {
+      started = true;
+      lastByte = micros();
+    }
+    unsigned long nextEvent;
+    instrument.update(micros(), nextEvent);
+  }
+  instrument.printLatency();
+  return instrument.lateNotes() == 0 ? 0 : 1;
+}
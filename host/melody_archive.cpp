@@ -0,0 +1,149 @@
+// Implementations for the things declared in melody_archive.hpp. This is a regular C++ file (not .ino) because it's
+// only built on a computer, never by the Arduino IDE.
+#include "melody_archive.hpp"
+
+// These headers are POSIX (Linux and macOS), not standard C++. They provide open(), fstat(), mmap(), and friends.
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// See library.hpp for the layout of a library file. An unnamed namespace keeps these names private to this file.
+const uint16_t VERSION = 1;
+const size_t HEADER_SIZE = 16;
+const size_t SLOT_SIZE = 16;
+const size_t NOTE_SIZE = 8;
+
+/// The same FNV-1a hash as hashName() in library.ino.
+uint32_t hashName(const char* name) {
+  uint32_t hash = 2166136261u;
+  for (; *name != '\0'; name++) {
+    hash ^= (uint8_t)*name;
+    hash *= 16777619u;
+  }
+  return hash == 0 ? 1 : hash;
+}
+
+}  // namespace
+
+MelodyArchive::MelodyArchive()
+  : m_data(nullptr), m_size(0), m_slotCount(0), m_songCount(0), m_songSlots(nullptr), m_error("not open") {}
+
+MelodyArchive::~MelodyArchive() { close(); }
+
+bool MelodyArchive::open(const char* path) {
+  close();
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    m_error = "cannot open file";
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < (off_t)HEADER_SIZE) {
+    ::close(fd);
+    m_error = "file is too small to be a library";
+    return false;
+  }
+  // MAP_PRIVATE with PROT_READ gives a read-only view of the file. The file descriptor can be closed straight away;
+  // the mapping stays valid until munmap().
+  void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    m_error = "cannot map file";
+    return false;
+  }
+  m_data = static_cast<const uint8_t*>(data);
+  m_size = info.st_size;
+  if (!validate()) {
+    const char* error = m_error;
+    close();
+    m_error = error;
+    return false;
+  }
+  m_error = nullptr;
+  return true;
+}
+
+void MelodyArchive::close() {
+  if (m_data != nullptr) {
+    munmap(const_cast<uint8_t*>(m_data), m_size);
+  }
+  delete[] m_songSlots;
+  m_data = nullptr;
+  m_size = 0;
+  m_slotCount = 0;
+  m_songCount = 0;
+  m_songSlots = nullptr;
+  m_error = "not open";
+}
+
+bool MelodyArchive::validate() {
+  if (std::memcmp(m_data, "MLIB", 4) != 0) {
+    m_error = "not a melody library";
+    return false;
+  }
+  if (NoteRecord::readUint16(m_data + 4) != VERSION || NoteRecord::readUint16(m_data + 10) != NOTE_SIZE) {
+    m_error = "unsupported library version";
+    return false;
+  }
+  m_slotCount = NoteRecord::readUint16(m_data + 6);
+  size_t declaredSongs = NoteRecord::readUint16(m_data + 8);
+  if (m_slotCount == 0 || HEADER_SIZE + (size_t)m_slotCount * SLOT_SIZE > m_size) {
+    m_error = "index is truncated";
+    return false;
+  }
+
+  // Every song is checked once here so that song() and find() never have to check anything. This only touches the
+  // index (16 bytes per slot) and the names, never the notes, so it's fast even for huge archives.
+  m_songSlots = new const uint8_t*[declaredSongs];
+  m_songCount = 0;
+  for (size_t i = 0; i < m_slotCount; i++) {
+    const uint8_t* slot = m_data + HEADER_SIZE + i * SLOT_SIZE;
+    if (NoteRecord::readUint32(slot) == 0) {
+      continue;
+    }
+    uint32_t namePosition = NoteRecord::readUint32(slot + 4);
+    uint64_t notesEnd = NoteRecord::readUint32(slot + 8) + (uint64_t)NoteRecord::readUint32(slot + 12) * NOTE_SIZE;
+    if (m_songCount >= declaredSongs || namePosition >= m_size || notesEnd > m_size
+        || std::memchr(m_data + namePosition, '\0', m_size - namePosition) == nullptr) {
+      m_error = "index points outside the file";
+      return false;
+    }
+    m_songSlots[m_songCount++] = slot;
+  }
+  if (m_songCount != declaredSongs) {
+    m_error = "song count does not match index";
+    return false;
+  }
+  return true;
+}
+
+MelodyView MelodyArchive::viewOfSlot(const uint8_t* slot) const {
+  // reinterpret_cast tells the compiler to treat the bytes at this address as NoteRecords. This is safe because
+  // NoteRecord is just 8 bytes with no alignment requirement, exactly like the records in the file.
+  return MelodyView{reinterpret_cast<const char*>(m_data + NoteRecord::readUint32(slot + 4)),
+                    reinterpret_cast<const NoteRecord*>(m_data + NoteRecord::readUint32(slot + 8)),
+                    NoteRecord::readUint32(slot + 12)};
+}
+
+bool MelodyArchive::find(const char* name, MelodyView& view) const {
+  if (m_data == nullptr) {
+    return false;
+  }
+  // The same linear probing as MelodyLibrary::find() in library.ino.
+  uint32_t hash = hashName(name);
+  for (size_t probe = 0; probe < m_slotCount; probe++) {
+    const uint8_t* slot = m_data + HEADER_SIZE + ((hash + probe) % m_slotCount) * SLOT_SIZE;
+    uint32_t slotHash = NoteRecord::readUint32(slot);
+    if (slotHash == 0) {
+      return false;
+    }
+    if (slotHash == hash) {
+      view = viewOfSlot(slot);
+      return std::strcmp(view.name, name) == 0;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,117 @@
+/// Defines a fast, read-only view of a melody library file for programs running on a computer.
+
+// See note.hpp for an explanation of header guards.
+#ifndef MELODY_ARCHIVE_HPP
+#define MELODY_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// An archive is a library file written by melody_creator (see library.hpp for the format). On an Arduino, library files
+// are read a few notes at a time. A computer has plenty of memory, so MelodyArchive uses mmap() instead: the operating
+// system makes the whole file appear in memory without reading it, and only loads the parts that are actually looked
+// at. Opening an archive therefore takes about the same time whether it holds ten songs or ten thousand, and nothing is
+// ever copied: a MelodyView points straight into the file's bytes.
+//
+// Build programs that use this with melody_archive.cpp, e.g.
+//
+//   g++ -std=c++11 -O2 -o archive_info archive_info.cpp melody_archive.cpp
+
+/// One note record in an archive, read directly from the file's bytes.
+class NoteRecord {
+public:
+
+  /// Returns the pitch of the note as a frequency in Hertz.
+  uint16_t frequency() const { return readUint16(m_bytes); }
+
+  /// Returns the offset of the note (position from the start) in milliseconds.
+  uint32_t offset() const { return readUint32(m_bytes + 2); }
+
+  /// Returns the duration of the note in milliseconds.
+  uint16_t duration() const { return readUint16(m_bytes + 6); }
+
+  // Records are packed: the 4-byte offset starts 2 bytes in, which isn't where a computer expects 4-byte numbers to
+  // be. Reading the bytes one at a time is correct on every computer (whichever order it stores numbers in) and
+  // compilers turn it into a single load where that's allowed.
+  static uint16_t readUint16(const uint8_t* bytes) { return (uint16_t)(bytes[0] | bytes[1] << 8); }
+  static uint32_t readUint32(const uint8_t* bytes) {
+    return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+  }
+
+private:
+
+  uint8_t m_bytes[8];
+
+};
+
+// static_assert checks something while compiling. If NoteRecord weren't exactly 8 bytes, pointing it at the file's
+// bytes would read the wrong notes, so the program refuses to compile instead.
+static_assert(sizeof(NoteRecord) == 8, "NoteRecord must match the 8-byte note records in library files");
+
+/// A song in an archive. It points into the archive's memory, so it's only valid while the archive is open.
+struct MelodyView {
+
+  /// The name of the song.
+  const char* name;
+  /// The song's notes, sorted by offset.
+  const NoteRecord* notes;
+  /// The number of notes.
+  size_t length;
+
+  // begin() and end() let a MelodyView be used in a range-based for loop: for (const NoteRecord& note : view) { ... }
+  const NoteRecord* begin() const { return notes; }
+  const NoteRecord* end() const { return notes + length; }
+  const NoteRecord& operator[](size_t index) const { return notes[index]; }
+
+};
+
+/// A library file opened with mmap().
+class MelodyArchive {
+public:
+
+  MelodyArchive();
+  ~MelodyArchive();
+
+  // An archive owns its mapping, so it can't be copied (that would unmap the file twice).
+  MelodyArchive(const MelodyArchive&) = delete;
+  MelodyArchive& operator=(const MelodyArchive&) = delete;
+
+  /// Opens the archive at the given path, closing any archive that was already open. Returns false (and sets error())
+  /// if the file can't be opened or isn't a valid library file.
+  bool open(const char* path);
+
+  /// Closes the archive. Any MelodyView from it becomes invalid.
+  void close();
+
+  /// Returns a description of why open() failed.
+  const char* error() const { return m_error; }
+
+  /// Returns the number of songs in the archive.
+  size_t size() const { return m_songCount; }
+
+  /// Returns the song with the given position (0 to size() - 1). Positions follow the order of the index.
+  MelodyView song(size_t index) const { return viewOfSlot(m_songSlots[index]); }
+
+  /// Looks up a song by name. Returns false if there's no such song.
+  bool find(const char* name, MelodyView& view) const;
+
+private:
+
+  // Returns a view of the song in the given index slot.
+  MelodyView viewOfSlot(const uint8_t* slot) const;
+
+  // Checks the header, index, and every song's bounds. Sets m_error and returns false if something's wrong.
+  bool validate();
+
+  const uint8_t* m_data;
+  size_t m_size;
+  uint16_t m_slotCount;
+  size_t m_songCount;
+  // Pointers to the used slots of the index, so that song(i) doesn't have to skip over empty slots.
+  const uint8_t** m_songSlots;
+  const char* m_error;
+
+};
+
+#endif /* MELODY_ARCHIVE_HPP */
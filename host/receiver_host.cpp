@@ -0,0 +1,61 @@
+/// Runs a MelodyReceiver (see receiver.hpp) on a computer, reading frames from a pseudo-terminal, so that the upload
+/// protocol can be checked against the real receiver code without an Arduino.
+
+// Build it from the host folder with (Linux and macOS only):
+//
+//   g++ -std=c++11 -O2 -o receiver_host receiver_host.cpp
+//
+// `python3 -m melody_creator.upload songs.hpp --loopback` runs it and uploads a song to it. To run it by hand:
+//
+//   ./receiver_host [speed]
+//
+// It prints the name of a pseudo-terminal (e.g. /dev/pts/3), which works like the Arduino's serial port, to upload to
+// with `python3 -m melody_creator.upload songs.hpp -p /dev/pts/3`. Every tone() and noTone() call is printed as it
+// happens. The song plays speed times faster than normal (1 if it's not given), so a check doesn't take as long as the
+// song. Once the song has finished, how many frames were rejected and how many times playback ran out of notes are
+// printed and the program ends.
+
+#include "arduino_host.hpp"
+
+#include <cstdlib>
+
+// poll() waits for bytes to arrive on a file descriptor. Like the pseudo-terminal itself, it doesn't exist on Windows.
+#include <poll.h>
+
+#include "host_pty.hpp"
+#include "../receiver.hpp"
+#include "../receiver.ino"
+
+/// The number of notes the receiver buffers.
+const size_t RECEIVER_CAPACITY = 16;
+
+int main(int argc, char* argv[]) {
+  unsigned long speed = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1;
+  if (speed == 0) {
+    std::fprintf(stderr, "ERROR: the speed must be a whole number of at least 1\n");
+    return 1;
+  }
+  HostPty pty;
+  if (!pty.isOpen()) {
+    std::perror("ERROR: could not open a pseudo-terminal");
+    return 1;
+  }
+  // Another program usually reads what this prints as it happens, so every line is sent straight away rather than
+  // when a buffer fills up.
+  std::setvbuf(stdout, nullptr, _IOLBF, 0);
+  std::printf("Upload to %s\n", pty.name());
+
+  MelodyReceiver<RECEIVER_CAPACITY> receiver(pty, 8);
+  bool played = false;
+  while (!played || receiver.isPlaying()) {
+    // Wait (for up to a millisecond) until a byte arrives, instead of checking over and over.
+    struct pollfd waiting = {pty.descriptor(), POLLIN, 0};
+    poll(&waiting, 1, 1);
+    unsigned long nextEvent;
+    // Multiplying the time makes the receiver think more time has passed than really has, which speeds up the song.
+    receiver.update(micros() * speed, nextEvent);
+    played = played || receiver.isPlaying();
+  }
+  std::printf("%lu frames rejected, %lu underruns\n", receiver.rejectedFrames(), receiver.underruns());
+  return 0;
+}
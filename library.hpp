@@ -0,0 +1,125 @@
+/// Defines a reader for melody libraries: files (e.g. on an SD card) that hold many songs, each found by name.
+
+// See note.hpp for an explanation of header guards.
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include "note.hpp"
+
+// THE LIBRARY FILE FORMAT
+//
+// Library files are written by melody_creator (see melody_creator/melody_creator/library.py). All numbers are
+// little-endian (lowest byte first). A file has four parts:
+//
+//   Header (16 bytes):  "MLIB", version (2 bytes), slot count (2), song count (2), note record size (2), unused (4)
+//   Index:              slot count slots of 16 bytes: name hash (4), name position (4), notes position (4),
+//                       note count (4). A hash of 0 marks an empty slot.
+//   Names:              The name of every song, each followed by a 0 byte.
+//   Notes:              Every song's notes, sorted by offset. Each note is 8 bytes: frequency (2), offset (4), and
+//                       duration (2), the same layout the upload protocol uses (see receiver.hpp).
+//
+// The index is a hash table. A hash function turns a song's name into a number that looks random but is always the
+// same for the same name. The song's slot is that number modulo the slot count; if two songs want the same slot, the
+// second one goes into the next free slot after it. There are always at least twice as many slots as songs, so finding
+// a song almost always takes a single read, no matter how many songs there are.
+
+/// The version of the library format this code reads.
+const uint16_t LIBRARY_VERSION = 1;
+/// The size of the header and of each index slot, in bytes.
+const uint32_t LIBRARY_HEADER_SIZE = 16;
+const uint32_t LIBRARY_SLOT_SIZE = 16;
+/// The size of a note record, in bytes.
+const uint16_t LIBRARY_NOTE_SIZE = 8;
+
+// This is the 32-bit FNV-1a hash: https://en.wikipedia.org/wiki/Fowler%E2%80%93Noll%E2%80%93Vo_hash_function
+// It's tiny, fast on an Arduino, and library.py computes exactly the same numbers.
+/// Returns the hash of the given name used by the library index. Never returns 0.
+uint32_t hashName(const char* name);
+
+// The file types these templates work with (File from the Arduino SD library, or HostFile from host/host_file.hpp
+// for testing on a computer) must have these member functions:
+//
+//   bool seek(uint32_t position);          // Moves to the given position (in bytes from the start of the file).
+//   int read(void* buffer, uint16_t size); // Reads up to size bytes and returns how many were read.
+
+// A double buffer is two small arrays of notes. The player takes notes from one half while the other half is already
+// full and waiting. As soon as a half is used up, the player switches to the other one and the used-up half is refilled
+// from the file. Each refill happens right after a note starts, so it has the whole gap between notes to finish, and no
+// matter how long the song is, only 2 * HalfSize notes are ever in memory.
+/// Reads a song's notes from a library file a few at a time. Can be used as a source for StreamPlayer.
+template <typename File, size_t HalfSize = 8>
+struct NoteStream {
+
+  /// Constructs a stream with no song.
+  NoteStream();
+
+  /// Starts reading count notes from the given position in the given file, and fills both halves of the buffer.
+  void open(File& file, uint32_t position, uint32_t count);
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  // Reads as many notes as fit (or are left) into the given half of the buffer.
+  void fill(uint8_t half);
+
+  File* m_file;
+  // Where the next unread note is in the file, and how many notes haven't been read yet.
+  uint32_t m_position;
+  uint32_t m_unread;
+  Note m_buffers[2][HalfSize];
+  uint8_t m_counts[2];
+  // Which half notes are being taken from, and the position of the next note in it.
+  uint8_t m_active;
+  uint8_t m_index;
+
+};
+
+/// Where a song is stored in a library file.
+struct SongInfo {
+  /// The position of the song's first note, in bytes from the start of the file.
+  uint32_t position;
+  /// The number of notes in the song.
+  uint32_t noteCount;
+};
+
+/// Finds songs in a library file.
+template <typename File>
+struct MelodyLibrary {
+
+  /// Constructs a library that reads from the given (already opened) file.
+  explicit MelodyLibrary(File& file) : m_file(file), m_slotCount(0), m_songCount(0) {}
+
+  /// Reads and checks the header. Returns false if the file isn't a library this code can read.
+  bool begin();
+
+  /// Returns the number of songs in the library.
+  uint16_t songCount() const { return m_songCount; }
+
+  /// Looks up the song with the given name. Returns false if there's no such song.
+  bool find(const char* name, SongInfo& info);
+
+  /// Looks up the song with the given name and opens it in the given stream. Returns false if there's no such song.
+  template <size_t HalfSize>
+  bool open(const char* name, NoteStream<File, HalfSize>& stream) {
+    SongInfo info;
+    if (!find(name, info)) {
+      return false;
+    }
+    stream.open(m_file, info.position, info.noteCount);
+    return true;
+  }
+
+private:
+
+  // Returns true if the name stored at the given position in the file is the given name.
+  bool nameMatches(uint32_t position, const char* name);
+
+  File& m_file;
+  uint16_t m_slotCount;
+  uint16_t m_songCount;
+
+};
+
+#endif /* LIBRARY_HPP */
@@ -0,0 +1,147 @@
+// Implementations for the things declared in library.hpp. See melody.ino for an explanation of why they're separated.
+#include "library.hpp"
+
+/// Returns the 16-bit little-endian number stored in the two given bytes.
+inline uint16_t readUint16(const uint8_t* bytes) { return bytes[0] | (uint16_t)bytes[1] << 8; }
+
+/// Returns the 32-bit little-endian number stored in the four given bytes.
+inline uint32_t readUint32(const uint8_t* bytes) {
+  return bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+}
+
+uint32_t hashName(const char* name) {
+  uint32_t hash = 2166136261UL;
+  // A string is an array of characters ending with a 0, so this loop stops at the end of the name.
+  for (; *name != '\0'; name++) {
+    // ^ is "exclusive or": it flips the bits of the hash that are set in the character.
+    hash ^= (uint8_t)*name;
+    hash *= 16777619UL;
+  }
+  // 0 marks an empty slot in the index, so no name is allowed to hash to it.
+  return hash == 0 ? 1 : hash;
+}
+
+template <typename File, size_t HalfSize>
+NoteStream<File, HalfSize>::NoteStream() : m_file(nullptr), m_position(0), m_unread(0), m_active(0), m_index(0) {
+  m_counts[0] = 0;
+  m_counts[1] = 0;
+}
+
+template <typename File, size_t HalfSize>
+void NoteStream<File, HalfSize>::open(File& file, uint32_t position, uint32_t count) {
+  m_file = &file;
+  m_position = position;
+  m_unread = count;
+  m_active = 0;
+  m_index = 0;
+  fill(0);
+  fill(1);
+}
+
+template <typename File, size_t HalfSize>
+void NoteStream<File, HalfSize>::fill(uint8_t half) {
+  size_t count = m_unread < HalfSize ? m_unread : HalfSize;
+  m_counts[half] = 0;
+  // The raw bytes of every note in the half are read with one read() call, which is much faster on an SD card than
+  // reading each note separately.
+  uint8_t bytes[HalfSize * LIBRARY_NOTE_SIZE];
+  if (count == 0 || !m_file->seek(m_position)
+      || m_file->read(bytes, count * LIBRARY_NOTE_SIZE) != (int)(count * LIBRARY_NOTE_SIZE)) {
+    // If the card can't be read, the song just ends early.
+    m_unread = 0;
+    return;
+  }
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t* record = bytes + i * LIBRARY_NOTE_SIZE;
+    m_buffers[half][i] = Note(readUint16(record), readUint32(record + 2), readUint16(record + 6));
+  }
+  m_counts[half] = count;
+  m_position += count * LIBRARY_NOTE_SIZE;
+  m_unread -= count;
+}
+
+template <typename File, size_t HalfSize>
+bool NoteStream<File, HalfSize>::next(Note& note) {
+  if (m_index >= m_counts[m_active]) {
+    // This half is used up. Switch to the other half (which is already full) and refill this one for later.
+    uint8_t used = m_active;
+    m_active = 1 - m_active;
+    m_index = 0;
+    if (m_counts[m_active] == 0) {
+      return false;
+    }
+    fill(used);
+  }
+  note = m_buffers[m_active][m_index++];
+  return true;
+}
+
+template <typename File>
+bool MelodyLibrary<File>::begin() {
+  uint8_t header[LIBRARY_HEADER_SIZE];
+  if (!m_file.seek(0) || m_file.read(header, LIBRARY_HEADER_SIZE) != (int)LIBRARY_HEADER_SIZE) {
+    return false;
+  }
+  // memcmp() compares bytes and returns 0 if they're all the same.
+  if (memcmp(header, "MLIB", 4) != 0 || readUint16(header + 4) != LIBRARY_VERSION
+      || readUint16(header + 10) != LIBRARY_NOTE_SIZE) {
+    return false;
+  }
+  m_slotCount = readUint16(header + 6);
+  m_songCount = readUint16(header + 8);
+  return m_slotCount > 0;
+}
+
+template <typename File>
+bool MelodyLibrary<File>::find(const char* name, SongInfo& info) {
+  uint32_t hash = hashName(name);
+  // Start at the song's slot and move forward until the song or an empty slot (meaning there's no such song) is found.
+  // Every slot is visited at most once, so this ends even if the index is full.
+  for (uint16_t probe = 0; probe < m_slotCount; probe++) {
+    uint8_t slot[LIBRARY_SLOT_SIZE];
+    uint32_t position = LIBRARY_HEADER_SIZE + ((hash + probe) % m_slotCount) * LIBRARY_SLOT_SIZE;
+    if (!m_file.seek(position) || m_file.read(slot, LIBRARY_SLOT_SIZE) != (int)LIBRARY_SLOT_SIZE) {
+      return false;
+    }
+    uint32_t slotHash = readUint32(slot);
+    if (slotHash == 0) {
+      return false;
+    }
+    // library.py refuses to write two songs with the same hash, so no other slot can hold this name. But a name that
+    // isn't in the library can still have the same hash as one that is, so the names are compared to make sure.
+    if (slotHash == hash) {
+      if (!nameMatches(readUint32(slot + 4), name)) {
+        return false;
+      }
+      info.position = readUint32(slot + 8);
+      info.noteCount = readUint32(slot + 12);
+      return true;
+    }
+  }
+  return false;
+}
+
+template <typename File>
+bool MelodyLibrary<File>::nameMatches(uint32_t position, const char* name) {
+  if (!m_file.seek(position)) {
+    return false;
+  }
+  // The stored name is read a few bytes at a time, so there's no need for a buffer as long as the longest name. The 0
+  // byte at its end is compared too, so a name that's only the start of the stored one (or the other way around)
+  // doesn't match.
+  uint8_t chunk[16];
+  while (true) {
+    int count = m_file.read(chunk, sizeof(chunk));
+    if (count <= 0) {
+      return false;
+    }
+    for (int i = 0; i < count; i++, name++) {
+      if (chunk[i] != (uint8_t)*name) {
+        return false;
+      }
+      if (*name == '\0') {
+        return true;
+      }
+    }
+  }
+}
@@ -0,0 +1,122 @@
+/// Defines a live instrument that plays MIDI notes on the buzzer as soon as they arrive over a serial connection.
+
+// See note.hpp for an explanation of header guards.
+#ifndef LIVE_HPP
+#define LIVE_HPP
+
+#include "backend.hpp"
+#include "tuning.hpp"
+
+// MIDI is how keyboards, sequencers, and music software tell each other which notes to play. A MIDI stream is a list of
+// messages, and each message is a status byte (top bit set) followed by one or two data bytes (top bit clear):
+//
+//   0x90 | channel, key, velocity    Note on: start playing key (60 is middle C). A velocity of 0 means note off.
+//   0x80 | channel, key, velocity    Note off: stop playing key.
+//
+// There are other messages (control changes, pitch bend, clock ticks, ...), which are skipped, except for control
+// changes 120 and 123 ("all sound off" and "all notes off"). If a message has the same status byte as the one before,
+// the status byte can be left out ("running status"), so a run of notes only takes two bytes per note.
+//
+// MIDI arrives one byte at a time, and the instrument can't wait for a whole message to arrive before doing anything
+// else, so the parser is a state machine (like MelodyReceiver's, see receiver.hpp): every byte moves it to its next
+// state, and it plays the note the moment the last byte of a message arrives.
+//
+// A buzzer can only play one note at a time, but a keyboard player can hold several keys. This instrument uses last-note
+// priority, like most monophonic synthesizers: the key pressed most recently is the one that sounds. Releasing it goes
+// back to the most recent key that's still held, and releasing every key stops the sound.
+//
+// Real MIDI runs at 31250 baud. A computer can also send MIDI over USB at any baud rate (e.g. with
+// melody_creator/melody_creator/live.py, or a "serial MIDI bridge" program), with Serial.begin() at the same rate.
+
+/// The most keys that can be held at once. Pressing another one forgets the oldest.
+const uint8_t LIVE_MAX_HELD = 8;
+/// Pass this as the channel to play notes from every channel.
+const uint8_t LIVE_ANY_CHANNEL = 0xFF;
+/// The longest time (in microseconds) that should pass between a note's last byte arriving and the note sounding.
+const unsigned long LIVE_LATENCY_LIMIT = 1000;
+/// How often (in microseconds) the instrument checks for new bytes when it runs as a Scheduler task.
+const unsigned long LIVE_POLL_PERIOD = 100;
+
+// Input can be any type with these member functions, e.g. HardwareSerial (the type of Serial) or a file descriptor on a
+// computer (see host/live_host.cpp):
+//
+//   int available();  // Returns the number of bytes that can be read right away.
+//   int read();       // Reads a byte.
+//
+// The notes are played on a backend (see backend.hpp), which is tone() unless another one is given. A pin number works
+// as the backend too, since it turns into a ToneBackend by itself.
+/// Plays the notes in a MIDI stream on a backend as they arrive.
+template <typename Input, typename Backend = ToneBackend>
+struct LiveInstrument {
+
+  /// Constructs an instrument that reads MIDI from input and plays notes from the given channel (0-15, or
+  /// LIVE_ANY_CHANNEL) on (a copy of) the given backend.
+  LiveInstrument(Input& input, const Backend& backend, uint8_t channel = LIVE_ANY_CHANNEL);
+
+  /// Reads and acts on every byte that has arrived. Always returns true and stores the time at which to check again in
+  /// nextEvent.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  /// Feeds one byte to the parser. arrival is the earliest time (from micros()) the byte can have arrived, used to
+  /// measure latency.
+  void receive(uint8_t byte, unsigned long arrival);
+
+  /// Stops the sound and forgets every held key.
+  void allNotesOff();
+
+  /// Returns the key that's sounding, or 0xFF if none is.
+  uint8_t soundingKey() const { return m_heldCount > 0 ? m_held[m_heldCount - 1] : 0xFF; }
+
+  /// Returns the number of notes played for a note on, the longest and average time (in microseconds) from its last
+  /// byte arriving to the backend's play() returning, and the number of times that took longer than LIVE_LATENCY_LIMIT.
+  unsigned long noteCount() const { return m_noteCount; }
+  unsigned long maxLatency() const { return m_maxLatency; }
+  unsigned long averageLatency() const { return m_noteCount > 0 ? m_totalLatency / m_noteCount : 0; }
+  unsigned long lateNotes() const { return m_lateNotes; }
+
+  /// Prints the latency measurements over Serial.
+  void printLatency() const;
+
+  /// Task adapter for Scheduler (see scheduler.hpp): context must point to a LiveInstrument<Input, Backend>.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+private:
+
+  // READ_DATA means a status byte has been seen and its data bytes are being read. SKIP means the bytes of a message
+  // the instrument doesn't care about (such as system exclusive) are being skipped until the next status byte.
+  enum ParseState : uint8_t { WAIT_STATUS, READ_DATA, SKIP };
+
+  // Acts on a complete channel message.
+  void handleMessage(unsigned long arrival);
+  void press(uint8_t key, unsigned long arrival);
+  void release(uint8_t key);
+  // Plays the key that should sound now (the most recent held one), or stops the sound if none is held.
+  void sound();
+
+  Input& m_input;
+  Backend m_backend;
+  uint8_t m_channel;
+
+  ParseState m_state;
+  // The status byte of the current message, kept for running status.
+  uint8_t m_status;
+  uint8_t m_data[2];
+  uint8_t m_dataCount;
+  uint8_t m_dataNeeded;
+
+  // The held keys, oldest first. The last one is the one sounding.
+  uint8_t m_held[LIVE_MAX_HELD];
+  uint8_t m_heldCount;
+
+  // The last time (from micros()) update() found no bytes to read, which is the earliest the next byte can arrive.
+  unsigned long m_lastEmptyPoll;
+  bool m_polled;
+
+  unsigned long m_noteCount;
+  unsigned long m_maxLatency;
+  unsigned long m_totalLatency;
+  unsigned long m_lateNotes;
+
+};
+
+#endif /* LIVE_HPP */
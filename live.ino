@@ -0,0 +1,174 @@
+// Implementations for the things declared in live.hpp. See melody.ino for an explanation of why they're separated.
+#include "live.hpp"
+
+template <typename Input, typename Backend>
+LiveInstrument<Input, Backend>::LiveInstrument(Input& input, const Backend& backend, uint8_t channel)
+  : m_input(input), m_backend(backend), m_channel(channel), m_state(WAIT_STATUS), m_status(0), m_dataCount(0),
+    m_dataNeeded(0), m_heldCount(0), m_lastEmptyPoll(0), m_polled(false), m_noteCount(0), m_maxLatency(0),
+    m_totalLatency(0), m_lateNotes(0) {}
+
+template <typename Input, typename Backend>
+bool LiveInstrument<Input, Backend>::update(unsigned long now, unsigned long& nextEvent) {
+  // Before the first poll, nothing is known about when bytes arrived, so the earliest possible time is when the
+  // instrument started being updated.
+  if (!m_polled) {
+    m_lastEmptyPoll = now;
+    m_polled = true;
+  }
+  // A byte sits in the serial buffer from the moment it arrives until it's read, which can be a whole poll period (or
+  // longer, if other tasks ran in between). It can't have arrived before the last time there was nothing to read, so
+  // latency is measured from then. That may make a note look a little later than it was, but never earlier.
+  while (true) {
+    unsigned long checked = micros();
+    if (m_input.available() <= 0) {
+      m_lastEmptyPoll = checked;
+      break;
+    }
+    int byte = m_input.read();
+    if (byte < 0) {
+      break;
+    }
+    receive(byte, m_lastEmptyPoll);
+  }
+  nextEvent = now + LIVE_POLL_PERIOD;
+  return true;
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::receive(uint8_t byte, unsigned long arrival) {
+  if (byte >= 0xF8) {
+    // Real-time messages (clock ticks, start, stop, ...) are a single byte and can even arrive in the middle of another
+    // message, so they're ignored without disturbing anything.
+    return;
+  }
+  if (byte & 0x80) {
+    if (byte >= 0xF0) {
+      // System exclusive and system common messages aren't for playing notes. Their data bytes are skipped, and they
+      // cancel running status.
+      m_status = 0;
+      m_state = byte == 0xF7 ? WAIT_STATUS : SKIP;
+      return;
+    }
+    m_status = byte;
+    m_state = READ_DATA;
+    m_dataCount = 0;
+    // Program change (0xC0) and channel pressure (0xD0) have one data byte; every other channel message has two.
+    m_dataNeeded = (byte & 0xE0) == 0xC0 ? 1 : 2;
+    return;
+  }
+
+  // A data byte.
+  if (m_state == WAIT_STATUS && m_status != 0) {
+    // Running status: this is the first data byte of another message like the previous one.
+    m_state = READ_DATA;
+    m_dataCount = 0;
+  }
+  if (m_state != READ_DATA) {
+    return;
+  }
+  m_data[m_dataCount++] = byte;
+  if (m_dataCount == m_dataNeeded) {
+    m_state = WAIT_STATUS;
+    handleMessage(arrival);
+  }
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::handleMessage(unsigned long arrival) {
+  if (m_channel != LIVE_ANY_CHANNEL && (m_status & 0x0F) != m_channel) {
+    return;
+  }
+  switch (m_status & 0xF0) {
+    case 0x90:
+      if (m_data[1] > 0) {
+        press(m_data[0], arrival);
+        break;
+      }
+      // A note on with velocity 0 is a note off, so without a break, it carries on into the next case (this is called
+      // "falling through"). The comment right before the case tells the compiler it's on purpose, so it doesn't warn.
+      // fall through
+    case 0x80:
+      release(m_data[0]);
+      break;
+    case 0xB0:
+      if (m_data[0] == 120 || m_data[0] == 123) {
+        allNotesOff();
+      }
+      break;
+  }
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::press(uint8_t key, unsigned long arrival) {
+  // If the key is already held (its note off got lost, for example), it moves to the top instead of being added twice.
+  release(key);
+  if (m_heldCount == LIVE_MAX_HELD) {
+    for (uint8_t i = 1; i < m_heldCount; i++) {
+      m_held[i - 1] = m_held[i];
+    }
+    m_heldCount--;
+  }
+  m_held[m_heldCount++] = key;
+  sound();
+
+  unsigned long latency = micros() - arrival;
+  m_noteCount++;
+  m_totalLatency += latency;
+  if (latency > m_maxLatency) {
+    m_maxLatency = latency;
+  }
+  if (latency > LIVE_LATENCY_LIMIT) {
+    m_lateNotes++;
+  }
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::release(uint8_t key) {
+  for (uint8_t i = 0; i < m_heldCount; i++) {
+    if (m_held[i] == key) {
+      bool wasSounding = i == m_heldCount - 1;
+      for (uint8_t j = i + 1; j < m_heldCount; j++) {
+        m_held[j - 1] = m_held[j];
+      }
+      m_heldCount--;
+      // Releasing a key that isn't sounding changes nothing you can hear.
+      if (wasSounding) {
+        sound();
+      }
+      return;
+    }
+  }
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::allNotesOff() {
+  m_heldCount = 0;
+  sound();
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::sound() {
+  if (m_heldCount > 0) {
+    // With a duration of 0, the backend keeps playing until it's told otherwise.
+    m_backend.play(tunedFrequency(m_held[m_heldCount - 1]), 0);
+  } else {
+    m_backend.stop();
+  }
+}
+
+template <typename Input, typename Backend>
+void LiveInstrument<Input, Backend>::printLatency() const {
+  Serial.print(m_noteCount);
+  Serial.print(" notes, latency max ");
+  Serial.print(m_maxLatency);
+  Serial.print("us, average ");
+  Serial.print(averageLatency());
+  Serial.print("us, ");
+  Serial.print(m_lateNotes);
+  Serial.println(" over the limit");
+}
+
+template <typename Input, typename Backend>
+bool LiveInstrument<Input, Backend>::task(void* context, unsigned long now, unsigned long& nextRun) {
+  return static_cast<LiveInstrument<Input, Backend>*>(context)->update(now, nextRun);
+}
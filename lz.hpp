@@ -0,0 +1,99 @@
+/// Defines compressed melodies and a source that decompresses them a note at a time while they play.
+
+// See note.hpp for an explanation of header guards.
+#ifndef LZ_HPP
+#define LZ_HPP
+
+#include "note.hpp"
+
+// Melodies repeat the same bytes over and over: the same few frequencies, the same durations, and (once offsets are
+// stored as the time since the previous note) the same gaps between notes. Compression takes advantage of that.
+//
+// This is LZSS, one of the LZ ("Lempel-Ziv") family of compression methods that zip files and PNG images also use.
+// The compressed data is a list of items, each of which is either:
+//
+//   * a literal: one byte that's copied to the output as it is, or
+//   * a match: "copy length bytes starting distance bytes back in the output". Repeated runs of notes become a single
+//     2-byte match instead of 6 bytes per note.
+//
+// Items come in groups of eight, after a flags byte whose bits say which items are literals (1) and which are matches
+// (0), starting from the lowest bit. A match is 2 bytes: distance - 1 and length - LZ_MIN_MATCH.
+//
+// Matches only reach back LZ_WINDOW_SIZE bytes, so the decompressor only has to remember the last 256 bytes it
+// produced (the "window"). It produces one note at a time, right when the player asks for it, so the whole song is
+// never decompressed into memory at once.
+//
+// Decompressed, each note is 6 little-endian bytes: frequency (2), time since the previous note started in
+// milliseconds (2), and duration (2). melody_creator does the compressing (see melody_creator/melody_creator/lz.py).
+//
+// Compressing a song only saves memory if it stays compressed where it's kept. On an AVR board (like the Uno), a plain
+// const array is copied from flash into RAM when the sketch starts, because normal pointers can only read RAM. With
+// only 2 KB of RAM, next to the 256-byte window, that would cost more than it saves. PROGMEM tells the compiler to
+// leave the array in flash only, and pgm_read_byte() reads a byte from there instead. So the compressed bytes must be
+// declared PROGMEM, as melody_creator prints them:
+//
+//   const uint8_t MY_MELODY_LZ_DATA[] PROGMEM = {...};
+
+/// How far back (in bytes) a match can reach. This is also the size of the decompressor's window.
+const uint16_t LZ_WINDOW_SIZE = 256;
+
+/// The shortest match. Anything shorter is cheaper as literals.
+const uint8_t LZ_MIN_MATCH = 3;
+
+/// The size of a decompressed note, in bytes.
+const uint8_t LZ_NOTE_SIZE = 6;
+
+// An aggregate, like PhraseMelody (see phrase.hpp).
+/// A compressed melody.
+struct LzMelody {
+  /// The compressed bytes, in flash (declared PROGMEM).
+  const uint8_t* data;
+  /// The number of compressed bytes.
+  uint16_t size;
+  /// The number of notes in the melody.
+  uint16_t noteCount;
+};
+
+/// Decompresses an LzMelody a note at a time. Can be used as a source for StreamPlayer (see stream_player.hpp).
+struct LzStream {
+
+  /// Constructs a stream that plays the given melody from the beginning.
+  explicit LzStream(const LzMelody& melody);
+
+  /// Goes back to the beginning of the melody.
+  void rewind();
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  // Returns the next decompressed byte. Also copies it into the window, since later matches may refer to it.
+  uint8_t readByte();
+  // Returns the next compressed byte from flash and moves past it.
+  uint8_t readData() { return pgm_read_byte(m_melody.data + m_position++); }
+
+  const LzMelody& m_melody;
+  // The position of the next compressed byte in m_melody.data.
+  uint16_t m_position;
+  uint16_t m_notesLeft;
+  // The flags of the current group, shifted so that the lowest bit is the next item's, and how many items are left.
+  uint8_t m_flags;
+  uint8_t m_itemsLeft;
+  // The match being copied: how far back it copies from, and how many bytes are still to be copied.
+  uint8_t m_matchDistance;
+  uint16_t m_matchLeft;
+  // The last 256 decompressed bytes. m_windowEnd is where the next one goes. Because it's a uint8_t, it goes back to 0
+  // after 255 by itself, which makes the window a ring buffer for free.
+  uint8_t m_window[LZ_WINDOW_SIZE];
+  uint8_t m_windowEnd;
+  // The offset of the latest note, in milliseconds.
+  unsigned long m_offset;
+
+};
+
+/// Decompresses the given melody runs times and prints how long it took per note and how many clock cycles that is
+/// per decompressed byte.
+void benchmarkLz(const LzMelody& melody, uint16_t runs);
+
+#endif /* LZ_HPP */
@@ -0,0 +1,88 @@
+// Implementations for the things declared in lz.hpp. See melody.ino for an explanation of why they're separated.
+#include "lz.hpp"
+
+LzStream::LzStream(const LzMelody& melody) : m_melody(melody) {
+  rewind();
+}
+
+void LzStream::rewind() {
+  m_position = 0;
+  m_notesLeft = m_melody.noteCount;
+  m_flags = 0;
+  m_itemsLeft = 0;
+  m_matchDistance = 0;
+  m_matchLeft = 0;
+  m_windowEnd = 0;
+  m_offset = 0;
+}
+
+uint8_t LzStream::readByte() {
+  uint8_t value;
+  if (m_matchLeft > 0) {
+    // Keep copying the current match. Subtracting from a uint8_t index wraps around the window automatically.
+    value = m_window[(uint8_t)(m_windowEnd - m_matchDistance)];
+    m_matchLeft--;
+  } else {
+    if (m_itemsLeft == 0) {
+      m_flags = m_position < m_melody.size ? readData() : 0xFF;
+      m_itemsLeft = 8;
+    }
+    bool isLiteral = m_flags & 1;
+    m_flags >>= 1;
+    m_itemsLeft--;
+    if (m_position + (isLiteral ? 1 : 2) > m_melody.size) {
+      // The data ended early. Returning zeros ends up playing nothing, instead of reading past the end.
+      return 0;
+    }
+    if (isLiteral) {
+      value = readData();
+    } else {
+      // The distance is stored minus 1 (a distance of 0 would be meaningless), so 0-255 means 1-256 bytes back.
+      m_matchDistance = readData() + 1;
+      m_matchLeft = readData() + LZ_MIN_MATCH;
+      // A distance of 256 doesn't fit in a uint8_t and becomes 0, which is exactly right: 256 bytes back in a
+      // 256-byte ring is the same place as m_windowEnd.
+      value = m_window[(uint8_t)(m_windowEnd - m_matchDistance)];
+      m_matchLeft--;
+    }
+  }
+  m_window[m_windowEnd++] = value;
+  return value;
+}
+
+bool LzStream::next(Note& note) {
+  if (m_notesLeft == 0) {
+    return false;
+  }
+  m_notesLeft--;
+  uint8_t bytes[LZ_NOTE_SIZE];
+  for (uint8_t i = 0; i < LZ_NOTE_SIZE; i++) {
+    bytes[i] = readByte();
+  }
+  m_offset += bytes[2] | (uint16_t)bytes[3] << 8;
+  note = Note(bytes[0] | (uint16_t)bytes[1] << 8, m_offset, bytes[4] | (uint16_t)bytes[5] << 8);
+  return true;
+}
+
+void benchmarkLz(const LzMelody& melody, uint16_t runs) {
+  LzStream stream(melody);
+  Note note;
+  unsigned long start = micros();
+  for (uint16_t run = 0; run < runs; run++) {
+    stream.rewind();
+    while (stream.next(note)) {}
+  }
+  unsigned long elapsed = micros() - start;
+  unsigned long notes = (unsigned long)melody.noteCount * runs;
+  if (notes == 0) {
+    return;
+  }
+  Serial.print(melody.noteCount * LZ_NOTE_SIZE);
+  Serial.print(" bytes from ");
+  Serial.print(melody.size);
+  Serial.print(" compressed: ");
+  Serial.print(elapsed / notes);
+  Serial.print("us per note, ");
+  Serial.print(elapsed * clockCyclesPerMicrosecond() / (notes * LZ_NOTE_SIZE));
+  Serial.println(" cycles per byte");
+}
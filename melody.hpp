@@ -6,6 +6,23 @@
 
 // We need stuff from note.hpp, so we include it here
 #include "note.hpp"
+#include "backend.hpp"
+
+// These two templates build the list of numbers 0, 1, ..., N - 1 as template arguments, which lets the constexpr
+// constructor of Melody below call a function once for every note. "size_t... I" is a "parameter pack": any number of
+// size_t values, and "f(I)..." repeats f(I) once for each of them. MakeIndexList<3> inherits from
+// MakeIndexList<2, 2>, which inherits from MakeIndexList<1, 1, 2>, then MakeIndexList<0, 0, 1, 2>, whose Type is
+// IndexList<0, 1, 2>. (Newer versions of C++ have std::make_index_sequence for this, but the Arduino IDE's doesn't.)
+/// An empty type holding a list of indexes as its template arguments.
+template <size_t... I>
+struct IndexList {};
+/// MakeIndexList<N>::Type is IndexList<0, 1, ..., N - 1>.
+template <size_t N, size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I>
+struct MakeIndexList<0, I...> {
+  typedef IndexList<I...> Type;
+};
 
 // Thanks to this for guiding me in creating what is basically a custom std::array for Notes: 
 // https://arduino.stackexchange.com/a/69178
@@ -21,13 +38,23 @@ struct Melody {
 
   // Unfortunately, using C arrays is weird. Thanks to this SO answer for resolving an issue I had:
   // https://stackoverflow.com/a/68745603
+  // A constexpr constructor can run while the program compiles, so a melody in songs.hpp is checked, sorted, and
+  // stored exactly as it will be played before the Arduino even starts, without any code running on it. The body of a
+  // constexpr constructor has to be empty, so the sorting happens while m_notes is initialized (see the private
+  // constructor below). Melodies can also be built out of other melodies this way (see compose.hpp).
   /// Constructs a new Melody object with the given notes. The notes are automatically sorted after being passed in.
-  Melody(const Note (&notes)[N]) : m_notes(notes) {
-    setup();
-  }
+  constexpr Melody(const Note (&notes)[N])
+      : Melody(notes, isSorted(notes, 0, N), typename MakeIndexList<N>::Type()) {}
+
+  // This one works the same way, but notes.note(i) must already return the notes in order.
+  // It's "explicit" so that a Generator is never turned into a Melody by accident.
+  /// Constructs a melody at compile time from notes.note(0), ..., notes.note(N - 1), where Generator is any type with
+  /// a constexpr member function "Note note(size_t index) const" (see compose.hpp and rtttl.hpp).
+  template <typename Generator>
+  explicit constexpr Melody(const Generator& notes) : Melody(notes, typename MakeIndexList<N>::Type()) {}
 
   /// Returns the length of the melody.
-  static size_t length() { return N; }
+  static constexpr size_t length() { return N; }
 
   // This member function header is a forward declaration. A forward declaration indicates to the compiler that the
   // thing in question exists, but it doesn't provide a definition. To make the program compile, we need to provide an
@@ -38,11 +65,12 @@ struct Melody {
   // this header file to read what's going on, and it allows us to hide implementation details from the client.
   // This overloads the indexing operator. It takes a single argument of size_t (the type used for indexes and lengths
   // of arrays) which indicates (starting from 0) which note in the array to get.
-  const Note& operator[](const size_t& index) const;
   // The & indicates that we are returning a reference to the Note. If the client assigns the result of the subscript
   // operator to a variable and modifies it, it will also modify the note in the melody.
-  // The const in the previous one prevents that, but it still saves memory by not copying the original Note.
   Note& operator[](const size_t& index);
+  // The const in this one prevents that, but it still saves memory by not copying the original Note. It's defined right
+  // here instead of in melody.ino because the compiler can only run a constexpr function once it has seen all of it.
+  constexpr const Note& operator[](const size_t& index) const { return m_notes[index]; }
 
   // The following member functions implement the C++ iterator pattern. An iterator must have two functions called
   // begin() and end() which return pointers to the first item and the memory immediately past the last item,
@@ -56,8 +84,45 @@ struct Melody {
 
 private:
 
-  // Setup is called by the constructor to run a few things after initializing all internal values.
-  void setup();
+  // A struct holding an array is the only way to pass an array around by value.
+  struct Ranks {
+    size_t of[N];
+  };
+
+  // The constexpr constructors above pass the list of indexes to these ones, which is called "delegating".
+  // Most melodies are already sorted, which isSorted() checks once. Otherwise, the rank of every note (how many notes
+  // come before it once sorted) is worked out, and the note that goes at index i is the one with rank i. That's a slow
+  // way to sort, but the compiler does it, not the Arduino.
+  template <size_t... I>
+  constexpr Melody(const Note (&notes)[N], bool sorted, IndexList<I...> indexes)
+      : Melody(notes, sorted, sorted ? Ranks{{I...}} : Ranks{{rankOf(notes, I, 0, N)...}}, indexes) {}
+  template <size_t... I>
+  constexpr Melody(const Note (&notes)[N], bool sorted, const Ranks& ranks, IndexList<I...>)
+      : m_notes{(sorted ? notes[I] : notes[indexOfRank(ranks, I, 0, N)])...} {}
+  template <typename Generator, size_t... I>
+  constexpr Melody(const Generator& notes, IndexList<I...>) : m_notes{notes.note(I)...} {}
+
+  // A constexpr function can't have loops, so these split their range [first, last) in half and call themselves on
+  // each half (which is called "divide and conquer"), until the range holds a single note.
+  // Returns whether the notes in [first, last) are sorted by offset.
+  static constexpr bool isSorted(const Note (&notes)[N], size_t first, size_t last) {
+    return last - first < 2 ? true
+         : isSorted(notes, first, (first + last) / 2) && isSorted(notes, (first + last) / 2, last)
+           && !(notes[(first + last) / 2 - 1] > notes[(first + last) / 2]);
+  }
+  // Returns how many notes in [first, last) come before notes[index] once sorted. Notes with the same offset keep their
+  // order.
+  static constexpr size_t rankOf(const Note (&notes)[N], size_t index, size_t first, size_t last) {
+    return last - first == 1 ? notes[index] > notes[first] || (!(notes[first] > notes[index]) && first < index)
+         : rankOf(notes, index, first, (first + last) / 2) + rankOf(notes, index, (first + last) / 2, last);
+  }
+  // Returns the index in [first, last) of the note with the given rank, or N if it isn't in that range.
+  static constexpr size_t indexOfRank(const Ranks& ranks, size_t rank, size_t first, size_t last) {
+    return last - first == 1 ? (ranks.of[first] == rank ? first : N)
+         : smaller(indexOfRank(ranks, rank, first, (first + last) / 2),
+                   indexOfRank(ranks, rank, (first + last) / 2, last));
+  }
+  static constexpr size_t smaller(size_t a, size_t b) { return a < b ? a : b; }
 
   // This is an array of size N (the length of the melody) storing notes.
   Note m_notes[N];
@@ -79,6 +144,27 @@ private:
 template <size_t length>
 void playMelody(uint8_t buzzerPin, const Melody<length>& melody);
 
+// Pointers to the first note and to the memory just past the last note are exactly what cbegin() and cend() return, so
+// this can play the notes of a Melody, a MelodyBuffer (see melody_buffer.hpp), or any other sorted array of notes.
+/// Plays the sorted notes in [first, last) by repeated tone() calls to the given pin. playMelody() uses this.
+void playNotes(uint8_t buzzerPin, const Note* first, const Note* last);
+
+// These two play on any backend (see backend.hpp) instead of tone(), e.g. playMelody(timerBackend, THRILLER).
+// A pin number could be passed as a Backend& too (Backend would be int), and the compiler would pick these over the
+// functions above, which need the int turned into a uint8_t. "-> decltype(backend.stop())" says the return type is
+// whatever backend.stop() returns (void), which only makes sense if Backend has a stop(). When it doesn't, the rule
+// called SFINAE ("substitution failure is not an error") quietly drops these from the choices instead of failing.
+/// Plays the sorted notes in [first, last) on the given backend.
+template <typename Backend>
+auto playNotes(Backend& backend, const Note* first, const Note* last) -> decltype(backend.stop());
+
+/// Waits until micros() reaches the given time. Like delay(), it does nothing else meanwhile.
+void waitUntil(unsigned long time);
+
+/// Plays the given melody on the given backend.
+template <typename Backend, size_t length>
+auto playMelody(Backend& backend, const Melody<length>& melody) -> decltype(backend.stop());
+
 // This is called a template specialization because we're indicating that something different should be done for a
 // specific set of arguments. This one is really simple: a specialization when there are no notes in the melody.
 // Because they don't matter here, names of arguments were omitted.
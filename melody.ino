@@ -6,18 +6,6 @@
 
 // Because we're no longer inside the Melody struct, we need to enter its namespace by typing out the name of the struct,
 // resolving its template arguments, and then using :: to find the thing we want.
-template <size_t N>
-void Melody<N>::setup() {
-  // After getting all the notes in the melody, they need to be sorted by offset to ensure everything is played in the
-  // correct order.
-  sortInPlace(m_notes);
-}
-
-template <size_t N>
-const Note& Melody<N>::operator[](const size_t& index) const {
-  return m_notes[index]; 
-}
-
 template <size_t N>
 Note& Melody<N>::operator[](const size_t& index) {
     return m_notes[index];
@@ -47,21 +35,46 @@ Note* Melody<N>::end() {
 
 template <size_t length>
 void playMelody(uint8_t buzzerPin, const Melody<length>& melody) {
-  // The -> is a combination of a dereference (getting the actual value the reference points to) and a member accessor.
-  // Another more verbose way to write the line below would be: delay((*melody.cbegin()).offset());
-  delay(melody.cbegin()->offset());
-  // This is called the iterator pattern for "for" loops, and it's much safer than using raw indices. We end one index
-  // early because special behavior is required for the final note.
-  for (const Note* note = melody.cbegin(); note < melody.cend() - 1; note++) {
+  playNotes(buzzerPin, melody.cbegin(), melody.cend());
+}
+
+void playNotes(uint8_t buzzerPin, const Note* first, const Note* last) {
+  ToneBackend backend(buzzerPin);
+  playNotes(backend, first, last);
+}
+
+template <typename Backend, size_t length>
+auto playMelody(Backend& backend, const Melody<length>& melody) -> decltype(backend.stop()) {
+  playNotes(backend, melody.cbegin(), melody.cend());
+}
+
+template <typename Backend>
+auto playNotes(Backend& backend, const Note* first, const Note* last) -> decltype(backend.stop()) {
+  // There's nothing to play (and no final note to treat specially) if the range is empty.
+  if (first >= last) {
+    return;
+  }
+  // delay() only waits whole milliseconds, which would throw away the fractions of a millisecond notes can start at (see
+  // note.hpp). Instead, every note waits on micros() for the time it's due, counted from the same start. Each wait
+  // ends wherever the melody should be by then, so a late note doesn't make all the notes after it late too.
+  unsigned long start = micros();
+  // This is called the iterator pattern for "for" loops, and it's much safer than using raw indices.
+  for (const Note* note = first; note < last; note++) {
+    // The -> is a combination of a dereference (getting the actual value the reference points to) and a member
+    // accessor. Another more verbose way to write the line below would be: waitUntil(start + (*note).offsetMicros());
+    waitUntil(start + note->offsetMicros());
     // This line actually plays the note at the given frequency and for the given duration.
-    tone(buzzerPin, note->frequency(), note->duration());
-    // delay() suspends execution for the given number of milliseconds. In this case, we're calculating the differences
-    // in offsets to determine the space between adjacent notes.
-    delay((note + 1)->offset() - note->offset());
+    backend.play(note->frequency(), note->duration());
+  }
+  // The final note needs to finish before the buzzer is silenced.
+  waitUntil(start + (last - 1)->endMicros());
+  backend.stop();
+}
+
+void waitUntil(unsigned long time) {
+  // See player.ino for why times are compared this way: it keeps working when micros() wraps around to 0.
+  while ((long)(micros() - time) < 0) {
   }
-  tone(buzzerPin, (melody.cend() - 1)->frequency(), (melody.cend() - 1)->duration());
-  delay((melody.cend() - 1)->duration());
-  noTone(buzzerPin);
 }
 
 // This implementation of the template specialization simply does nothing, because melodies of zero length don't really
@@ -69,21 +82,6 @@ void playMelody(uint8_t buzzerPin, const Melody<length>& melody) {
 template <>
 void playMelody<0>(uint8_t, const Melody<0>&) {}
 
-// This particular algorithm sorts notes by offset using insertion sort. This algorithm was chosen because its memory
-// use grows at O(1) in the worst case (i.e., it doesn't grow) and the target machine (an Arduino) has very little
-// memory capacity.
-/// Sorts the given Note array in place.
-template <size_t N>
-void sortInPlace(Note (&notes)[N]) {
-  for (size_t i = 1; i < N; i++) {
-    for (int j = i; j >= 0; j--) {
-      if (notes[j - 1] > notes[j]) {
-        swap(notes[j - 1], notes[j]);
-      }
-    }
-  }
-}
-
 /// Swaps the contents of the variables passed in.
 template <typename T>
 void swap(T& a, T& b) {
@@ -0,0 +1,61 @@
+/// Defines a melody that is built while the program runs, stored in memory provided by the caller.
+
+// See note.hpp for an explanation of header guards.
+#ifndef MELODY_BUFFER_HPP
+#define MELODY_BUFFER_HPP
+
+#include "melody.hpp"
+
+// Melody<N> needs to know how many notes it has when the program is compiled. That's perfect for songs.hpp, but not
+// for melodies that are received over Serial or generated while the program runs. A MelodyBuffer fills that gap
+// without ever calling new or malloc(): the caller declares an array of notes (the "arena") that is big enough for the
+// longest melody they expect, and the buffer keeps track of how much of it is used. For example:
+//
+//   Note arena[64];
+//   MelodyBuffer melody(arena);
+//   melody.append(Note(440, 0, 250));
+//   playMelody(BUZZER_PIN, melody);
+//
+// Declaring the arena outside of any function (or as static) means its memory is reserved when the program is
+// compiled, so the Arduino IDE includes it in the memory use it reports.
+/// A sorted melody stored in a caller-supplied array of notes.
+struct MelodyBuffer {
+
+  /// Constructs an empty melody that stores up to capacity notes in the given arena.
+  MelodyBuffer(Note* arena, size_t capacity) : m_notes(arena), m_capacity(capacity), m_length(0) {}
+
+  // Passing the array itself (instead of a pointer and a length) lets the compiler fill in the capacity.
+  /// Constructs an empty melody that stores its notes in the given arena.
+  template <size_t N>
+  explicit MelodyBuffer(Note (&arena)[N]) : MelodyBuffer(arena, N) {}
+
+  /// Adds a note to the melody, keeping the melody sorted. Returns false if the arena is full.
+  bool append(const Note& note);
+
+  /// Removes every note from the melody.
+  void clear() { m_length = 0; }
+
+  /// Returns the number of notes in the melody.
+  size_t length() const { return m_length; }
+
+  /// Returns the largest number of notes the melody can hold.
+  size_t capacity() const { return m_capacity; }
+
+  // Unlike Melody<N>, there's no non-const subscript operator or begin()/end(), because changing a note's offset
+  // through them could leave the melody unsorted.
+  const Note& operator[](const size_t& index) const { return m_notes[index]; }
+  const Note* cbegin() const { return m_notes; }
+  const Note* cend() const { return m_notes + m_length; }
+
+private:
+
+  Note* m_notes;
+  size_t m_capacity;
+  size_t m_length;
+
+};
+
+/// Plays the given melody by repeated tone() calls to the given pin.
+void playMelody(uint8_t buzzerPin, const MelodyBuffer& melody);
+
+#endif /* MELODY_BUFFER_HPP */
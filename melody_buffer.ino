@@ -0,0 +1,26 @@
+// Implementations for the things declared in melody_buffer.hpp. See melody.ino for an explanation of why they're
+// separated.
+#include "melody_buffer.hpp"
+
+bool MelodyBuffer::append(const Note& note) {
+  if (m_length >= m_capacity) {
+    return false;
+  }
+  // Notes almost always arrive in order, so the loop below usually stops right away and appending takes the same
+  // (constant) time no matter how long the melody is. When a note arrives early, this is one step of insertion sort,
+  // the way most people sort a hand of cards: later notes are moved back one place until the gap is where the note
+  // belongs. That only costs time for the notes it has to move, and the melody never needs sorting as a whole.
+  size_t i = m_length;
+  while (i > 0 && m_notes[i - 1] > note) {
+    m_notes[i] = m_notes[i - 1];
+    i--;
+  }
+  m_notes[i] = note;
+  m_length++;
+  return true;
+}
+
+void playMelody(uint8_t buzzerPin, const MelodyBuffer& melody) {
+  // This is the same function that plays Melody objects, so runtime melodies and songs from songs.hpp sound the same.
+  playNotes(buzzerPin, melody.cbegin(), melody.cend());
+}
@@ -1,24 +1,92 @@
 # The __main__ file is executed when executing the entire module.
 import argparse
 import sys
+from fractions import Fraction
 from pathlib import Path
 
-import music21 as m21
-
+from melody_creator import bytecode
+from melody_creator.library import add_to_library
 from melody_creator.melody import Melody
+from melody_creator.midi import read_midi
+from melody_creator.phrases import PhraseMelody
+from melody_creator.ticks import TickMelody, get_tempo_changes
+from melody_creator.voices import get_cpp_string as get_voices_cpp_string, get_timeline_cpp_string, split_melody
+
+MIDI_SUFFIXES = ('.mid', '.midi')
+"""File extensions of Standard MIDI Files, which are read without music21 (see midi.py)."""
 
 
-def run(music_path: Path, var_name: str, sample_audio_path: Path | None = None) -> None:
+def run(music_path: Path, var_name: str, sample_audio_path: Path | None = None, upload_port: str | None = None,
+        library_path: Path | None = None, phrases: bool = False, repeats: bool = False,
+        as_bytecode: bool = False, ticks: bool = False, arpeggio_rate: int = 0, voices: int | None = None,
+        interleave: bool = False, velocities: bool = False, expression: bool = False) -> None:
     """Runs the main bulk of the program."""
-    # First parse the MusicXML file.
-    stream = m21.converter.parseFile(music_path)
-    # Then convert to a Melody.
-    melody = Melody.from_stream(stream)
-    # Then print the C++ definition required to define the melody.
-    print(melody.get_cpp_string(var_name))
+    if interleave and voices is None:
+        raise ValueError('--interleave only works with --voices')
+    if velocities and (phrases or repeats or as_bytecode or ticks or voices is not None):
+        raise ValueError('--dynamics only works when printing a Melody')
+    if expression and (phrases or repeats or as_bytecode or ticks or voices is not None):
+        raise ValueError('--expression only works when printing a Melody')
+    if music_path.suffix.lower() in MIDI_SUFFIXES:
+        # MIDI files are read directly, which is much faster than music21. They have no repeat signs to keep.
+        if repeats:
+            raise ValueError('MIDI files have no repeat signs, so --keep-repeats only works with MusicXML files')
+        song = read_midi(music_path)
+        stream = None
+        melody = song.melody
+        tempo_changes = song.tempo_changes
+    else:
+        # music21 takes a few seconds to import, so it's only imported when it's needed.
+        import music21 as m21
+        # First parse the MusicXML file.
+        stream = m21.converter.parseFile(music_path)
+        # Then convert to a Melody.
+        melody = Melody.from_stream(stream, chords=voices is not None, ornaments=expression)
+        tempo_changes = get_tempo_changes(stream)
+    # Then print the C++ definition required to define the melody, either as a list of notes, as phrases (see
+    # phrase.hpp), which takes less memory when the melody repeats itself, keeping the score's repeat signs as loops
+    # (see sections.hpp), as bytecode (see bytecode.hpp), timed in ticks with the score's tempo changes (see
+    # ticks.hpp), or split into voices that each play one note at a time (see voices.py).
+    if phrases:
+        print(PhraseMelody.from_notes(melody.get_machine_notes()).get_cpp_string(var_name))
+    elif repeats:
+        # sections.py needs music21 too.
+        from melody_creator.sections import SectionMelody
+        print(SectionMelody.from_stream(stream).get_cpp_string(var_name))
+    elif as_bytecode:
+        # Bytecode counts time in ticks of a quarter note, so it needs the tempo in quarter notes per minute.
+        beats_per_minute = melody.tempo.convert_to_subdivision(Fraction(1, 4)).beats_per_minute
+        assembly = bytecode.from_notes(melody.get_machine_notes(), beats_per_minute)
+        print(bytecode.get_cpp_string(bytecode.assemble(assembly), var_name))
+    elif ticks:
+        print(TickMelody.from_melody(melody, tempo_changes).get_cpp_string(var_name))
+    elif voices is not None:
+        voice_melodies, dropped = split_melody(melody, voices)
+        if interleave:
+            print(get_timeline_cpp_string(voice_melodies, var_name))
+        else:
+            print(get_voices_cpp_string(voice_melodies, var_name))
+        if dropped:
+            print(f'WARNING: {dropped} notes were left out because all {voices} voices were busy', file=sys.stderr)
+    else:
+        print(melody.get_cpp_string(var_name))
+        # The velocities and expressions go in arrays of their own, so melodies without them take no more memory (see
+        # envelope.hpp).
+        if velocities:
+            print(melody.get_velocities_cpp_string(var_name))
+        if expression:
+            print(melody.get_expressions_cpp_string(var_name))
     # If the user enabled saving a sample to a file, then do that.
     if sample_audio_path is not None:
-        melody.get_audio_segment().export(sample_audio_path)
+        melody.get_audio_segment(arpeggio_rate).export(sample_audio_path)
+    # If the user gave a library file, add the melody to it under its variable name (see library.hpp).
+    if library_path is not None:
+        add_to_library(library_path, var_name, melody.get_machine_notes())
+    # If the user gave a serial port, send the melody to the Arduino (see receiver.hpp) so it plays right away.
+    if upload_port is not None:
+        # This import is here instead of at the top so that pyserial is only needed when uploading.
+        from melody_creator.upload import upload_to_port
+        upload_to_port(upload_port, melody.get_machine_notes())
 
 
 def main() -> None:
@@ -27,25 +95,68 @@ def main() -> None:
     # This part allows us to set up arguments to the executable.
     parser = argparse.ArgumentParser()
     parser.add_argument('music_path', type=Path,
-                        help='Path to a MusicXML (or compressed MusicXML) file from which the melody will be read. '
-                             'It\'s expected for the file only to have a single part and no chords.')
+                        help='Path to a MusicXML (or compressed MusicXML) file or a Standard MIDI File (.mid) from '
+                             'which the melody will be read. It\'s expected for the file only to have a single part '
+                             'and no chords, unless --voices is given.')
     parser.add_argument('-n', '--name', dest='var_name', type=str, default='MY_MELODY',
                         help='The name of the printed variable. Must be a valid C++ variable name.')
     parser.add_argument('-s', '--export-sample-audio', dest='sample_audio_path', type=Path,
                         metavar='OUTPUT_FILE',
                         help='Export a sample of what the melody will sound like when played on an Arduino to a file. '
                              'Most common audio file formats are supported.')
+    parser.add_argument('-a', '--arpeggio', dest='arpeggio_rate', type=int, default=0, metavar='RATE',
+                        help='Make the sample play chords the way a MelodyPlayer does after setArpeggioRate(RATE) (see '
+                             'player.hpp): one note at a time, switching RATE times per second (30 to 60 works well).')
+    # Only one of these can be given, since they're different ways of printing the melody.
+    output_format = parser.add_mutually_exclusive_group()
+    output_format.add_argument('-p', '--phrases', action='store_true', default=False,
+                               help='Print the melody as a phrase table (see phrase.hpp), which stores repeated parts '
+                                    'only once, instead of as a Melody.')
+    output_format.add_argument('-r', '--keep-repeats', dest='repeats', action='store_true', default=False,
+                               help='Print the melody as sections (see sections.hpp) that keep the repeat signs, '
+                                    'voltas, D.C., and D.S. of the score as loops. Without this, repeated parts are '
+                                    'only played once.')
+    output_format.add_argument('-b', '--bytecode', dest='as_bytecode', action='store_true', default=False,
+                               help='Print the melody as bytecode for a BytecodeMachine (see bytecode.hpp).')
+    output_format.add_argument('-k', '--ticks', action='store_true', default=False,
+                               help='Print the melody as a TickMelody (see ticks.hpp), timed in ticks of a quarter '
+                                    'note with every tempo change in the score, instead of in milliseconds.')
+    output_format.add_argument('-v', '--voices', type=int, metavar='N',
+                               help='Split chords and parts into N voices that each play one note at a time (0 for '
+                                    'as many as it takes), and print each voice as its own Melody, highest first.')
+    parser.add_argument('-i', '--interleave', action='store_true', default=False,
+                        help='With --voices, print the voices as a single Melody with an array holding the voice of '
+                             'each note, instead of one Melody per voice.')
+    parser.add_argument('-d', '--dynamics', dest='velocities', action='store_true', default=False,
+                        help='Also print the velocity of each note, worked out from the dynamics markings of the score '
+                             '(or the velocities of a MIDI file), for an EnvelopePlayer (see envelope.hpp).')
+    parser.add_argument('-e', '--expression', action='store_true', default=False,
+                        help='Also print the expression of each note for an EnvelopePlayer (see modulation.hpp): '
+                             'glides for slurs, bends for scoops and plops, vibrato for long notes, and trills, '
+                             'mordents, turns, and grace notes as ornaments of their notes instead of as notes.')
+    parser.add_argument('-l', '--add-to-library', dest='library_path', type=Path, metavar='LIBRARY_FILE',
+                        help='Add the melody (named by --name) to a binary library file, creating it if needed. '
+                             'Library files can be read from an SD card or quickly loaded on a computer.')
+    parser.add_argument('-u', '--upload', dest='upload_port', type=str, metavar='PORT',
+                        help='Upload the melody to an Arduino running a MelodyReceiver on the given serial port '
+                             '(e.g. /dev/ttyACM0 or COM3). It starts playing while it is being uploaded.')
     parser.add_argument('-t', '--print-traceback', dest='print_traceback', action='store_true', default=False,
                         help='Print full tracebacks of errors raised during the program\'s execution.')
 
     namespace = parser.parse_args()
     if namespace.print_traceback:
-        run(namespace.music_path, namespace.var_name, namespace.sample_audio_path)
+        run(namespace.music_path, namespace.var_name, namespace.sample_audio_path, namespace.upload_port,
+            namespace.library_path, namespace.phrases, namespace.repeats,
+            namespace.as_bytecode, namespace.ticks, namespace.arpeggio_rate, namespace.voices, namespace.interleave,
+            namespace.velocities, namespace.expression)
     else:
         # Instead of printing out the entire traceback, we just print the messages of errors that occur. The user can
         # enable typical behavior by setting the --print-traceback flag.
         try:
-            run(namespace.music_path, namespace.var_name, namespace.sample_audio_path)
+            run(namespace.music_path, namespace.var_name, namespace.sample_audio_path, namespace.upload_port,
+                namespace.library_path, namespace.phrases, namespace.repeats,
+                namespace.as_bytecode, namespace.ticks, namespace.arpeggio_rate, namespace.voices, namespace.interleave,
+                namespace.velocities, namespace.expression)
         except Exception as e:
             print(f'ERROR ({type(e).__name__}): {e}\n', file=sys.stderr)
             sys.exit(1)
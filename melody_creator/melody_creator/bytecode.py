@@ -0,0 +1,275 @@
+"""
+An assembler and disassembler for melody bytecode, the instructions run by BytecodeMachine on the Arduino. See
+bytecode.hpp for what each instruction does.
+
+Assembly is one instruction per line, with an optional label ("chorus:") before it and an optional comment after a ';':
+
+    tempo 120
+    loop 2
+      call riff
+    end_loop
+    transpose 5      ; the same riff, a fourth higher
+    call riff
+    end
+    riff:
+      note E4 24 20  ; pitch, length in ticks, and how many of those ticks the note sounds
+      rest 24
+      note G4 48 44
+      return
+
+Pitches can be written as names (C4, F#3, Bb5) or MIDI note numbers. Assemble, disassemble, or convert songs with:
+
+    python3 -m melody_creator.bytecode assemble song.asm -n MY_SONG
+    python3 -m melody_creator.bytecode disassemble my_song.hpp -n MY_SONG
+    python3 -m melody_creator.bytecode convert songs.hpp -n THRILLER
+"""
+
+import argparse
+import re
+import sys
+from collections.abc import Sequence
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+from melody_creator.phrases import pitch_of
+from melody_creator.songs_file import read_songs
+
+TICKS_PER_QUARTER = 48
+"""The number of ticks in a quarter note (BYTECODE_TICKS_PER_QUARTER in bytecode.hpp)."""
+
+OPERANDS = {
+    'end': (),
+    'note': ('pitch', 'byte', 'byte'),
+    'rest': ('byte',),
+    'tempo': ('byte',),
+    'transpose': ('signed',),
+    'call': ('address',),
+    'return': (),
+    'loop': ('byte',),
+    'end_loop': (),
+    'jump': ('address',),
+}
+"""The kinds of operands of every instruction. Opcodes are numbered in this order, like BytecodeOpcode."""
+OPCODES = {name: opcode for opcode, name in enumerate(OPERANDS)}
+"""The opcode of every instruction."""
+OPERAND_SIZES = {'pitch': 1, 'byte': 1, 'signed': 1, 'address': 2}
+"""The size of every kind of operand, in bytes."""
+
+_PITCH_CLASSES = {'C': 0, 'D': 2, 'E': 4, 'F': 5, 'G': 7, 'A': 9, 'B': 11}
+_PITCH_NAMES = ['C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B']
+_PITCH_PATTERN = re.compile(r'([A-Ga-g])([#b]*)(-?\d+)')
+_LABEL_PATTERN = re.compile(r'[A-Za-z_][A-Za-z0-9_]*')
+
+
+class AssemblyError(ValueError):
+    """Raised when assembly can't be assembled. The message says which line is wrong and why."""
+
+
+def parse_pitch(text: str) -> int:
+    """Returns the MIDI note number of a pitch written as a name (e.g. C4, F#3, or Bb5) or a number."""
+    if text.isdigit():
+        return int(text)
+    match = _PITCH_PATTERN.fullmatch(text)
+    if match is None:
+        raise ValueError(f'{text} is not a pitch')
+    letter, accidentals, octave = match.groups()
+    # Middle C (C4) is MIDI note number 60, and each octave is 12 semitones.
+    return 12 * (int(octave) + 1) + _PITCH_CLASSES[letter.upper()] + accidentals.count('#') - accidentals.count('b')
+
+
+def pitch_name(pitch: int) -> str:
+    """Returns the name of a MIDI note number, e.g. C#4 for 61."""
+    return f'{_PITCH_NAMES[pitch % 12]}{pitch // 12 - 1}'
+
+
+def assemble(source: str) -> bytes:
+    """Assembles the given assembly into bytecode. Raises an AssemblyError if it's not valid."""
+    # The first pass finds out where every label is, so that instructions can refer to labels further down (like
+    # "call riff" above). The second pass writes the bytes.
+    lines = []
+    labels = {}
+    address = 0
+    for number, line in enumerate(source.splitlines(), start=1):
+        line = line.split(';', 1)[0].strip()
+        if ':' in line:
+            label, line = (part.strip() for part in line.split(':', 1))
+            if _LABEL_PATTERN.fullmatch(label) is None or label in labels:
+                raise AssemblyError(f'line {number}: bad or repeated label "{label}"')
+            labels[label] = address
+        if not line:
+            continue
+        name, *operands = line.split()
+        name = name.lower()
+        if name not in OPERANDS:
+            raise AssemblyError(f'line {number}: unknown instruction "{name}"')
+        if len(operands) != len(OPERANDS[name]):
+            raise AssemblyError(f'line {number}: {name} needs {len(OPERANDS[name])} operands, not {len(operands)}')
+        lines.append((number, name, operands))
+        address += 1 + sum(OPERAND_SIZES[kind] for kind in OPERANDS[name])
+
+    code = bytearray()
+    for number, name, operands in lines:
+        code.append(OPCODES[name])
+        for kind, operand in zip(OPERANDS[name], operands):
+            try:
+                if kind == 'address':
+                    value = labels[operand] if operand in labels else int(operand, 0)
+                    code += value.to_bytes(2, 'little')
+                elif kind == 'pitch':
+                    code += parse_pitch(operand).to_bytes(1)
+                else:
+                    code += int(operand, 0).to_bytes(1, signed=kind == 'signed')
+            except (ValueError, OverflowError) as e:
+                raise AssemblyError(f'line {number}: bad operand "{operand}" for {name} ({e})') from e
+    if len(code) > 0xFFFF:
+        raise AssemblyError('the bytecode is longer than 65535 bytes')
+    return bytes(code)
+
+
+def disassemble(code: bytes) -> str:
+    """Turns bytecode back into assembly. Places that are called or jumped to get labels like L0012 (the address)."""
+    # The first pass splits the bytecode into instructions and finds every address that's called or jumped to.
+    instructions = []
+    targets = set()
+    position = 0
+    while position < len(code):
+        opcode = code[position]
+        if opcode >= len(OPCODES):
+            instructions.append((position, f'; unknown opcode {opcode}', ()))
+            position += 1
+            continue
+        name = list(OPERANDS)[opcode]
+        operands = []
+        cursor = position + 1
+        for kind in OPERANDS[name]:
+            size = OPERAND_SIZES[kind]
+            if cursor + size > len(code):
+                break
+            value = int.from_bytes(code[cursor:cursor + size], 'little', signed=kind == 'signed')
+            if kind == 'address':
+                targets.add(value)
+            operands.append((kind, value))
+            cursor += size
+        instructions.append((position, name, operands))
+        position = cursor
+
+    lines = []
+    for position, name, operands in instructions:
+        if position in targets:
+            lines.append(f'L{position:04X}:')
+        words = [name]
+        for kind, value in operands:
+            words.append(f'L{value:04X}' if kind == 'address' else pitch_name(value) if kind == 'pitch' else str(value))
+        if len(operands) < len(OPERANDS.get(name, ())):
+            words.append('; cut off')
+        lines.append('  ' + ' '.join(words))
+    return '\n'.join(lines)
+
+
+def from_notes(notes: Sequence[MachineNote], beats_per_minute: int = 120) -> str:
+    """
+    Returns assembly that plays the given notes.
+    :param notes: The notes to play.
+    :param beats_per_minute: The tempo (in quarter notes per minute) used to turn milliseconds into ticks. Use the
+    tempo the song was written at, so that notes land exactly on ticks.
+    """
+    millis_per_tick = 60_000 / (beats_per_minute * TICKS_PER_QUARTER)
+    lines = [f'tempo {beats_per_minute}']
+    notes = sorted(notes, key=lambda n: n.exact_offset_millis)
+    # Every note's offset is rounded from the start of the song (not from the previous note) so that rounding errors
+    # never add up.
+    ticks = [round(n.exact_offset_millis / millis_per_tick) for n in notes]
+    position = 0
+    for index, note in enumerate(notes):
+        if ticks[index] > position:
+            gap = ticks[index] - position
+            while gap > 0:
+                lines.append(f'rest {min(gap, 255)}')
+                gap -= min(gap, 255)
+        sound = min(max(round(note.duration_millis / millis_per_tick), 1), 255)
+        # A note lasts until the next one starts. The last note lasts as long as it sounds.
+        length = ticks[index + 1] - ticks[index] if index + 1 < len(notes) else sound
+        lines.append(f'note {pitch_name(pitch_of(note.frequency))} {min(length, 255)} {sound}')
+        # Lengths over 255 ticks don't fit in a byte, so the rest of the length is a rest.
+        position = ticks[index] + min(length, 255)
+    lines.append('end')
+    return '\n'.join(lines)
+
+
+def get_cpp_string(code: bytes, variable_name: str = 'MY_MELODY') -> str:
+    """Returns the source code of a C++ byte array holding the given bytecode, one instruction per line with its
+    assembly in a comment."""
+    lines = []
+    position = 0
+    for line in disassemble(code).splitlines():
+        if line.endswith(':'):
+            lines.append(f'  // {line}')
+            continue
+        name = line.split()[0]
+        size = 1 + sum(OPERAND_SIZES[kind] for kind in OPERANDS.get(name, ()))
+        lines.append(f'  {", ".join(str(b) for b in code[position:position + size])},  // {line.strip()}')
+        position += size
+    return f'const uint8_t {variable_name}[] = {{\n{'\n'.join(lines)}\n}};'
+
+
+_ARRAY_PATTERN = r'uint8_t\s+{name}\s*\[\s*\d*\s*\]\s*=\s*\{{(.*?)\}};'
+
+
+def read_bytecode(path: Path, name: str) -> bytes:
+    """Reads a byte array (as printed by get_cpp_string()) with the given name from a C++ file."""
+    source = re.sub(r'//[^\n]*', '', Path(path).read_text())
+    match = re.search(_ARRAY_PATTERN.format(name=re.escape(name)), source, re.DOTALL)
+    if match is None:
+        raise ValueError(f'no byte array called {name} in {path}')
+    return bytes(int(value, 0) for value in match.group(1).replace(',', ' ').split())
+
+
+def main() -> None:
+    """Assembles, disassembles, or converts melodies to bytecode."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.bytecode',
+                                     description='Assemble and disassemble melody bytecode (see bytecode.hpp).')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+    assemble_parser = subparsers.add_parser('assemble', help='Print the bytecode of an assembly file as C++.')
+    assemble_parser.add_argument('path', type=Path, help='The assembly file.')
+    disassemble_parser = subparsers.add_parser('disassemble',
+                                               help='Print a bytecode array from a C++ file as assembly.')
+    disassemble_parser.add_argument('path', type=Path, help='The C++ file.')
+    convert_parser = subparsers.add_parser('convert',
+                                           help='Print a melody from a C++ file (e.g. songs.hpp) as bytecode.')
+    convert_parser.add_argument('path', type=Path, help='The C++ file.')
+    convert_parser.add_argument('-b', '--bpm', type=int, default=120,
+                                help='The tempo of the song in quarter notes per minute (default 120).')
+    convert_parser.add_argument('-a', '--assembly', action='store_true', default=False,
+                                help='Print assembly instead of C++.')
+    for subparser in (assemble_parser, disassemble_parser):
+        subparser.add_argument('-n', '--name', dest='var_name', type=str, default='MY_MELODY',
+                               help='The name of the C++ variable to print or read.')
+    convert_parser.add_argument('-n', '--name', dest='var_name', type=str,
+                                help='The name of the melody to convert. Defaults to the first one in the file.')
+    namespace = parser.parse_args()
+
+    try:
+        if namespace.command == 'assemble':
+            print(get_cpp_string(assemble(namespace.path.read_text()), namespace.var_name))
+        elif namespace.command == 'disassemble':
+            print(disassemble(read_bytecode(namespace.path, namespace.var_name)))
+        else:
+            songs = read_songs(namespace.path)
+            if not songs:
+                sys.exit(f'ERROR: no melodies found in {namespace.path}')
+            name = namespace.var_name or next(iter(songs))
+            if name not in songs:
+                sys.exit(f'ERROR: {name} not found in {namespace.path}')
+            notes = songs[name]
+            assembly = from_notes(notes, namespace.bpm)
+            code = assemble(assembly)
+            print(assembly if namespace.assembly else get_cpp_string(code, name + '_BYTECODE'))
+            # The report goes to stderr so that the output can be redirected into a file on its own.
+            print(f'{name}: {len(notes)} notes, {8 * len(notes)} bytes as a Melody, {len(code)} bytes as bytecode',
+                  file=sys.stderr)
+    except ValueError as e:
+        sys.exit(f'ERROR: {e}')
+
+
+if __name__ == '__main__':
+    main()
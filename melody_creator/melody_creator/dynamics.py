@@ -0,0 +1,31 @@
+"""Definitions for the velocities (loudness, from 1 to 127 like in MIDI) of dynamics markings."""
+
+# These are the velocities most notation programs play dynamics markings at. Accents like sfz aren't here, since they
+# only apply to a single note; their volume is worked out from music21 instead (see velocity_of()).
+VELOCITIES = {
+    'pppp': 8,
+    'ppp': 16,
+    'pp': 33,
+    'p': 49,
+    'mp': 64,
+    'mf': 80,
+    'f': 96,
+    'ff': 112,
+    'fff': 127,
+    'ffff': 127,
+}
+DEFAULT_VELOCITY = VELOCITIES['mf']
+"""The velocity of notes before the first dynamics marking (DEFAULT_VELOCITY in envelope.hpp)."""
+
+
+def velocity_of(value: str, volume_scalar: float | None = None) -> int:
+    """
+    Returns the velocity of a dynamics marking.
+    :param value: The marking, e.g. 'mf'.
+    :param volume_scalar: The volume music21 gives the marking (from 0 to 1), used if it isn't in VELOCITIES (optional).
+    """
+    if value in VELOCITIES:
+        return VELOCITIES[value]
+    if volume_scalar is not None:
+        return max(1, min(127, round(volume_scalar * 127)))
+    return DEFAULT_VELOCITY
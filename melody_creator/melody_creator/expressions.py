@@ -0,0 +1,53 @@
+"""
+Definitions for the expressions of notes, which tell an EnvelopePlayer how to bend their pitch (see modulation.hpp).
+The bottom four bits of an expression are flags, one bit each, so a note can have any of them at once. The top four
+bits are the number of an ornament in ORNAMENTS.
+"""
+
+GLIDE = 0x01
+"""The note slides from the pitch of the note before it (portamento), like the notes of a slur after the first."""
+VIBRATO = 0x02
+"""The pitch of the note wobbles up and down once it's been held for a moment."""
+SCOOP = 0x04
+"""The note starts a semitone low and slides up into its pitch."""
+PLOP = 0x08
+"""The note starts a semitone high and slides down into its pitch."""
+ORNAMENT = 0xF0
+"""The bits of an expression that hold its ornament: its number in ORNAMENTS, shifted left by 4."""
+
+VIBRATO_MIN_MILLIS = 400
+"""Notes that sound at least this long (in milliseconds) get vibrato. Shorter ones end before it would be heard."""
+
+ORNAMENTS: list[tuple[tuple[int, ...], bool]] = [
+    ((), False),  # None
+    ((0, 1), True),  # Trills
+    ((0, 2), True),
+    ((0, -1), False),  # Mordents
+    ((0, -2), False),
+    ((0, 1), False),  # Inverted mordents
+    ((0, 2), False),
+    ((2, 0, -1), False),  # Turns
+    ((2, 0, -2), False),
+    ((1, 0, -2), False),
+    ((-1, 0, 2), False),  # Inverted turns
+    ((-2, 0, 2), False),
+    ((1,), False),  # Grace notes
+    ((2,), False),
+    ((-1,), False),
+    ((-2,), False),
+]
+"""
+The ornaments an expression can hold, by number (ORNAMENTS in modulation.hpp): the semitones from the note of each of
+the quick notes played before it, and whether they repeat until the note ends, like a trill.
+"""
+
+
+def ornament_expression(steps: tuple[int, ...], repeats: bool = False) -> int | None:
+    """
+    Returns the expression (with only the ornament bits set) of the ornament with the given steps, or None if it isn't
+    in ORNAMENTS.
+    """
+    try:
+        return ORNAMENTS.index((steps, repeats)) << 4
+    except ValueError:
+        return None
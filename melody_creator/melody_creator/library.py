@@ -0,0 +1,149 @@
+"""
+Reads and writes melody library files: one file holding many songs, each found by name. See library.hpp for the format
+and for the Arduino code that reads it from an SD card, and host/melody_archive.hpp for a fast reader for computers.
+
+Build a library from the songs in one or more C++ files with:
+
+    python3 -m melody_creator.library songs.mlib songs.hpp more_songs.hpp
+"""
+
+import argparse
+import struct
+import sys
+from collections.abc import Mapping, Sequence
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+from melody_creator.songs_file import read_songs
+
+MAGIC = b'MLIB'
+VERSION = 1
+HEADER_SIZE = 16
+SLOT_SIZE = 16
+NOTE_RECORD = struct.Struct('<HIH')
+"""A note record: frequency (unsigned 16-bit), offset (unsigned 32-bit), and duration (unsigned 16-bit)."""
+
+
+def hash_name(name: str) -> int:
+    """Returns the 32-bit FNV-1a hash of the name, exactly like hashName() in library.ino. Never returns 0."""
+    value = 2166136261
+    for byte in name.encode():
+        # The & keeps only the lowest 32 bits, which is what happens automatically to a 32-bit number on the Arduino.
+        value = ((value ^ byte) * 16777619) & 0xFFFFFFFF
+    return value or 1
+
+
+def pack_notes(notes: Sequence[MachineNote]) -> bytes:
+    """Packs notes (sorted by offset) into 8-byte little-endian records."""
+    try:
+        return b''.join(NOTE_RECORD.pack(n.frequency, n.offset_millis, n.duration_millis)
+                        for n in sorted(notes, key=lambda n: n.offset_millis))
+    except struct.error as e:
+        raise ValueError(f'a note does not fit in a note record: {e}') from e
+
+
+def build_library(songs: Mapping[str, Sequence[MachineNote]]) -> bytes:
+    """
+    Returns the bytes of a library file holding the given songs.
+    :param songs: A map from the name of each song to its notes.
+    """
+    # The index needs at least twice as many slots as songs so that lookups almost never have to look past one slot.
+    # A power of two makes the modulo a cheap operation on the Arduino.
+    slot_count = 1
+    while slot_count < 2 * len(songs):
+        slot_count *= 2
+    if slot_count > 0xFFFF:
+        raise ValueError(f'too many songs ({len(songs)}) for one library')
+
+    names = b''
+    name_positions = {}
+    names_start = HEADER_SIZE + slot_count * SLOT_SIZE
+    for name in songs:
+        name_positions[name] = names_start + len(names)
+        names += name.encode() + b'\0'
+
+    # The notes of each song are collected in a list and joined at the end, which is much faster than adding bytes
+    # objects together one song at a time.
+    notes: list[bytes] = []
+    notes_size = 0
+    # Notes start at a multiple of 4 bytes so that readers on computers can access the numbers in them directly.
+    notes_start = (names_start + len(names) + 3) // 4 * 4
+    slots: list[tuple[int, int, int, int] | None] = [None] * slot_count
+    hashes = set()
+    for name, song_notes in songs.items():
+        name_hash = hash_name(name)
+        if name_hash in hashes:
+            raise ValueError(f'{name} has the same hash as another song; please rename one of them')
+        hashes.add(name_hash)
+        # Linear probing, exactly like MelodyLibrary::find() in library.ino.
+        index = name_hash % slot_count
+        while slots[index] is not None:
+            index = (index + 1) % slot_count
+        slots[index] = (name_hash, name_positions[name], notes_start + notes_size, len(song_notes))
+        notes.append(pack_notes(song_notes))
+        notes_size += len(notes[-1])
+
+    header = MAGIC + struct.pack('<HHHHI', VERSION, slot_count, len(songs), NOTE_RECORD.size, 0)
+    index = b''.join(struct.pack('<IIII', *(slot or (0, 0, 0, 0))) for slot in slots)
+    padding = b'\0' * (notes_start - names_start - len(names))
+    return header + index + names + padding + b''.join(notes)
+
+
+def write_library(path: Path, songs: Mapping[str, Sequence[MachineNote]]) -> None:
+    """Writes a library file holding the given songs to the given path."""
+    Path(path).write_bytes(build_library(songs))
+
+
+def read_library(path: Path) -> dict[str, list[MachineNote]]:
+    """
+    Reads every song from a library file.
+    :return: A dictionary from the name of each song to its notes, sorted by offset.
+    """
+    data = Path(path).read_bytes()
+    if data[:4] != MAGIC:
+        raise ValueError(f'{path} is not a melody library')
+    version, slot_count, song_count, record_size, _ = struct.unpack_from('<HHHHI', data, 4)
+    if version != VERSION or record_size != NOTE_RECORD.size:
+        raise ValueError(f'{path} is a library of an unsupported version ({version})')
+    songs = {}
+    for slot in range(slot_count):
+        name_hash, name_position, notes_position, note_count = struct.unpack_from('<IIII', data,
+                                                                                  HEADER_SIZE + slot * SLOT_SIZE)
+        if name_hash == 0:
+            continue
+        name = data[name_position:data.index(b'\0', name_position)].decode()
+        songs[name] = [MachineNote(*fields) for fields in
+                       NOTE_RECORD.iter_unpack(data[notes_position:notes_position + note_count * NOTE_RECORD.size])]
+    return songs
+
+
+def add_to_library(path: Path, name: str, notes: Sequence[MachineNote]) -> None:
+    """Adds a song to the library file at the given path (replacing any song with the same name), creating the file if
+    it doesn't exist yet."""
+    songs = read_library(path) if Path(path).exists() else {}
+    songs[name] = list(notes)
+    write_library(path, songs)
+
+
+def main() -> None:
+    """Builds a library file from the melodies in C++ files such as songs.hpp."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.library',
+                                     description='Build a melody library file for an SD card.')
+    parser.add_argument('library_path', type=Path, help='Path of the library file to write.')
+    parser.add_argument('-a', '--append', action='store_true', default=False,
+                        help='Keep the songs already in the library file instead of replacing them.')
+    parser.add_argument('songs_paths', type=Path, nargs='+',
+                        help='C++ files with melody definitions (e.g. songs.hpp) whose songs go into the library.')
+    namespace = parser.parse_args()
+
+    songs = read_library(namespace.library_path) if namespace.append and namespace.library_path.exists() else {}
+    for songs_path in namespace.songs_paths:
+        songs.update(read_songs(songs_path))
+    if not songs:
+        sys.exit('ERROR: no melodies found')
+    write_library(namespace.library_path, songs)
+    print(f'Wrote {len(songs)} songs ({sum(len(n) for n in songs.values())} notes) to {namespace.library_path}')
+
+
+if __name__ == '__main__':
+    main()
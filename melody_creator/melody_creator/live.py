@@ -0,0 +1,100 @@
+"""
+Replays a MIDI file in real time as raw MIDI bytes over a serial port, for an Arduino running a LiveInstrument (see
+live.hpp) or for host/live_host.cpp, which runs the same code on a computer behind a pseudo-terminal:
+
+    python3 -m melody_creator.live song.mid -p /dev/ttyACM0
+"""
+
+import argparse
+import sys
+import time
+from collections.abc import Sequence
+from fractions import Fraction
+from pathlib import Path
+
+import serial
+
+from melody_creator.midi import MidiError, MidiSong, read_midi
+from melody_creator.tempo import Tempo
+
+NOTE_ON = 0x90
+"""The status byte of a note on message on channel 1. A note on with velocity 0 is a note off."""
+VELOCITY = 100
+"""The velocity of every note on (the Arduino ignores it)."""
+BAUD_RATE = 115_200
+"""The default baud rate. Real MIDI cables run at 31250."""
+
+
+def get_events(song: MidiSong) -> list[tuple[float, bytes]]:
+    """
+    Returns the note on and note off messages of a song as (time in seconds, message bytes), sorted by time. Note offs
+    are note ons with velocity 0, so that running status can leave out every status byte after the first.
+    """
+    events = []
+    for note in song.notes:
+        key = note.pitch.number
+        events.append((_seconds_at(note.end_offset, song.tempos), 0, key))
+        events.append((_seconds_at(note.offset, song.tempos), 1, key))
+    # Sorting by (time, 0 for off and 1 for on) puts note offs first when they happen at the same time as a note on, so
+    # a repeated note stops before it starts again.
+    return [(seconds, bytes([key, VELOCITY if is_on else 0])) for seconds, is_on, key in sorted(events)]
+
+
+def _seconds_at(offset: Fraction, tempos: Sequence[tuple[Fraction, Tempo]]) -> float:
+    """Returns the time of the given offset (in whole-lengths) in seconds, following every tempo change before it."""
+    milliseconds = Fraction(0)
+    for index, (start, tempo) in enumerate(tempos):
+        if start >= offset:
+            break
+        end = tempos[index + 1][0] if index + 1 < len(tempos) else offset
+        milliseconds += tempo.wholes_to_exact_milliseconds(min(end, offset) - start)
+    return float(milliseconds / 1000)
+
+
+def replay(port: serial.Serial, events: Sequence[tuple[float, bytes]], speed: float = 1.0) -> float:
+    """
+    Sends the events over the port at their times. Returns how late (in milliseconds) the latest one was sent, which
+    shows whether the computer kept up.
+    """
+    port.write(bytes([NOTE_ON]))
+    start = time.perf_counter()
+    worst = 0.0
+    for seconds, message in events:
+        due = start + seconds / speed
+        # Sleeping is only accurate to about a millisecond, so the last bit is spent checking the clock instead.
+        while (remaining := due - time.perf_counter()) > 0.002:
+            time.sleep(remaining - 0.002)
+        while time.perf_counter() < due:
+            pass
+        port.write(message)
+        worst = max(worst, time.perf_counter() - due)
+    return worst * 1000
+
+
+def main() -> None:
+    """Replays a MIDI file over a serial port."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.live',
+                                     description='Replay a MIDI file as live MIDI over a serial port.')
+    parser.add_argument('midi_path', type=Path, help='MIDI file to replay.')
+    parser.add_argument('-p', '--port', type=str, required=True,
+                        help='The serial port of the Arduino (e.g. /dev/ttyACM0), or the pseudo-terminal printed by '
+                             'host/live_host.cpp.')
+    parser.add_argument('-b', '--baud', type=int, default=BAUD_RATE, help=f'The baud rate (default {BAUD_RATE}).')
+    parser.add_argument('--speed', type=float, default=1.0, help='How much faster than written to play (default 1).')
+    namespace = parser.parse_args()
+
+    try:
+        song = read_midi(namespace.midi_path)
+    except (MidiError, IndexError) as e:
+        sys.exit(f'ERROR: {namespace.midi_path} could not be read: {e or "it ends too early"}')
+    events = get_events(song)
+    with serial.Serial(namespace.port, namespace.baud) as port:
+        # Opening the port resets most Arduinos, so give it time to start up.
+        time.sleep(2)
+        late = replay(port, events, namespace.speed)
+        port.flush()
+    print(f'{len(events)} messages sent, the latest {late:.2f} ms late', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
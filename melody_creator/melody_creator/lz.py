@@ -0,0 +1,171 @@
+"""
+Compresses melodies for LzStream on the Arduino. See lz.hpp for the format.
+
+Print every song from a C++ file compressed, with a table of how well each one compressed, with:
+
+    python3 -m melody_creator.lz songs.hpp
+"""
+
+import argparse
+import struct
+import sys
+import time
+from collections.abc import Sequence
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+from melody_creator.songs_file import read_songs
+
+WINDOW_SIZE = 256
+"""How far back (in bytes) a match can reach (LZ_WINDOW_SIZE in lz.hpp)."""
+MIN_MATCH = 3
+"""The shortest match (LZ_MIN_MATCH in lz.hpp)."""
+MAX_MATCH = MIN_MATCH + 255
+"""The longest match: its length is stored in one byte, minus MIN_MATCH."""
+NOTE_RECORD = struct.Struct('<HHH')
+"""A decompressed note: frequency, time since the previous note, and duration (all unsigned 16-bit)."""
+MELODY_NOTE_SIZE = 8
+"""The size of a Note on the Arduino, in bytes."""
+
+
+def pack_notes(notes: Sequence[MachineNote]) -> bytes:
+    """Packs notes into 6-byte records, storing the time since the previous note instead of the offset."""
+    records = []
+    previous_offset = 0
+    for note in sorted(notes, key=lambda n: n.offset_millis):
+        try:
+            records.append(NOTE_RECORD.pack(note.frequency, note.offset_millis - previous_offset, note.duration_millis))
+        except struct.error as e:
+            raise ValueError(f'a note does not fit in a note record: {e}') from e
+        previous_offset = note.offset_millis
+    return b''.join(records)
+
+
+def unpack_notes(data: bytes) -> list[MachineNote]:
+    """Unpacks records packed by pack_notes()."""
+    notes = []
+    offset = 0
+    for frequency, delta, duration in NOTE_RECORD.iter_unpack(data):
+        offset += delta
+        notes.append(MachineNote(frequency, offset, duration))
+    return notes
+
+
+def compress(data: bytes) -> bytes:
+    """Compresses the given bytes (see lz.hpp for the format)."""
+    # Remember where every 3-byte sequence has been seen, so that finding matches only has to look at places that
+    # start the same way instead of at every byte in the window.
+    seen: dict[bytes, list[int]] = {}
+    output = bytearray()
+    flags_position = 0
+    item_count = 0
+    position = 0
+    while position < len(data):
+        if item_count % 8 == 0:
+            flags_position = len(output)
+            output.append(0)
+
+        best_length = 0
+        best_distance = 0
+        for start in reversed(seen.get(data[position:position + MIN_MATCH], [])):
+            if position - start > WINDOW_SIZE:
+                break
+            length = 0
+            # Matches may run into the bytes they're producing (e.g. distance 6, length 30 repeats the last note five
+            # times), so comparing against data[start + length] is right even when that's past position.
+            while (length < MAX_MATCH and position + length < len(data)
+                   and data[start + length] == data[position + length]):
+                length += 1
+            if length > best_length:
+                best_length = length
+                best_distance = position - start
+
+        if best_length >= MIN_MATCH:
+            output += bytes((best_distance - 1, best_length - MIN_MATCH))
+            step = best_length
+        else:
+            output[flags_position] |= 1 << (item_count % 8)
+            output.append(data[position])
+            step = 1
+        for i in range(position, position + step):
+            seen.setdefault(data[i:i + MIN_MATCH], []).append(i)
+        position += step
+        item_count += 1
+    return bytes(output)
+
+
+def decompress(data: bytes, size: int) -> bytes:
+    """Decompresses size bytes from the given compressed bytes, exactly like LzStream in lz.ino."""
+    output = bytearray()
+    position = 0
+    while len(output) < size:
+        flags = data[position]
+        position += 1
+        for bit in range(8):
+            if len(output) >= size:
+                break
+            if flags >> bit & 1:
+                output.append(data[position])
+                position += 1
+            else:
+                distance = data[position] + 1
+                length = data[position + 1] + MIN_MATCH
+                position += 2
+                for _ in range(length):
+                    output.append(output[-distance])
+    return bytes(output[:size])
+
+
+def get_cpp_string(notes: Sequence[MachineNote], variable_name: str = 'MY_MELODY') -> str:
+    """Returns the source code of the C++ definitions required to define the given notes as an LzMelody."""
+    data = compress(pack_notes(notes))
+    lines = [', '.join(str(b) for b in data[i:i + 16]) for i in range(0, len(data), 16)]
+    # PROGMEM keeps the bytes in flash instead of copying them into RAM (see lz.hpp).
+    return (f'const uint8_t {variable_name}_DATA[] PROGMEM = {{\n  {',\n  '.join(lines)}\n}};\n'
+            f'const LzMelody {variable_name} = {{{variable_name}_DATA, {len(data)}, {len(notes)}}};')
+
+
+def main() -> None:
+    """Prints the melodies in a C++ file such as songs.hpp compressed, with a report of how well they compressed."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.lz', description='Compress melodies for LzStream.')
+    parser.add_argument('songs_path', type=Path, help='C++ file with melody definitions (e.g. songs.hpp).')
+    parser.add_argument('-n', '--name', dest='song_name', type=str,
+                        help='Name of the melody to print. By default, every melody is printed.')
+    parser.add_argument('-s', '--suffix', type=str, default='_LZ',
+                        help='Added to the name of each melody to name its compressed version.')
+    namespace = parser.parse_args()
+
+    songs = read_songs(namespace.songs_path)
+    if namespace.song_name is not None:
+        if namespace.song_name not in songs:
+            sys.exit(f'ERROR: {namespace.song_name} not found in {namespace.songs_path}')
+        songs = {namespace.song_name: songs[namespace.song_name]}
+    if not songs:
+        sys.exit('ERROR: no melodies found')
+
+    report = []
+    for name, notes in songs.items():
+        packed = pack_notes(notes)
+        compressed = compress(packed)
+        # Check that decompressing gives back exactly the same notes, and time it. Python is much slower than the
+        # Arduino's C++, so this is only useful for comparing songs; benchmarkLz() in lz.ino measures the real thing.
+        start = time.perf_counter()
+        decompressed = decompress(compressed, len(packed))
+        elapsed = time.perf_counter() - start
+        if unpack_notes(decompressed) != sorted(notes, key=lambda n: n.offset_millis):
+            sys.exit(f'ERROR: {name} does not decompress to the same notes; this is a bug')
+        print(get_cpp_string(notes, name + namespace.suffix))
+        print()
+        report.append((name, len(notes), MELODY_NOTE_SIZE * len(notes), len(packed), len(compressed),
+                       len(packed) / elapsed / 1e6))
+
+    # The report goes to stderr so that the C++ can be redirected into a file on its own.
+    print(f'{"Song":<24} {"Notes":>6} {"Melody":>8} {"Packed":>8} {"LZ":>8} {"Ratio":>6} {"Decode (Python)":>16}',
+          file=sys.stderr)
+    for name, note_count, melody_size, packed_size, compressed_size, speed in report:
+        print(f'{name:<24} {note_count:>6} {melody_size:>7}B {packed_size:>7}B {compressed_size:>7}B '
+              f'{melody_size / compressed_size:>5.2f}x {speed:>11.2f} MB/s', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
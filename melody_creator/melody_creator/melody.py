@@ -1,25 +1,34 @@
+from __future__ import annotations
+
+import bisect
 import re
 from collections.abc import Sequence
 from fractions import Fraction
-from typing import Self
+from typing import Self, TYPE_CHECKING
 
-import music21 as m21
 from pydub import AudioSegment
 from pydub.generators import Square
 from pydub.utils import ratio_to_db
 
-from melody_creator import articulations
+from melody_creator import articulations, dynamics, expressions
 from melody_creator.note import Note, MachineNote
 from melody_creator.tempo import Tempo
 
-MUSIC21_ARTICULATION_MAPPING = {
-    m21.articulations.Staccatissimo: articulations.STACCATISSIMO,
-    m21.articulations.Staccato: articulations.STACCATO,
-    m21.articulations.Spiccato: articulations.STACCATISSIMO,
-    m21.articulations.DetachedLegato: articulations.NON_LEGATO,
-    m21.articulations.Tenuto: articulations.TENUTO
-}
-"""A map from music21 articulation types to articulations defined by Melody Creator."""
+# music21 is only imported where it's needed (see note.py), so that melodies read from MIDI files load quickly.
+if TYPE_CHECKING:
+    import music21 as m21
+
+
+def music21_articulation_mapping() -> dict[type, Fraction]:
+    """Returns a map from music21 articulation types to articulations defined by Melody Creator."""
+    import music21 as m21
+    return {
+        m21.articulations.Staccatissimo: articulations.STACCATISSIMO,
+        m21.articulations.Staccato: articulations.STACCATO,
+        m21.articulations.Spiccato: articulations.STACCATISSIMO,
+        m21.articulations.DetachedLegato: articulations.NON_LEGATO,
+        m21.articulations.Tenuto: articulations.TENUTO
+    }
 
 
 class Melody:
@@ -39,6 +48,11 @@ class Melody:
         """The number of notes in this melody."""
         return len(self.__notes)
 
+    @property
+    def notes(self) -> list[Note]:
+        """The notes of this melody, sorted by offset."""
+        return list(self.__notes)
+
     @property
     def duration(self) -> Fraction:
         """The duration of this melody in the number of whole notes."""
@@ -50,11 +64,20 @@ class Melody:
         return mnotes[-1].offset_millis + mnotes[-1].duration_millis
 
     @classmethod
-    def from_stream(cls, stream: m21.stream.Stream) -> Self:
+    def from_stream(cls, stream: m21.stream.Stream, chords: bool = False, ornaments: bool = False) -> Self:
         """
         Creates a new melody from a music21 stream. The converter will consider all notes in the stream, even if
-        they're in different parts/chords, and add them to the melody. Marked articulations will also be considered.
+        they're in different parts, and add them to the melody. Marked articulations, slurs, ornaments, and dynamics
+        will also be considered.
+        :param chords: Whether to add every note of each chord too (optional). Chords are skipped by default, since a
+                       buzzer can only play one of their notes at a time, but they're needed to split the melody into
+                       voices (see voices.py).
+        :param ornaments: Whether to keep trills, mordents, turns, and grace notes as the ornaments of their notes (see
+                          expressions.py) where they can be, for an EnvelopePlayer (optional). By default, they're
+                          written out as notes.
         """
+        import music21 as m21
+
         # Because music21 streams are highly nested, we must flatten them with stream.flatten() and simplify tied notes.
         # Then, we get only the elements of class "m21.note.Note", music21's class for representing notes (distinct from
         # the class defined in this project, disambiguated by the m21.note). We then convert them into the Note type
@@ -67,6 +90,18 @@ class Melody:
                                                        offset=Fraction(note.offset) / 4,
                                                        duration=Fraction(note.quarterLength) / 4)
                                             for note in flattened_stream.getElementsByClass(m21.note.Note)}
+        # The notes of a chord don't have offsets, durations, or articulations of their own, so they're taken from the
+        # chord. marks maps each chord note to its chord, so that the chord's articulations are found below.
+        marks: dict[m21.note.Note, m21.chord.Chord] = {}
+        if chords:
+            for chord in flattened_stream.getElementsByClass(m21.chord.Chord):
+                for chord_note in chord.notes:
+                    notes[chord_note] = Note(pitch=chord_note.pitch, offset=Fraction(chord.offset) / 4,
+                                             duration=Fraction(chord.quarterLength) / 4)
+                    marks[chord_note] = chord
+
+        # Grace notes take no time in music21, so they're fitted in at the start of the note after them.
+        _place_grace_notes(list(flattened_stream.getElementsByClass(m21.note.Note)), notes, ornaments)
 
         # In the following section, we use slurs to infer legato articulations on specific notes. Every note in the
         # slur except for the last one (the [:-1] cuts off before the last note) will be marked as legato.
@@ -77,46 +112,126 @@ class Melody:
         slur: m21.spanner.Slur
         for slur in flattened_stream.getElementsByClass(m21.spanner.Slur):
             legato_notes: list[Note]
-            for legato_note in slur.getSpannedElementsByClass(m21.note.Note)[:-1]:
+            # A grace note that became the ornament of its note isn't in notes anymore.
+            slurred_notes = [note for note in slur.getSpannedElementsByClass(m21.note.Note) if note in notes]
+            for legato_note in slurred_notes[:-1]:
                 notes[legato_note].articulation = articulations.LEGATO
+            # Every note in the slur after the first one glides from the note before it (see modulation.hpp).
+            for gliding_note in slurred_notes[1:]:
+                notes[gliding_note].expression |= expressions.GLIDE
 
         # Finally, we check other articulations. Combined staccato and tenuto is marked as mezzo-staccato because
         # music21 cannot represent mezzo-staccato as a single articulation. If you don't know what I'm talking about,
         # see this image: https://press.rebus.community/app/uploads/sites/81/2017/09/Mezzo-Staccato-II_0001.png
+        articulation_mapping = music21_articulation_mapping()
+        # Scoops and plops don't change the length of a note, but bend into it from below and from above.
+        bends = {m21.articulations.Scoop: expressions.SCOOP, m21.articulations.Plop: expressions.PLOP}
         for original_note, note in notes.items():
-            if original_note.articulations:
+            # Chord notes use their chord's articulations.
+            marked = marks.get(original_note, original_note)
+            if marked.articulations:
                 # Because the dictionary keys are types (not instances), we must first figure out the type of each
                 # marked articulation, resulting in this longer syntax.
-                if (any(a for a in original_note.articulations if type(a) is m21.articulations.Staccato)
-                        and any(a for a in original_note.articulations if type(a) is m21.articulations.Tenuto)):
+                if (any(a for a in marked.articulations if type(a) is m21.articulations.Staccato)
+                        and any(a for a in marked.articulations if type(a) is m21.articulations.Tenuto)):
                     notes[original_note].articulation = articulations.MEZZO_STACCATO
                 else:
-                    articulation = next((a for a in original_note.articulations
-                                         if type(a) in MUSIC21_ARTICULATION_MAPPING), None)
+                    articulation = next((a for a in marked.articulations
+                                         if type(a) in articulation_mapping), None)
                     if articulation is not None:
-                        notes[original_note].articulation = MUSIC21_ARTICULATION_MAPPING[type(articulation)]
+                        notes[original_note].articulation = articulation_mapping[type(articulation)]
+                for bend in marked.articulations:
+                    notes[original_note].expression |= bends.get(type(bend), 0)
+
+        # Each dynamics marking sets the velocity of the notes from where it's written until the next one, in any part.
+        # The markings are sorted by offset once, and the last one at or before each note is found with a binary
+        # search, so even long scores with many markings are quick.
+        dynamic_marks = sorted((Fraction(dynamic.offset) / 4, dynamics.velocity_of(dynamic.value, dynamic.volumeScalar))
+                               for dynamic in flattened_stream.getElementsByClass(m21.dynamics.Dynamic))
+        dynamic_offsets = [offset for offset, _ in dynamic_marks]
+        for note in notes.values():
+            index = bisect.bisect_right(dynamic_offsets, note.offset) - 1
+            if index >= 0:
+                note.velocity = dynamic_marks[index][1]
+
+        # A trill written out as notes can take dozens of them, so if ornaments are kept, trills, mordents, and turns in
+        # ORNAMENTS (see expressions.py) become the ornament of their note, which an EnvelopePlayer plays from a single
+        # note. Others are written out as the notes music21 works out for them. A note only has room for one ornament,
+        # so if a grace note already became it, the trill is written out too, starting with the grace note.
+        melody_notes = []
+        for original_note, note in notes.items():
+            marked_ornaments = [o for o in original_note.expressions
+                                if isinstance(o, (m21.expressions.Trill, m21.expressions.GeneralMordent,
+                                                  m21.expressions.Turn))]
+            if marked_ornaments:
+                expression = (_ornament_expression(marked_ornaments[0], original_note)
+                              if ornaments and not note.expression & expressions.ORNAMENT else None)
+                if expression is not None:
+                    note.expression |= expression
+                else:
+                    melody_notes.extend(_realize_ornament(marked_ornaments[0], original_note, note))
+                    continue
+            melody_notes.append(note)
 
         tempo = _get_tempo_from_stream(stream)
         if tempo is None:
             tempo = Tempo.quarter_equals(120)
 
-        return cls(list(notes.values()), tempo)
+        return cls(melody_notes, tempo)
 
     def get_machine_notes(self) -> list[MachineNote]:
         """Returns the machine notes for this melody."""
-        return [self.tempo.note_to_machine_note(note) for note in self.__notes]
+        return self.tempo.notes_to_machine_notes(self.__notes)
 
     def get_cpp_string(self, variable_name: str = 'MY_MELODY') -> str:
         """Returns the source code of the C++ definition required to define this melody."""
-        if re.fullmatch(r'[A-Za-z_]+', variable_name) is None:
+        if re.fullmatch(r'[A-Za-z_][A-Za-z0-9_]*', variable_name) is None:
             raise ValueError('variable_name must be a valid C++ variable name')
-        machine_note_strings = [f'  {{{mnote.frequency}, {mnote.offset_millis}, {mnote.duration_millis}}}'
-                                for mnote in self.get_machine_notes()]
+        machine_note_strings = [f'  {mnote.get_cpp_string()}' for mnote in self.get_machine_notes()]
+        notes = ',\n'.join(machine_note_strings)
 
-        return f'const Melody<{self.number_of_notes}> {variable_name} = {{{{\n{',\n'.join(machine_note_strings)}\n}}}};'
+        return f'constexpr Melody<{self.number_of_notes}> {variable_name} = {{{{\n{notes}\n}}}};'
 
-    def get_audio_segment(self) -> AudioSegment:
-        """Returns a PyDub AudioSegment that plays this melody."""
+    def get_velocities_cpp_string(self, variable_name: str = 'MY_MELODY') -> str:
+        """
+        Returns the source code of the C++ definition of an array holding the velocity of each note of this melody, in
+        the same order as get_cpp_string(), for an EnvelopePlayer (see envelope.hpp). It's named variable_name followed
+        by _VELOCITIES.
+        """
+        if re.fullmatch(r'[A-Za-z_][A-Za-z0-9_]*', variable_name) is None:
+            raise ValueError('variable_name must be a valid C++ variable name')
+        velocities = [str(note.velocity) for note in self.__notes]
+        lines = [', '.join(velocities[i:i + 16]) for i in range(0, len(velocities), 16)]
+        return f'const uint8_t {variable_name}_VELOCITIES[] = {{\n  {",\n  ".join(lines)}\n}};'
+
+    def get_expressions_cpp_string(self, variable_name: str = 'MY_MELODY',
+                                   vibrato_millis: int = expressions.VIBRATO_MIN_MILLIS) -> str:
+        """
+        Returns the source code of the C++ definition of an array holding the expression flags of each note of this
+        melody (see expressions.py), in the same order as get_cpp_string(), for an EnvelopePlayer (see
+        modulation.hpp). It's named variable_name followed by _EXPRESSIONS.
+        :param vibrato_millis: Notes that sound at least this many milliseconds get vibrato, or none do if it's 0
+                               (optional).
+        """
+        if re.fullmatch(r'[A-Za-z_][A-Za-z0-9_]*', variable_name) is None:
+            raise ValueError('variable_name must be a valid C++ variable name')
+        # Whether a note is long enough for vibrato depends on the tempo, so it's worked out here rather than when the
+        # score is read.
+        flags = [note.expression | (expressions.VIBRATO if 0 < vibrato_millis <= mnote.duration_millis else 0)
+                 for note, mnote in zip(self.__notes, self.get_machine_notes())]
+        # Hexadecimal shows which bits are set: 0x03 is GLIDE and VIBRATO.
+        values = [f'0x{flag:02X}' for flag in flags]
+        lines = [', '.join(values[i:i + 12]) for i in range(0, len(values), 12)]
+        return f'const uint8_t {variable_name}_EXPRESSIONS[] = {{\n  {",\n  ".join(lines)}\n}};'
+
+    def get_audio_segment(self, arpeggio_rate: int = 0) -> AudioSegment:
+        """
+        Returns a PyDub AudioSegment that plays this melody.
+        :param arpeggio_rate: If above 0, chords are played the way a MelodyPlayer with setArpeggioRate() plays them
+                              (see player.hpp): one note at a time, switching this many times per second (optional).
+        """
+        if arpeggio_rate > 0:
+            return _render_tones(arpeggiate(self.get_machine_notes(), arpeggio_rate)).apply_gain(ratio_to_db(0.02))
         # First get silence that is the complete length of the resulting audio segment
         result = AudioSegment.silent(duration=self.get_actual_duration())
         for mnote in self.get_machine_notes():
@@ -129,8 +244,196 @@ class Melody:
         return result.apply_gain(ratio_to_db(0.02))
 
 
+MAX_CHORD_NOTES = 4
+"""The most notes a MelodyPlayer arpeggiates at once (see MAX_CHORD_NOTES in player.hpp)."""
+PREVIEW_SAMPLE_RATE = 44_100
+"""The sample rate of arpeggiated previews, in samples per second."""
+
+
+def _offset_micros(mnote: MachineNote) -> int:
+    """Returns the offset of the note in whole microseconds, rounded the same way as Note::offsetMicros()."""
+    return mnote.offset_millis * 1000 + ((mnote.offset_fraction * 1000 + 128) >> 8)
+
+
+def arpeggiate(mnotes: Sequence[MachineNote], rate: int) -> list[tuple[int, int, int]]:
+    """
+    Returns what the buzzer plays when a MelodyPlayer arpeggiates the notes (see setArpeggioRate() in player.hpp), as
+    (start, end, frequency) with times in microseconds. This follows MelodyPlayer::updateChord() step by step, so the
+    preview switches notes at exactly the same times as the Arduino.
+    """
+    period = 1_000_000 // rate
+    starts = [_offset_micros(mnote) for mnote in mnotes]
+    tones: list[tuple[int, int, int]] = []
+    # Each note in the chord is (index in mnotes, end in microseconds), oldest first.
+    chord: list[tuple[int, int]] = []
+    chord_index = 0
+    next_note = 0
+    next_switch = 0
+    sounding_since = 0
+
+    def remove_from_chord(index: int) -> None:
+        nonlocal chord_index
+        del chord[index]
+        if index < chord_index:
+            chord_index -= 1
+        if chord_index >= len(chord):
+            chord_index = 0
+
+    now = starts[0] if starts else 0
+    while True:
+        sounding = chord[chord_index][0] if chord else None
+        # Notes that have ended leave before new ones join, like in updateChord().
+        for index in reversed([i for i, (_, end) in enumerate(chord) if now >= end]):
+            remove_from_chord(index)
+        added = False
+        while next_note < len(mnotes) and now >= starts[next_note]:
+            if len(chord) == MAX_CHORD_NOTES:
+                remove_from_chord(0)
+            chord.append((next_note, starts[next_note] + mnotes[next_note].duration_millis * 1000))
+            chord_index = len(chord) - 1
+            next_note += 1
+            added = True
+        if not added and len(chord) > 1 and now >= next_switch:
+            chord_index = (chord_index + 1) % len(chord)
+        playing = chord[chord_index][0] if chord else None
+        if playing != sounding:
+            if sounding is not None and now > sounding_since:
+                tones.append((sounding_since, now, mnotes[sounding].frequency))
+            sounding_since = now
+            next_switch = now + period
+        # The next thing that can change the chord: a note starting, a note ending, or a switch.
+        times = [end for _, end in chord]
+        if next_note < len(mnotes):
+            times.append(starts[next_note])
+        if len(chord) > 1:
+            times.append(next_switch)
+        if not times:
+            return tones
+        now = min(times)
+
+
+def _render_tones(tones: Sequence[tuple[int, int, int]]) -> AudioSegment:
+    """
+    Returns a PyDub AudioSegment that plays square waves at the given (start, end, frequency) times in microseconds,
+    which must not overlap. Every switch of an arpeggio is a separate tone, so instead of overlaying each one onto the
+    whole song (which copies the whole song every time), the samples are joined in order.
+    """
+    pieces = []
+    position = 0
+    for start, end, frequency in tones:
+        first = start * PREVIEW_SAMPLE_RATE // 1_000_000
+        last = end * PREVIEW_SAMPLE_RATE // 1_000_000
+        # Samples are 2 bytes, and silence is all zeros. Times are worked out from the start of the song rather than
+        # by adding up lengths, so rounding to whole samples never builds up.
+        pieces.append(bytes(2 * (first - position)))
+        wave = Square(frequency, sample_rate=PREVIEW_SAMPLE_RATE).to_audio_segment(
+            duration=(last - first) * 1000 / PREVIEW_SAMPLE_RATE + 1)
+        pieces.append(wave.raw_data[:2 * (last - first)])
+        position = last
+    return AudioSegment(data=b''.join(pieces), sample_width=2, frame_rate=PREVIEW_SAMPLE_RATE, channels=1)
+
+
+GRACE_NOTE_LENGTH = Fraction(1, 32)
+"""How long a grace note that's played as a note of its own lasts, in whole-lengths (a 32nd note)."""
+
+
+def _place_grace_notes(m21_notes: Sequence[m21.note.Note], notes: dict[m21.note.Note, Note], ornaments: bool) -> None:
+    """
+    Fits the grace notes among the given music21 notes (in the order of the score) into the notes they come before.
+    If ornaments is True, a single grace note a step or two away from its note becomes the note's ornament (see
+    expressions.py). Others are played as short notes that take their time from the start of the note.
+    """
+    graces: list[m21.note.Note] = []
+    for m21_note in m21_notes:
+        if m21_note.duration.isGrace:
+            graces.append(m21_note)
+            continue
+        # Grace notes have the same offset as the note they belong to. Ones that don't (before a chord or a rest) are
+        # played at their offset without taking any time from another note.
+        leftovers = [grace for grace in graces if grace.offset != m21_note.offset]
+        graces = [grace for grace in graces if grace.offset == m21_note.offset]
+        for grace in leftovers:
+            notes[grace] = Note(grace.pitch, notes[grace].offset, GRACE_NOTE_LENGTH)
+        if not graces or m21_note not in notes:
+            graces = []
+            continue
+        note = notes[m21_note]
+        if ornaments and len(graces) == 1:
+            expression = expressions.ornament_expression((round(graces[0].pitch.ps - m21_note.pitch.ps),))
+            if expression is not None:
+                note.expression |= expression
+                del notes[graces[0]]
+                graces = []
+                continue
+        # The grace notes take at most half of the note between them.
+        length = min(GRACE_NOTE_LENGTH, note.duration / 2 / len(graces))
+        for index, grace in enumerate(graces):
+            notes[grace] = Note(grace.pitch, note.offset + index * length, length, articulations.LEGATO)
+        taken = len(graces) * length
+        notes[m21_note] = Note(note.pitch, note.offset + taken, note.duration - taken, note.articulation,
+                               note.velocity, note.expression)
+        graces = []
+    for grace in graces:
+        notes[grace] = Note(grace.pitch, notes[grace].offset, GRACE_NOTE_LENGTH)
+
+
+def _ornament_expression(ornament: m21.expressions.Ornament, m21_note: m21.note.Note) -> int | None:
+    """
+    Returns the expression of a trill, mordent, or turn on the given note, or None if it isn't in ORNAMENTS (see
+    expressions.py).
+    """
+    import music21 as m21
+    # Which neighbors an ornament uses depends on the key, which music21 works out when it writes the ornament out as
+    # notes. The highest and lowest of those notes are the neighbors.
+    steps = [round(realized.pitch.ps - m21_note.pitch.ps) for realized in _realized_notes(ornament, m21_note)]
+    if not steps:
+        return None
+    above, below = max(steps), min(steps)
+    if isinstance(ornament, m21.expressions.Trill):
+        return expressions.ornament_expression((0, above), True)
+    if isinstance(ornament, m21.expressions.InvertedMordent):
+        return expressions.ornament_expression((0, above))
+    if isinstance(ornament, m21.expressions.GeneralMordent):
+        return expressions.ornament_expression((0, below))
+    if isinstance(ornament, m21.expressions.InvertedTurn):
+        return expressions.ornament_expression((below, 0, above))
+    return expressions.ornament_expression((above, 0, below))
+
+
+def _realized_notes(ornament: m21.expressions.Ornament, m21_note: m21.note.Note) -> list[m21.note.Note]:
+    """Returns the notes music21 writes the ornament out as, in order, or none if it can't."""
+    import music21 as m21
+    try:
+        before, remainder, after = ornament.realize(m21_note)
+    except m21.expressions.ExpressionException:
+        # music21 can't write out an ornament on a note too short for it.
+        return []
+    return list(before) + ([remainder] if remainder is not None else []) + list(after)
+
+
+def _realize_ornament(ornament: m21.expressions.Ornament, m21_note: m21.note.Note, note: Note) -> list[Note]:
+    """
+    Returns the notes the ornament is played as on the given note, one after the other, with the velocity and
+    expression of the note. The last one keeps the note's articulation. If music21 can't write it out, it's just the
+    note.
+    """
+    realized = _realized_notes(ornament, m21_note)
+    if not realized:
+        return [note]
+    result = []
+    offset = note.offset
+    for index, realized_note in enumerate(realized):
+        duration = Fraction(realized_note.quarterLength) / 4
+        articulation = note.articulation if index == len(realized) - 1 else articulations.LEGATO
+        result.append(Note(realized_note.pitch, offset, duration, articulation, note.velocity,
+                           note.expression if index == 0 else 0))
+        offset += duration
+    return result
+
+
 def _get_tempo_from_stream(stream: m21.stream.Stream) -> Tempo | None:
     """Gets the first tempo indication in the stream, if there is one."""
+    import music21 as m21
     tempo_indication: m21.tempo.TempoIndication
     tempo_indication = next(stream.flatten().getElementsByClass(m21.tempo.TempoIndication), None)
     if tempo_indication is not None:
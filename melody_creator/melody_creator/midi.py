@@ -0,0 +1,253 @@
+"""
+Reads Standard MIDI Files (.mid) directly, without music21. A MIDI file already says exactly when every note starts and
+stops, so reading one is a single pass over its bytes, which takes milliseconds instead of the seconds music21 needs.
+
+Print a MIDI file as a melody, with how long reading it took, with:
+
+    python3 -m melody_creator.midi song.mid -n MY_SONG
+"""
+
+import argparse
+import sys
+import time
+from dataclasses import dataclass
+from fractions import Fraction
+from pathlib import Path
+
+from melody_creator import articulations
+from melody_creator.melody import Melody
+from melody_creator.note import Note
+from melody_creator.tempo import Tempo
+from melody_creator.ticks import TempoChange, TICKS_PER_WHOLE, MIN_TEMPO
+
+HEADER_CHUNK = b'MThd'
+"""The type of the chunk that starts every MIDI file."""
+TRACK_CHUNK = b'MTrk'
+"""The type of a chunk that holds a track's events."""
+NOTE_OFF = 0x80
+NOTE_ON = 0x90
+"""Channel messages (the high nibble of the status byte) that start and stop notes."""
+META_EVENT = 0xFF
+SET_TEMPO = 0x51
+"""A meta event (status 0xFF) of this type sets the tempo, in microseconds per quarter note."""
+DRUM_CHANNEL = 9
+"""The channel General MIDI uses for drums (channel 10, counting from 1). Its keys are drums, not pitches."""
+DEFAULT_MICROSECONDS_PER_QUARTER = 500_000
+"""The tempo of a MIDI file until its first tempo event (quarter = 120)."""
+NAMES = ['C', 'C#', 'D', 'D#', 'E', 'F', 'F#', 'G', 'G#', 'A', 'A#', 'B']
+"""The names of the pitch classes, starting from C."""
+
+# The number of data bytes each channel message has, by the high nibble of its status byte. Program changes (0xC0) and
+# channel pressure (0xD0) have one; the rest have two.
+_DATA_LENGTHS = {0x80: 2, 0x90: 2, 0xA0: 2, 0xB0: 2, 0xC0: 1, 0xD0: 1, 0xE0: 2}
+
+
+class MidiError(ValueError):
+    """Raised when a file isn't a MIDI file that can be read."""
+
+
+@dataclass(frozen=True)
+class MidiPitch:
+    """
+    A pitch given by its MIDI key number (60 is middle C). It has the freq440 attribute of music21's Pitch, which is all
+    the rest of melody_creator uses, so Notes can hold either.
+    """
+
+    number: int
+    """The MIDI key number."""
+
+    @property
+    def freq440(self) -> float:
+        """The frequency of the pitch in Hertz, with A4 (key 69) at 440 Hz."""
+        return 440 * 2 ** ((self.number - 69) / 12)
+
+    def __str__(self) -> str:
+        return f'{NAMES[self.number % 12]}{self.number // 12 - 1}'
+
+
+@dataclass
+class MidiSong:
+    """The notes and tempo changes read from a MIDI file."""
+
+    notes: list[Note]
+    """The notes, sorted by offset. Offsets and durations are in whole-lengths, like every Note."""
+    tempos: list[tuple[Fraction, Tempo]]
+    """Every tempo change, as (offset in whole-lengths, tempo), sorted by offset. Never empty."""
+    event_count: int
+    """The number of events in the file, including ones that were skipped."""
+
+    @property
+    def melody(self) -> Melody:
+        """
+        The song as a Melody. A Melody only has one tempo, so it plays at the first tempo the whole way through; use
+        tempo_changes (see ticks.py) to keep the others.
+        """
+        return Melody(self.notes, self.tempos[0][1])
+
+    @property
+    def tempo_changes(self) -> list[TempoChange]:
+        """The tempo changes, for a TickMelody (see ticks.py)."""
+        return [TempoChange(round(offset * TICKS_PER_WHOLE), max(MIN_TEMPO, tempo.beats_per_minute))
+                for offset, tempo in self.tempos]
+
+
+def read_midi(path: Path, include_drums: bool = False) -> MidiSong:
+    """
+    Reads a Standard MIDI File (format 0 or 1).
+    :param path: The path to the file.
+    :param include_drums: Whether to keep notes on the drum channel (channel 10), which are usually noise on a buzzer.
+    """
+    return parse_midi(Path(path).read_bytes(), include_drums)
+
+
+def parse_midi(data: bytes, include_drums: bool = False) -> MidiSong:
+    """Reads a Standard MIDI File from its bytes. See read_midi()."""
+    if data[:4] != HEADER_CHUNK or len(data) < 14:
+        raise MidiError('not a MIDI file (it does not start with MThd)')
+    header_length = int.from_bytes(data[4:8])
+    file_format = int.from_bytes(data[8:10])
+    track_count = int.from_bytes(data[10:12])
+    division = int.from_bytes(data[12:14])
+    if file_format == 2:
+        raise MidiError('format 2 MIDI files (several independent songs) are not supported')
+    if division & 0x8000:
+        raise MidiError('MIDI files timed in SMPTE frames instead of quarter notes are not supported')
+    if division == 0:
+        raise MidiError('the MIDI file has 0 ticks per quarter note')
+
+    # Everything is collected in ticks first and only turned into Notes at the end: Fractions are slow to make, and
+    # plain integers keep the loop below fast enough for files with hundreds of thousands of events.
+    spans: list[tuple[int, int, int, int]] = []
+    tempo_ticks: dict[int, int] = {0: DEFAULT_MICROSECONDS_PER_QUARTER}
+    event_count = 0
+    position = 8 + header_length
+    for _ in range(track_count):
+        if data[position:position + 4] != TRACK_CHUNK:
+            raise MidiError(f'expected a track at byte {position}')
+        end = position + 8 + int.from_bytes(data[position + 4:position + 8])
+        if end > len(data):
+            raise MidiError('the MIDI file ends in the middle of a track')
+        event_count += _read_track(data, position + 8, end, spans, tempo_ticks, include_drums)
+        position = end
+
+    ticks_per_whole = 4 * division
+    # Most notes have one of a few lengths, so their Fractions are made once and shared.
+    durations: dict[int, Fraction] = {}
+    pitches: dict[int, MidiPitch] = {}
+    notes = []
+    for start, stop, key, velocity in sorted(spans):
+        if stop - start not in durations:
+            durations[stop - start] = Fraction(stop - start, ticks_per_whole)
+        if key not in pitches:
+            pitches[key] = MidiPitch(key)
+        notes.append(Note(pitches[key], Fraction(start, ticks_per_whole), durations[stop - start],
+                          articulations.LEGATO, velocity))
+    # MIDI tempos are microseconds per quarter note; round(60,000,000 / that) is quarter notes per minute.
+    tempos = [(Fraction(tick, ticks_per_whole), Tempo.quarter_equals(round(60_000_000 / microseconds)))
+              for tick, microseconds in sorted(tempo_ticks.items())]
+    return MidiSong(notes, tempos, event_count)
+
+
+def _read_track(data: bytes, position: int, end: int, spans: list[tuple[int, int, int, int]],
+                tempo_ticks: dict[int, int], include_drums: bool) -> int:
+    """
+    Reads the events of one track, adding every note to spans as (start tick, stop tick, key, velocity) and every tempo
+    to tempo_ticks. Returns the number of events.
+    """
+    # Notes that have started but not stopped, by channel and key. A key can be pressed again before it's released,
+    # so each has a list of (start tick, velocity), and the earliest one stops first.
+    sounding: dict[int, list[tuple[int, int]]] = {}
+    tick = 0
+    status = 0
+    event_count = 0
+    while position < end:
+        # Every event starts with the time since the previous one, as a variable-length number: 7 bits per byte, with
+        # the top bit set on every byte but the last.
+        delta = 0
+        while True:
+            byte = data[position]
+            position += 1
+            delta = delta << 7 | byte & 0x7F
+            if byte < 0x80:
+                break
+        tick += delta
+        event_count += 1
+
+        # If the next byte isn't a status byte (its top bit is clear), the previous status is used again ("running
+        # status"), which saves a byte per event in long runs of notes.
+        if data[position] & 0x80:
+            status = data[position]
+            position += 1
+        if status == META_EVENT or status == 0xF0 or status == 0xF7:
+            if status == META_EVENT:
+                meta_type = data[position]
+                position += 1
+            # Meta and system exclusive events give their length as a variable-length number too.
+            length = 0
+            while True:
+                byte = data[position]
+                position += 1
+                length = length << 7 | byte & 0x7F
+                if byte < 0x80:
+                    break
+            if status == META_EVENT and meta_type == SET_TEMPO and length == 3:
+                tempo_ticks[tick] = int.from_bytes(data[position:position + 3])
+            position += length
+            # Running status doesn't carry over meta and system exclusive events.
+            status = 0
+            continue
+
+        kind = status & 0xF0
+        if kind not in _DATA_LENGTHS:
+            raise MidiError(f'unexpected byte 0x{status:02X} at byte {position}')
+        if kind == NOTE_ON or kind == NOTE_OFF:
+            channel = status & 0x0F
+            key = data[position]
+            velocity = data[position + 1]
+            position += 2
+            if channel == DRUM_CHANNEL and not include_drums:
+                continue
+            index = channel << 7 | key
+            # A note on with velocity 0 is a note off. Files use it so that running status can cover both.
+            if kind == NOTE_ON and velocity > 0:
+                sounding.setdefault(index, []).append((tick, velocity))
+            elif sounding.get(index):
+                start, start_velocity = sounding[index].pop(0)
+                spans.append((start, tick, key, start_velocity))
+        else:
+            position += _DATA_LENGTHS[kind]
+
+    # Notes that were never stopped last until the end of the track.
+    for index, starts in sounding.items():
+        spans.extend((start, tick, index & 0x7F, velocity) for start, velocity in starts)
+    return event_count
+
+
+def main() -> None:
+    """Prints the melody in a MIDI file as C++, with a report of how long reading the file took."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.midi',
+                                     description='Read a Standard MIDI File without music21.')
+    parser.add_argument('midi_path', type=Path, help='MIDI file to read.')
+    parser.add_argument('-n', '--name', dest='var_name', type=str, default='MY_MELODY',
+                        help='The name of the printed variable. Must be a valid C++ variable name.')
+    parser.add_argument('-d', '--include-drums', action='store_true', default=False,
+                        help='Keep notes on the drum channel (channel 10).')
+    namespace = parser.parse_args()
+
+    start = time.perf_counter()
+    try:
+        song = read_midi(namespace.midi_path, namespace.include_drums)
+    except (MidiError, IndexError) as e:
+        # An IndexError means the file ended in the middle of an event.
+        sys.exit(f'ERROR: {namespace.midi_path} could not be read: {e or "it ends too early"}')
+    elapsed = time.perf_counter() - start
+    if not song.notes:
+        sys.exit(f'ERROR: {namespace.midi_path} has no notes')
+    print(song.melody.get_cpp_string(namespace.var_name))
+    # The report goes to stderr so that the C++ can be redirected into a file on its own.
+    print(f'{song.event_count} events, {len(song.notes)} notes, {len(song.tempos)} tempos, read in '
+          f'{elapsed * 1000:.1f} ms', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,28 +1,40 @@
+from __future__ import annotations
+
 from dataclasses import dataclass
 from fractions import Fraction
 from numbers import Rational
+from typing import TYPE_CHECKING
 
-import music21 as m21
+from melody_creator import articulations, dynamics
 
-from melody_creator import articulations
+# music21 takes seconds to import, and notes read from MIDI files (see midi.py) don't need it, so it's only imported for
+# type checkers (TYPE_CHECKING is False when the program actually runs). "from __future__ import annotations" stops
+# Python from evaluating the m21.pitch.Pitch annotations below, which would need the import.
+if TYPE_CHECKING:
+    import music21 as m21
 
 
 class Note:
     """A Note stores a pitch, its offset from the starting point in the relevant music, and its duration."""
 
     def __init__(self, pitch: m21.pitch.Pitch, offset: Rational, duration: Rational,
-                 articulation: Rational = articulations.NON_LEGATO):
+                 articulation: Rational = articulations.NON_LEGATO, velocity: int = dynamics.DEFAULT_VELOCITY,
+                 expression: int = 0):
         """
         Initializes a new Note.
         :param pitch: The pitch of the note, in Hertz.
         :param offset: The offset of the note (position from the start), in whole-lengths.
         :param duration: The duration of the note, in whole-lengths.
         :param articulation: The articulation of the note, as a proportion of the note's written duration.
+        :param velocity: How loud the note is, from 1 to 127 (see dynamics.py).
+        :param expression: The expression flags of the note, e.g. expressions.GLIDE (see expressions.py).
         """
         self.__pitch = pitch
-        self.__offset = Fraction(offset)
-        self.__duration = Fraction(duration)
-        self.__articulation = Fraction(articulation)
+        self.__offset = _to_fraction(offset)
+        self.__duration = _to_fraction(duration)
+        self.__articulation = _to_fraction(articulation)
+        self.__velocity = velocity
+        self.__expression = expression
 
     @property
     def pitch(self) -> m21.pitch.Pitch:
@@ -57,23 +69,57 @@ class Note:
         """
         self.__articulation = Fraction(articulation)
 
+    @property
+    def velocity(self) -> int:
+        """How loud the note is, from 1 to 127 (see dynamics.py)."""
+        return self.__velocity
+
+    @velocity.setter
+    def velocity(self, velocity: int) -> None:
+        """
+        Sets how loud the note is.
+        :param velocity: How loud the note is, from 1 to 127 (see dynamics.py).
+        """
+        self.__velocity = velocity
+
+    @property
+    def expression(self) -> int:
+        """The expression flags of the note, e.g. expressions.GLIDE (see expressions.py)."""
+        return self.__expression
+
+    @expression.setter
+    def expression(self, expression: int) -> None:
+        """
+        Sets the expression flags of the note.
+        :param expression: The expression flags of the note, e.g. expressions.GLIDE (see expressions.py).
+        """
+        self.__expression = expression
+
     def tie_with(self, other: 'Note') -> 'Note':
         """Returns a new note that is this note tied with the provided note. Both notes must have the same pitch."""
         if self.__pitch != other.pitch:
             raise ValueError('Tied notes must have the same pitch')
         offset = min(self.__offset, other.__offset)
         duration = max(self.end_offset - offset, other.end_offset - offset)
-        return Note(self.__pitch, offset, duration, other.__articulation)
+        return Note(self.__pitch, offset, duration, other.__articulation, self.__velocity, self.__expression)
 
     # Gets a human-readable representation of the note
     def __str__(self):
         return (f'Note(pitch={self.pitch}, offset={self.offset}, duration={self.duration}, '
-                f'articulation={self.articulation})')
+                f'articulation={self.articulation}, velocity={self.velocity}, expression={self.expression})')
 
     # Gets a representation of the note that could be evaluated in Python to produce the instance exactly
     def __repr__(self):
         return (f'Note(pitch={self.pitch!r}, offset={self.offset!r}, duration={self.duration!r}, '
-                f'articulation={self.articulation!r})')
+                f'articulation={self.articulation!r}, velocity={self.velocity!r}, expression={self.expression!r})')
+
+
+def _to_fraction(value: Rational) -> Fraction:
+    """
+    Converts value to a Fraction, unless it already is one. Making a Fraction is slow, and MIDI files (see midi.py) can
+    have tens of thousands of notes.
+    """
+    return value if type(value) is Fraction else Fraction(value)
 
 
 # A dataclass is a very simple class that stores the listed information in the given data type. The initializer
@@ -86,6 +132,24 @@ class MachineNote:
     frequency: int
     """The pitch of the note, in Hertz."""
     offset_millis: int
-    """The offset of the note (position from the start), in milliseconds."""
+    """The offset of the note (position from the start), in whole milliseconds."""
     duration_millis: int
     """The duration of the note, in milliseconds."""
+    offset_fraction: int = 0
+    """The part of the offset smaller than a millisecond, in 256ths of a millisecond (see note.hpp)."""
+
+    @property
+    def exact_offset_millis(self) -> Fraction:
+        """The offset of the note in milliseconds, including the fraction of a millisecond."""
+        return self.offset_millis + Fraction(self.offset_fraction, 256)
+
+    @property
+    def fixed_point_offset(self) -> int:
+        """The whole offset of the note in 256ths of a millisecond, like Note::fixedPointOffset() in note.hpp."""
+        return self.offset_millis << 8 | self.offset_fraction
+
+    def get_cpp_string(self) -> str:
+        """Returns the C++ initializer of this note, e.g. {440, 1000, 250}. The fraction is left out when it's 0."""
+        if self.offset_fraction:
+            return f'{{{self.frequency}, {self.offset_millis}, {self.duration_millis}, {self.offset_fraction}}}'
+        return f'{{{self.frequency}, {self.offset_millis}, {self.duration_millis}}}'
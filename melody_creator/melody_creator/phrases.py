@@ -0,0 +1,247 @@
+"""
+Finds repeated (and transposed) runs of notes in melodies and prints the melodies as phrase tables, which take up much
+less of the Arduino's memory. See phrase.hpp for the format and for the Arduino code that plays them.
+
+Print every song from a C++ file as a phrase table, along with how much smaller each one got, with:
+
+    python3 -m melody_creator.phrases songs.hpp
+"""
+
+import argparse
+import math
+import sys
+from collections.abc import Sequence
+from dataclasses import dataclass, replace
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+from melody_creator.songs_file import read_songs
+
+LOWEST_PITCH = 23
+"""The MIDI note number of the first frequency in PITCH_FREQUENCIES."""
+PITCH_FREQUENCIES = [
+    31, 33, 35, 37, 39, 41, 44, 46, 49, 52, 55, 58,
+    62, 65, 69, 73, 78, 82, 87, 93, 98, 104, 110, 117,
+    123, 131, 139, 147, 156, 165, 175, 185, 196, 208, 220, 233,
+    247, 262, 277, 294, 311, 330, 349, 370, 392, 415, 440, 466,
+    494, 523, 554, 587, 622, 659, 698, 740, 784, 831, 880, 932,
+    988, 1047, 1109, 1175, 1245, 1319, 1397, 1480, 1568, 1661, 1760, 1865,
+    1976, 2093, 2217, 2349, 2489, 2637, 2794, 2960, 3136, 3322, 3520, 3729,
+    3951, 4186, 4435, 4699, 4978,
+]
+"""The frequencies of MIDI notes LOWEST_PITCH and up, exactly as in PITCH_FREQUENCIES in pitches.hpp."""
+
+CALL = 0xFF
+"""The pitch that marks an item as a call to another phrase (PHRASE_CALL in phrase.hpp)."""
+MAX_DEPTH = 4
+"""The most phrases that can be in progress at once on the Arduino (MAX_PHRASE_DEPTH in phrase.hpp)."""
+ITEM_SIZE = 6
+"""The size of a PhraseItem on the Arduino, in bytes."""
+NOTE_SIZE = 8
+"""The size of a Note on the Arduino, in bytes."""
+MAX_PHRASE_LENGTH = 32
+"""The longest phrase looked for, in items. Longer repeats are still found, as phrases that call other phrases."""
+
+
+def pitch_of(frequency: int) -> int:
+    """Returns the MIDI note number of the given frequency, which must be (within 1 Hz) one of PITCH_FREQUENCIES."""
+    pitch = round(69 + 12 * math.log2(frequency / 440))
+    if not LOWEST_PITCH <= pitch < LOWEST_PITCH + len(PITCH_FREQUENCIES) \
+            or abs(PITCH_FREQUENCIES[pitch - LOWEST_PITCH] - frequency) > 1:
+        raise ValueError(f'{frequency} Hz is not one of the pitches in pitches.hpp')
+    return pitch
+
+
+@dataclass(frozen=True)
+class PhraseItem:
+    """One note of a phrase or a call to another phrase, exactly like a PhraseItem in phrase.hpp."""
+
+    delta: int
+    """The time in milliseconds from the start of the previous item to the start of this one."""
+    value: int
+    """For a note, its duration in milliseconds. For a call, the number of the phrase to play."""
+    pitch: int
+    """For a note, its MIDI note number. For a call, CALL."""
+    transpose: int = 0
+    """For a call, how many semitones to move the phrase by."""
+
+    @property
+    def level(self) -> int:
+        """The pitch of a note or the transposition of a call. Transposing an item adds to its level."""
+        return self.transpose if self.pitch == CALL else self.pitch
+
+
+class PhraseMelody:
+    """A melody stored as phrases. Phrase 0 is the song itself; the others are runs of items that it repeats."""
+
+    def __init__(self, phrases: Sequence[Sequence[PhraseItem]]):
+        """
+        Initializes a new PhraseMelody.
+        :param phrases: The items of each phrase, starting with phrase 0.
+        """
+        self.__phrases = [list(phrase) for phrase in phrases]
+
+    @classmethod
+    def from_notes(cls, notes: Sequence[MachineNote]) -> 'PhraseMelody':
+        """Finds the repeats in the given notes and returns them as a PhraseMelody."""
+        items = []
+        previous_offset = 0
+        for note in sorted(notes, key=lambda n: n.offset_millis):
+            delta = note.offset_millis - previous_offset
+            if delta > 0xFFFF or note.duration_millis > 0xFFFF:
+                raise ValueError('a note is too long (or too long after the previous note) for a phrase item')
+            items.append(PhraseItem(delta, note.duration_millis, pitch_of(note.frequency)))
+            previous_offset = note.offset_millis
+        melody = cls([items])
+        # Each round replaces the repeat that saves the most bytes with a new phrase. The new phrase's calls are items
+        # too, so later rounds can find repeats that contain them, which is how phrases end up calling phrases.
+        while melody.__extract_best_phrase():
+            pass
+        return melody
+
+    @property
+    def phrases(self) -> list[list[PhraseItem]]:
+        """The items of each phrase, starting with phrase 0 (the song itself)."""
+        return self.__phrases
+
+    @property
+    def size(self) -> int:
+        """The number of bytes the items and the phrase start table take up on the Arduino."""
+        return ITEM_SIZE * sum(len(phrase) for phrase in self.__phrases) + 2 * (len(self.__phrases) + 1)
+
+    def expand(self) -> list[MachineNote]:
+        """Returns the notes of the melody, exactly as PhraseStream in phrase.ino plays them."""
+        notes = []
+        time = 0
+        # The same call stack as PhraseStream: (phrase number, position of the next item, transposition)
+        stack = [(0, 0, 0)]
+        while stack:
+            phrase, position, transpose = stack.pop()
+            if position == len(self.__phrases[phrase]):
+                continue
+            item = self.__phrases[phrase][position]
+            stack.append((phrase, position + 1, transpose))
+            time += item.delta
+            if item.pitch == CALL:
+                stack.append((item.value, 0, transpose + item.transpose))
+            else:
+                pitch = item.pitch + transpose
+                notes.append(MachineNote(PITCH_FREQUENCIES[pitch - LOWEST_PITCH], time, item.value))
+        return notes
+
+    def get_cpp_string(self, variable_name: str = 'MY_MELODY') -> str:
+        """Returns the source code of the C++ definitions required to define this melody (see phrase.hpp)."""
+        # PROGMEM keeps both arrays in flash instead of copying them into RAM (see phrase.hpp).
+        lines = [f'const PhraseItem {variable_name}_ITEMS[] PROGMEM = {{']
+        starts = [0]
+        for number, phrase in enumerate(self.__phrases):
+            lines.append('  // The song itself' if number == 0 else f'  // Phrase {number}')
+            for item in phrase:
+                pitch = 'PHRASE_CALL' if item.pitch == CALL else str(item.pitch)
+                lines.append(f'  {{{item.delta}, {item.value}, {pitch}, {item.transpose}}},')
+            starts.append(starts[-1] + len(phrase))
+        lines[-1] = lines[-1].rstrip(',')
+        lines.append('};')
+        lines.append(f'const uint16_t {variable_name}_PHRASES[] PROGMEM = {{{", ".join(map(str, starts))}}};')
+        lines.append(f'const PhraseMelody {variable_name} = {{{variable_name}_ITEMS, {variable_name}_PHRASES, '
+                     f'{len(self.__phrases)}}};')
+        return '\n'.join(lines)
+
+    @staticmethod
+    def __depth(phrases: Sequence[Sequence[PhraseItem]], number: int) -> int:
+        """Returns how many frames of the call stack playing the given phrase takes, including its own."""
+        return 1 + max((PhraseMelody.__depth(phrases, item.value) for item in phrases[number] if item.pitch == CALL),
+                       default=0)
+
+    def __extract_best_phrase(self) -> bool:
+        """Replaces the repeat that saves the most bytes with a call to a new phrase. Returns False if no repeat saves
+        anything."""
+        # Two runs of items are repeats of each other if they have the same "shape": the same durations, the same
+        # times between items, and the same pitches relative to their first item. The time before the first item
+        # doesn't matter, since that's stored in the call. The shape is used as a key in a dictionary, so all of the
+        # places a run with that shape occurs are found in one pass.
+        occurrences: dict[tuple, list[tuple[int, int]]] = {}
+        for number, phrase in enumerate(self.__phrases):
+            for start in range(len(phrase)):
+                base = phrase[start].level
+                shape = ()
+                for end in range(start, min(start + MAX_PHRASE_LENGTH, len(phrase))):
+                    item = phrase[end]
+                    shape += ((item.delta if end > start else None, item.value, item.pitch == CALL, item.level - base),)
+                    if end > start:
+                        occurrences.setdefault(shape, []).append((number, start))
+
+        candidates = []
+        for shape, places in occurrences.items():
+            length = len(shape)
+            # Runs that overlap can't both be replaced, so only count the ones that start after the previous one ends.
+            chosen = []
+            for number, start in places:
+                if not chosen or chosen[-1][0] != number or start >= chosen[-1][1] + length:
+                    chosen.append((number, start))
+            # Every run of length items becomes one call, and the phrase itself costs length items and a start.
+            saving = ITEM_SIZE * (len(chosen) * (length - 1) - length) - 2
+            if saving > 0:
+                candidates.append((saving, length, chosen))
+
+        # Try the biggest saving first (and the longer phrase if two save the same). A replacement that would nest
+        # phrases deeper than the Arduino's call stack allows is skipped.
+        candidates.sort(key=lambda candidate: (candidate[0], candidate[1]), reverse=True)
+        for _, length, chosen in candidates:
+            phrases = [list(phrase) for phrase in self.__phrases]
+            number, start = chosen[0]
+            template = phrases[number][start:start + length]
+            new_number = len(phrases)
+            phrases.append([replace(template[0], delta=0)] + template[1:])
+            # Replace the runs from the back, so that replacing one doesn't move the ones before it.
+            for number, start in reversed(chosen):
+                phrase = phrases[number]
+                call = PhraseItem(phrase[start].delta, new_number, CALL, phrase[start].level - template[0].level)
+                phrase[start:start + length] = [call]
+            if self.__depth(phrases, 0) <= MAX_DEPTH:
+                self.__phrases = phrases
+                return True
+        return False
+
+
+def main() -> None:
+    """Prints the melodies in a C++ file such as songs.hpp as phrase tables, with a report of the bytes saved."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.phrases',
+                                     description='Compress melodies by storing repeated phrases once.')
+    parser.add_argument('songs_path', type=Path, help='C++ file with melody definitions (e.g. songs.hpp).')
+    parser.add_argument('-n', '--name', dest='song_name', type=str,
+                        help='Name of the melody to print. By default, every melody is printed.')
+    parser.add_argument('-s', '--suffix', type=str, default='_PHRASED',
+                        help='Added to the name of each melody to name its phrase table, so both can be in one sketch.')
+    namespace = parser.parse_args()
+
+    songs = read_songs(namespace.songs_path)
+    if namespace.song_name is not None:
+        if namespace.song_name not in songs:
+            sys.exit(f'ERROR: {namespace.song_name} not found in {namespace.songs_path}')
+        songs = {namespace.song_name: songs[namespace.song_name]}
+    if not songs:
+        sys.exit('ERROR: no melodies found')
+
+    report = []
+    for name, notes in songs.items():
+        melody = PhraseMelody.from_notes(notes)
+        # Make sure the Arduino will play exactly the same notes (up to the 1 Hz differences between pitches.hpp and
+        # the frequencies melody_creator calculates).
+        expanded = melody.expand()
+        if [(pitch_of(n.frequency), n.offset_millis, n.duration_millis) for n in expanded] != \
+                [(pitch_of(n.frequency), n.offset_millis, n.duration_millis) for n in notes]:
+            sys.exit(f'ERROR: the phrases of {name} do not play the same notes; this is a bug')
+        print(melody.get_cpp_string(name + namespace.suffix))
+        print()
+        report.append((name, len(notes), len(melody.phrases) - 1, NOTE_SIZE * len(notes), melody.size))
+
+    # The report goes to stderr so that the C++ can be redirected into a file on its own.
+    print(f'{"Song":<24} {"Notes":>6} {"Phrases":>8} {"Before":>8} {"After":>8} {"Saved":>6}', file=sys.stderr)
+    for name, note_count, phrase_count, before, after in report:
+        print(f'{name:<24} {note_count:>6} {phrase_count:>8} {before:>7}B {after:>7}B {1 - after / before:>6.0%}',
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,275 @@
+"""
+Stores the notes of every song in a C++ file in one shared pool, with each run of notes that comes up more than once
+(in the same song or in different ones) stored only once, and prints each song as a list of segments of the pool. See
+pool.hpp for the format and for the Arduino code that plays it.
+
+Print the pool of every song in a C++ file, along with how many bytes the whole library saves, with:
+
+    python3 -m melody_creator.pool songs.hpp
+"""
+
+import argparse
+import sys
+from collections.abc import Sequence
+from dataclasses import dataclass
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+from melody_creator.songs_file import read_songs
+
+NOTE_SIZE = 8
+"""The size of a Note on the Arduino, in bytes."""
+SEGMENT_SIZE = 8
+"""The size of a PoolSegment on the Arduino, in bytes."""
+MELODY_SIZE = 6
+"""The size of a PooledMelody on the Arduino, in bytes."""
+MIN_RUN = 3
+"""
+The fewest notes worth sharing. Sharing a run costs a segment, and usually another one for the notes after it, so two
+notes (16 bytes) would save nothing.
+"""
+
+
+@dataclass(frozen=True)
+class Segment:
+    """Some notes of a song, played from the pool (a PoolSegment in pool.hpp)."""
+
+    first: int
+    """The position in the pool of the first note."""
+    count: int
+    """The number of notes."""
+    start: int
+    """When the first note starts, in 256ths of a millisecond from the start of the song."""
+
+    def get_cpp_string(self) -> str:
+        """Returns the C++ initializer of this segment, e.g. {12, 5, 256000}."""
+        return f'{{{self.first}, {self.count}, {self.start}}}'
+
+
+def _fixed_point(note: MachineNote) -> int:
+    """Returns the offset of a note in 256ths of a millisecond, as Note::fixedPointOffset() does."""
+    return note.offset_millis * 256 + note.offset_fraction
+
+
+def suffix_array(text: Sequence[int]) -> list[int]:
+    """
+    Returns the suffix array of text: the positions of all of its suffixes (the runs from a position to the end),
+    sorted. Suffixes that start with the same run end up next to each other, which is what makes repeats easy to find.
+    This sorts by the first symbol, then the first 2, 4, 8, ... symbols, using the ranks of the previous round, so it
+    takes O(n log^2 n) time instead of comparing whole suffixes.
+    """
+    size = len(text)
+    rank = list(text)
+    positions = list(range(size))
+    length = 1
+    while True:
+        def key(position: int) -> tuple[int, int]:
+            return rank[position], rank[position + length] if position + length < size else -1
+
+        positions.sort(key=key)
+        new_rank = [0] * size
+        for index in range(1, size):
+            new_rank[positions[index]] = new_rank[positions[index - 1]] + \
+                (key(positions[index]) != key(positions[index - 1]))
+        rank = new_rank
+        if size == 0 or rank[positions[-1]] == size - 1:
+            return positions
+        length *= 2
+
+
+def longest_common_prefixes(text: Sequence[int], positions: Sequence[int]) -> list[int]:
+    """
+    Returns how many symbols each suffix in the suffix array has in common with the one before it (0 for the first).
+    This is Kasai's algorithm: going through the suffixes in the order of the text, the next one's common prefix is at
+    most one shorter than this one's, so it never has to compare more than about 2n symbols in total.
+    """
+    size = len(text)
+    rank = [0] * size
+    for index, position in enumerate(positions):
+        rank[position] = index
+    common = [0] * size
+    length = 0
+    for position in range(size):
+        if rank[position] == 0:
+            length = 0
+            continue
+        previous = positions[rank[position] - 1]
+        while position + length < size and previous + length < size \
+                and text[position + length] == text[previous + length]:
+            length += 1
+        common[rank[position]] = length
+        if length > 0:
+            length -= 1
+    return common
+
+
+class NotePool:
+    """The notes of a whole library of songs, with shared runs stored once, and the segments that play each song."""
+
+    def __init__(self, songs: dict[str, list[MachineNote]]):
+        """
+        Builds the pool. Each song is read from start to end, and at each note, the longest run starting there that's
+        already in the pool (from an earlier song or earlier in the same song) is played from the pool if it's at least
+        MIN_RUN notes long. Otherwise the note is added to the pool.
+        """
+        self.notes: list[MachineNote] = []
+        """The notes of the pool."""
+        self.songs: dict[str, list[Segment]] = {}
+        """The segments of each song."""
+        self.added: dict[str, int] = {}
+        """How many notes each song added to the pool. The rest of its notes were already in it."""
+
+        # Every song is turned into symbols, one per note, with a separator after each song so that no run goes from one
+        # song into the next. Two runs are the same if their notes have the same frequencies and durations and start
+        # the same time apart, so a symbol is a note's frequency, duration, and the time until the next note.
+        text = []
+        symbols: dict[tuple[int, int, int], int] = {}
+        song_notes = []
+        for notes in songs.values():
+            for index, note in enumerate(notes):
+                gap = _fixed_point(notes[index + 1]) - _fixed_point(note) if index + 1 < len(notes) else -1
+                text.append(symbols.setdefault((note.frequency, note.duration_millis, gap), len(symbols)))
+                song_notes.append(note)
+            text.append(-1)
+            song_notes.append(None)
+        separator = len(symbols)
+        for position, symbol in enumerate(text):
+            if symbol == -1:
+                text[position] = separator
+                separator += 1
+
+        positions = suffix_array(text)
+        common = longest_common_prefixes(text, positions)
+        rank = [0] * len(text)
+        for index, position in enumerate(positions):
+            rank[position] = index
+        # Where each note of the text is in the pool, or None if it hasn't been added to it.
+        pooled: list[int | None] = [None] * len(text)
+
+        def pooled_run(position: int, limit: int) -> int:
+            """Returns how many notes from position on are in the pool in order, up to limit."""
+            length = 0
+            while length < limit and pooled[position + length] is not None \
+                    and pooled[position + length] == pooled[position] + length:
+                length += 1
+            return length
+
+        def longest_match(position: int) -> tuple[int, int]:
+            """Returns the position and length of the longest run in the pool that the text at position starts with."""
+            best_position, best_length = -1, 0
+            # The runs with the longest prefix in common are next to position in the suffix array. Going further away
+            # in either direction, the prefix in common can only get shorter, so the search stops once it's no longer
+            # than the best run found.
+            for direction in (-1, 1):
+                shortest = len(text)
+                index = rank[position]
+                while 0 <= index + direction < len(text):
+                    shortest = min(shortest, common[index] if direction == -1 else common[index + 1])
+                    if shortest <= best_length:
+                        break
+                    index += direction
+                    length = pooled_run(positions[index], shortest)
+                    if length > best_length:
+                        best_position, best_length = positions[index], length
+            return best_position, best_length
+
+        position = 0
+        for name, notes in songs.items():
+            segments: list[Segment] = []
+            self.added[name] = 0
+            end = position + len(notes)
+            while position < end:
+                match, length = longest_match(position)
+                if length < MIN_RUN:
+                    pooled[position] = len(self.notes)
+                    self.notes.append(song_notes[position])
+                    self.added[name] += 1
+                    match, length = position, 1
+                self.__add(segments, Segment(pooled[match], length, _fixed_point(song_notes[position])))
+                position += length
+            self.songs[name] = segments
+            position += 1
+
+    def __add(self, segments: list[Segment], segment: Segment) -> None:
+        """Adds a segment to a song, joining it onto the one before if it carries on from it in the pool and in time."""
+        if segments:
+            last = segments[-1]
+            if last.first + last.count == segment.first and segment.start - last.start == \
+                    _fixed_point(self.notes[segment.first]) - _fixed_point(self.notes[last.first]):
+                segments[-1] = Segment(last.first, last.count + segment.count, last.start)
+                return
+        segments.append(segment)
+
+    def expand(self, name: str) -> list[MachineNote]:
+        """Returns the notes of a song, as the Arduino's PoolStream plays them."""
+        notes = []
+        for segment in self.songs[name]:
+            base = _fixed_point(self.notes[segment.first])
+            for note in self.notes[segment.first:segment.first + segment.count]:
+                offset = segment.start + _fixed_point(note) - base
+                notes.append(MachineNote(note.frequency, offset >> 8, note.duration_millis, offset & 0xFF))
+        return notes
+
+    @property
+    def size(self) -> int:
+        """The size of the pool and every song's segments and PooledMelody on the Arduino, in bytes."""
+        return NOTE_SIZE * len(self.notes) + sum(SEGMENT_SIZE * len(segments) + MELODY_SIZE
+                                                 for segments in self.songs.values())
+
+    def get_cpp_string(self, pool_name: str, suffix: str) -> str:
+        """Returns the C++ of the pool and of the segments and PooledMelody of every song."""
+        lines = [f'const Note {pool_name}[{len(self.notes)}] = {{']
+        lines += [f'  {note.get_cpp_string()},' for note in self.notes]
+        lines.append('};')
+        for name, segments in self.songs.items():
+            lines.append('')
+            lines.append(f'const PoolSegment {name}{suffix}_SEGMENTS[{len(segments)}] = {{')
+            lines += [f'  {segment.get_cpp_string()},' for segment in segments]
+            lines.append('};')
+            lines.append(f'const PooledMelody {name}{suffix} = {{{pool_name}, {name}{suffix}_SEGMENTS, '
+                         f'{len(segments)}}};')
+        return '\n'.join(lines)
+
+
+def main() -> None:
+    """Prints the melodies in a C++ file such as songs.hpp as one note pool, with a report of the bytes saved."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.pool',
+                                     description='Store the notes of every melody in one pool, sharing repeated runs.')
+    parser.add_argument('songs_path', type=Path, nargs='+',
+                        help='C++ files with melody definitions (e.g. songs.hpp).')
+    parser.add_argument('-p', '--pool', dest='pool_name', type=str, default='NOTE_POOL',
+                        help='The name of the pool array.')
+    parser.add_argument('-s', '--suffix', type=str, default='_POOLED',
+                        help='Added to the name of each melody to name its segments, so both can be in one sketch.')
+    namespace = parser.parse_args()
+
+    songs = {}
+    for path in namespace.songs_path:
+        for name, notes in read_songs(path).items():
+            if name in songs:
+                sys.exit(f'ERROR: more than one melody is called {name}')
+            songs[name] = notes
+    if not songs:
+        sys.exit('ERROR: no melodies found')
+
+    pool = NotePool(songs)
+    for name, notes in songs.items():
+        # Make sure the Arduino will play exactly the same notes.
+        if pool.expand(name) != notes:
+            sys.exit(f'ERROR: the segments of {name} do not play the same notes; this is a bug')
+    print(pool.get_cpp_string(namespace.pool_name, namespace.suffix))
+
+    # The report goes to stderr so that the C++ can be redirected into a file on its own.
+    print(f'{"Song":<24} {"Notes":>6} {"Segments":>9} {"Shared":>7}', file=sys.stderr)
+    for name, segments in pool.songs.items():
+        # Shared notes are played from runs that were already in the pool, so this song didn't add them to it.
+        shared = len(songs[name]) - pool.added[name]
+        print(f'{name:<24} {len(songs[name]):>6} {len(segments):>9} {shared:>7}', file=sys.stderr)
+    before = NOTE_SIZE * sum(len(notes) for notes in songs.values())
+    after = pool.size
+    print(f'{len(songs)} songs: {before}B as Melodies, {after}B pooled ({len(pool.notes)} notes in the pool), '
+          f'{before - after}B ({1 - after / before:.0%}) saved', file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,367 @@
+"""
+Keeps the repeat structure of a score (repeat signs, voltas, D.C. and D.S.) instead of writing repeated notes out again.
+See sections.hpp for the format and for the Arduino code that plays it.
+"""
+
+from collections.abc import Sequence
+from dataclasses import dataclass
+from fractions import Fraction
+from typing import Self
+
+import music21 as m21
+
+from melody_creator.melody import Melody
+from melody_creator.note import Note, MachineNote
+from melody_creator.tempo import Tempo
+
+ALL_PASSES = 0xFF
+"""A passes mask that plays an entry on every pass (ALL_PASSES in sections.hpp)."""
+MAX_LOOP_DEPTH = 4
+"""The most loops that can be in progress at once on the Arduino, including the song itself."""
+SECTION_SIZE = 10
+"""The size of a Section on the Arduino, in bytes."""
+NOTE_SIZE = 8
+"""The size of a Note on the Arduino, in bytes."""
+
+
+def passes_mask(numbers: Sequence[int]) -> int:
+    """Returns the passes mask for the given (1-based) volta numbers. Passes after the eighth share bit 7, like on the
+    Arduino."""
+    mask = 0
+    for number in numbers:
+        mask |= 1 << min(number - 1, 7)
+    return mask
+
+
+@dataclass
+class MeasureMarks:
+    """The repeat-related markings of one measure of a score."""
+
+    offset: Fraction
+    """The offset of the measure (position from the start), in whole-lengths."""
+    length: Fraction
+    """The duration of the measure, in whole-lengths."""
+    start_repeat: bool = False
+    """Whether the measure starts with a start-repeat sign."""
+    end_repeat: int = 0
+    """If the measure ends with an end-repeat sign, how many times the repeated part is played in total; otherwise 0."""
+    voltas: tuple[int, ...] = ()
+    """The numbers of the volta bracket over the measure (e.g. (1, 2) for "1.-2."), or () if there isn't one."""
+    segno: bool = False
+    """Whether the measure has a segno sign (where D.S. jumps back to)."""
+    coda: bool = False
+    """Whether the measure has a coda sign: "to coda" before the D.C. or D.S., or the start of the coda after it."""
+    fine: bool = False
+    """Whether the measure has a Fine marking (where the music ends after a D.C. or D.S.)."""
+    jump: str | None = None
+    """'D.C.' or 'D.S.' if the measure ends by jumping back, otherwise None."""
+
+
+@dataclass
+class _Span:
+    """Measures first to last (inclusive) of a score, played on the given passes of the loop around them."""
+    first: int
+    last: int
+    passes: int = ALL_PASSES
+
+
+@dataclass
+class _Repeat:
+    """Items played times times, on the given passes of the loop around them."""
+    body: list['_Span | _Repeat']
+    times: int
+    passes: int = ALL_PASSES
+
+    @property
+    def first(self) -> int:
+        return self.body[0].first
+
+    @property
+    def last(self) -> int:
+        return self.body[-1].last
+
+
+@dataclass
+class NoteSection:
+    """Notes played together, with offsets from the start of the section (a notes Section in sections.hpp)."""
+
+    notes: list[MachineNote]
+    """The notes of the section, with offsets in milliseconds from the start of the section."""
+    length: int
+    """The time from the start of the section to the start of whatever plays after it, in 256ths of a millisecond."""
+    passes: int = ALL_PASSES
+    """On which passes of the enclosing loop the section plays."""
+
+
+@dataclass
+class Loop:
+    """Sections played a number of times in a row (a loop Section in sections.hpp)."""
+
+    body: list['NoteSection | Loop']
+    """The sections that are repeated."""
+    times: int
+    """How many times the body is played."""
+    passes: int = ALL_PASSES
+    """On which passes of the enclosing loop the loop plays."""
+
+
+def read_marks(stream: m21.stream.Stream) -> list[MeasureMarks]:
+    """Returns the repeat-related markings of every measure of the first part of the given stream."""
+    part = stream.parts[0] if stream.hasPartLikeStreams() else stream
+    measures = list(part.getElementsByClass(m21.stream.Measure))
+
+    # Volta brackets are spanners (like slurs) over whole measures. id() tells measures apart even if two of them
+    # happen to be equal.
+    voltas: dict[int, tuple[int, ...]] = {}
+    bracket: m21.spanner.RepeatBracket
+    for bracket in part.recurse().getElementsByClass(m21.spanner.RepeatBracket):
+        for measure in bracket.getSpannedElements():
+            voltas[id(measure)] = tuple(bracket.getNumberList())
+
+    marks = []
+    for measure in measures:
+        # Offsets and durations in music21 are in quarter-lengths, so they're divided by four (see melody.py).
+        mark = MeasureMarks(Fraction(measure.offset) / 4, Fraction(measure.duration.quarterLength) / 4,
+                            voltas=voltas.get(id(measure), ()))
+        if isinstance(measure.leftBarline, m21.bar.Repeat) and measure.leftBarline.direction == 'start':
+            mark.start_repeat = True
+        if isinstance(measure.rightBarline, m21.bar.Repeat) and measure.rightBarline.direction == 'end':
+            mark.end_repeat = measure.rightBarline.times or 2
+        for expression in measure.getElementsByClass(m21.repeat.RepeatExpression):
+            if isinstance(expression, m21.repeat.Segno):
+                mark.segno = True
+            elif isinstance(expression, m21.repeat.Coda):
+                mark.coda = True
+            elif isinstance(expression, m21.repeat.Fine):
+                mark.fine = True
+            elif isinstance(expression, (m21.repeat.DaCapo, m21.repeat.DaCapoAlFine, m21.repeat.DaCapoAlCoda)):
+                mark.jump = 'D.C.'
+            elif isinstance(expression, (m21.repeat.DalSegno, m21.repeat.DalSegnoAlFine, m21.repeat.DalSegnoAlCoda)):
+                mark.jump = 'D.S.'
+        marks.append(mark)
+    return marks
+
+
+def _build_repeats(marks: Sequence[MeasureMarks]) -> list[_Span | _Repeat]:
+    """Turns repeat signs and voltas into loops over measures."""
+    items: list[_Span | _Repeat] = []
+    # Nested start-repeat signs each start a new list of items. Most scores never nest them, so this is usually just
+    # the top-level list.
+    open_repeats: list[list[_Span | _Repeat]] = []
+    current = items
+    # An end-repeat sign without a start-repeat sign goes back to the start of the piece, or to just after the previous
+    # repeat if there was one.
+    repeat_from = 0
+    index = 0
+    while index < len(marks):
+        mark = marks[index]
+        if mark.start_repeat:
+            open_repeats.append(current)
+            current = []
+        current.append(_Span(index, index, passes_mask(mark.voltas) if mark.voltas else ALL_PASSES))
+        index += 1
+        if not mark.end_repeat:
+            continue
+
+        if open_repeats:
+            body = current
+            current = open_repeats.pop()
+        else:
+            body = items[repeat_from:]
+            del items[repeat_from:]
+        # The later endings come after the end-repeat sign, but they belong to the loop: they're the measures that
+        # replace the first ending on later passes. They're recognized by having volta numbers not used yet.
+        used = {number for mark in marks[body[0].first:index] for number in mark.voltas}
+        while (index < len(marks) and marks[index].voltas and not marks[index].start_repeat
+               and not used.intersection(marks[index].voltas)):
+            body.append(_Span(index, index, passes_mask(marks[index].voltas)))
+            if marks[index].end_repeat or index + 1 == len(marks) or marks[index + 1].voltas != marks[index].voltas:
+                used.update(marks[index].voltas)
+            index += 1
+        current.append(_Repeat(body, max([mark.end_repeat, *used])))
+        if current is items:
+            repeat_from = len(items)
+    if open_repeats:
+        raise ValueError('a start-repeat sign has no matching end-repeat sign')
+    return items
+
+
+def _item_containing(items: Sequence[_Span | _Repeat], measure: int) -> int:
+    """Returns the position of the item in items that contains the given measure."""
+    return next(i for i, item in enumerate(items) if item.first <= measure <= item.last)
+
+
+def _build_jump(marks: Sequence[MeasureMarks], items: list[_Span | _Repeat]) -> list[_Span | _Repeat]:
+    """Turns a D.C. or D.S. into a loop that plays twice, where the part after the Fine or "to coda" sign only plays on
+    the first pass. Repeats inside it are played again on the second pass."""
+    jumps = [i for i, mark in enumerate(marks) if mark.jump is not None]
+    if not jumps:
+        return items
+    if len(jumps) > 1:
+        raise ValueError('only one D.C. or D.S. per score is supported')
+    jump = jumps[0]
+    if marks[jump].jump == 'D.C.':
+        target = 0
+    else:
+        segnos = [i for i, mark in enumerate(marks) if mark.segno and i <= jump]
+        if not segnos:
+            raise ValueError('D.S. without a segno sign before it')
+        target = _item_containing(items, segnos[-1])
+        if items[target].first != segnos[-1]:
+            raise ValueError('a segno sign must not be inside a repeat')
+    end = _item_containing(items, jump)
+
+    fines = [i for i, mark in enumerate(marks) if mark.fine and i <= jump]
+    to_codas = [i for i, mark in enumerate(marks) if mark.coda and i <= jump]
+    codas = [i for i, mark in enumerate(marks) if mark.coda and i > jump]
+    # On the second pass, the music stops after the Fine measure or jumps to the coda after the "to coda" measure, so
+    # everything after that point is only played on the first pass.
+    stop = fines[-1] if fines else to_codas[-1] if to_codas and codas else jump
+    body = items[target:end + 1]
+    for item in body:
+        if item.first > stop:
+            item.passes = passes_mask([1])
+    after = items[_item_containing(items, codas[0]):] if codas and not fines else []
+    return items[:target] + [_Repeat(body, 2)] + after
+
+
+def _merge(items: list[_Span | _Repeat]) -> list[_Span | _Repeat]:
+    """Joins neighbouring measures that are played on the same passes into a single span."""
+    merged: list[_Span | _Repeat] = []
+    for item in items:
+        if isinstance(item, _Repeat):
+            merged.append(_Repeat(_merge(item.body), item.times, item.passes))
+        elif (merged and isinstance(merged[-1], _Span) and merged[-1].passes == item.passes
+              and merged[-1].last + 1 == item.first):
+            merged[-1] = _Span(merged[-1].first, item.last, item.passes)
+        else:
+            merged.append(item)
+    return merged
+
+
+class SectionMelody:
+    """A melody stored as sections that are played in an order given by loops (see sections.hpp)."""
+
+    def __init__(self, sections: Sequence[NoteSection | Loop]) -> None:
+        """
+        Initializes a new SectionMelody.
+        :param sections: The sections, in the order they're written.
+        """
+        self.__sections = list(sections)
+
+    @classmethod
+    def from_marks(cls, notes: Sequence[Note], marks: Sequence[MeasureMarks],
+                   tempo: Tempo = Tempo.quarter_equals(120)) -> Self:
+        """
+        Creates a new SectionMelody from notes in written order and the repeat markings of every measure.
+        :param notes: The notes as written (each repeated part written once), with offsets in whole-lengths.
+        :param marks: The markings of every measure, in order.
+        :param tempo: The tempo of the melody.
+        """
+        items = _merge(_build_jump(marks, _build_repeats(marks)))
+        notes = sorted(notes, key=lambda n: n.offset)
+
+        def convert(item: _Span | _Repeat) -> NoteSection | Loop:
+            if isinstance(item, _Repeat):
+                return Loop([convert(inner) for inner in item.body], item.times, item.passes)
+            start = marks[item.first].offset
+            end = marks[item.last].offset + marks[item.last].length
+            # Times are converted from the start of the piece in 256ths of a millisecond (see note.hpp) and then
+            # subtracted, so each note ends up at exactly the time it would have in a Melody. Rounding the start to a
+            # whole millisecond instead could round it up, past the notes' whole milliseconds (which are rounded down).
+            start_fixed = tempo.wholes_to_fixed_point(start)
+            section_notes = []
+            for machine_note in tempo.notes_to_machine_notes([n for n in notes if start <= n.offset < end]):
+                offset_millis, offset_fraction = divmod(machine_note.fixed_point_offset - start_fixed, 256)
+                section_notes.append(MachineNote(machine_note.frequency, offset_millis, machine_note.duration_millis,
+                                                 offset_fraction))
+            return NoteSection(section_notes, tempo.wholes_to_fixed_point(end) - start_fixed, item.passes)
+
+        melody = cls([convert(item) for item in items])
+        if melody.depth > MAX_LOOP_DEPTH:
+            raise ValueError(f'repeats are nested too deeply for the Arduino (more than {MAX_LOOP_DEPTH - 1} levels)')
+        return melody
+
+    @classmethod
+    def from_stream(cls, stream: m21.stream.Stream) -> Self:
+        """Creates a new SectionMelody from a music21 stream, keeping its repeat signs, voltas, D.C. and D.S."""
+        melody = Melody.from_stream(stream)
+        return cls.from_marks(melody.notes, read_marks(stream), melody.tempo)
+
+    @property
+    def sections(self) -> list[NoteSection | Loop]:
+        """The sections, in the order they're written."""
+        return self.__sections
+
+    @property
+    def depth(self) -> int:
+        """How many loops are in progress at once at most while playing, including the song itself."""
+        def depth_of(sections: Sequence[NoteSection | Loop]) -> int:
+            return 1 + max((depth_of(s.body) for s in sections if isinstance(s, Loop)), default=0)
+        return depth_of(self.__sections)
+
+    @property
+    def size(self) -> int:
+        """The number of bytes the notes and the section table take up on the Arduino."""
+        notes, entries = self.__flatten()
+        return NOTE_SIZE * len(notes) + SECTION_SIZE * len(entries)
+
+    def expand(self) -> list[MachineNote]:
+        """Returns every note in the order it's played, exactly as SectionStream in sections.ino plays them."""
+        notes = []
+        # In 256ths of a millisecond, like the section lengths.
+        time = 0
+
+        def play(sections: Sequence[NoteSection | Loop], times: int) -> None:
+            nonlocal time
+            for current_pass in range(times):
+                for section in sections:
+                    if not section.passes >> min(current_pass, 7) & 1:
+                        continue
+                    if isinstance(section, Loop):
+                        play(section.body, section.times)
+                    else:
+                        for n in section.notes:
+                            offset_millis, offset_fraction = divmod(time + n.fixed_point_offset, 256)
+                            notes.append(MachineNote(n.frequency, offset_millis, n.duration_millis, offset_fraction))
+                        time += section.length
+
+        play(self.__sections, 1)
+        return notes
+
+    def get_cpp_string(self, variable_name: str = 'MY_MELODY') -> str:
+        """Returns the source code of the C++ definitions required to define this melody (see sections.hpp)."""
+        notes, entries = self.__flatten()
+        note_lines = [f'  {n.get_cpp_string()}' for n in notes]
+        # Every line but the last gets a comma, which has to come before the line's comment.
+        entry_lines = [f'  {code}{"," if i < len(entries) - 1 else " "}  {comment}'
+                       for i, (code, comment) in enumerate(entries)]
+        return (f'const Note {variable_name}_NOTES[] = {{\n{',\n'.join(note_lines)}\n}};\n'
+                f'const Section {variable_name}_SECTIONS[] = {{\n{'\n'.join(entry_lines)}\n}};\n'
+                f'const SectionMelody {variable_name} = {{{variable_name}_NOTES, {variable_name}_SECTIONS, '
+                f'{len(entries)}}};')
+
+    def __flatten(self) -> tuple[list[MachineNote], list[tuple[str, str]]]:
+        """Returns every note, and the C++ source and a comment for every entry of the section table."""
+        notes: list[MachineNote] = []
+        entries: list[tuple[str, str]] = []
+
+        def add(sections: Sequence[NoteSection | Loop], indent: str) -> None:
+            for section in sections:
+                passes = 'ALL_PASSES' if section.passes == ALL_PASSES else f'0x{section.passes:02X}'
+                if isinstance(section, Loop):
+                    position = len(entries)
+                    entries.append(('', ''))
+                    add(section.body, indent + '  ')
+                    # The loop's entry is filled in after its body, once the size of the body is known.
+                    entries[position] = (f'{{{len(entries) - position - 1}, 0, 0, {section.times}, {passes}}}',
+                                         f'{indent}// Loop: {section.times} times')
+                else:
+                    entries.append((f'{{{len(notes)}, {len(section.notes)}, {section.length}, 0, {passes}}}',
+                                    f'{indent}// Notes'))
+                    notes.extend(section.notes)
+
+        add(self.__sections, '')
+        if len(entries) > 0xFF:
+            raise ValueError('too many sections for a SectionMelody')
+        return notes, entries
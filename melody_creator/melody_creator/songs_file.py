@@ -0,0 +1,30 @@
+"""Reads melodies back out of C++ source files like songs.hpp."""
+
+import re
+from pathlib import Path
+
+from melody_creator.note import MachineNote
+
+# A regular expression is a pattern that matches text. This one matches a melody definition such as
+# "constexpr Melody<45> THRILLER = {{ ... }};" and captures (remembers) the name and everything between the outer
+# braces.
+# Lines that are commented out are removed before this is used, so commented-out songs are skipped.
+_MELODY_PATTERN = re.compile(r'Melody<\s*\d+\s*>\s+([A-Za-z_][A-Za-z0-9_]*)\s*=\s*\{\{(.*?)\}\};', re.DOTALL)
+# The fourth number (the fraction of a millisecond in the offset, see note.hpp) is optional.
+_NOTE_PATTERN = re.compile(r'\{\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)\s*(?:,\s*(\d+)\s*)?\}')
+_COMMENT_PATTERN = re.compile(r'//[^\n]*')
+
+
+def read_songs(path: Path) -> dict[str, list[MachineNote]]:
+    """
+    Reads every melody defined in the given C++ file (as printed by Melody.get_cpp_string()).
+    :param path: The path to the C++ file, e.g. songs.hpp.
+    :return: A dictionary from the name of each melody to its notes, sorted by offset.
+    """
+    source = _COMMENT_PATTERN.sub('', Path(path).read_text())
+    songs = {}
+    for match in _MELODY_PATTERN.finditer(source):
+        notes = [MachineNote(int(f), int(o), int(d), int(fraction or 0))
+                 for f, o, d, fraction in _NOTE_PATTERN.findall(match.group(2))]
+        songs[match.group(1)] = sorted(notes, key=lambda n: n.offset_millis)
+    return songs
@@ -1,3 +1,4 @@
+from collections.abc import Sequence
 from fractions import Fraction
 from numbers import Rational
 
@@ -47,18 +48,50 @@ class Tempo:
 
     def note_to_machine_note(self, note: Note) -> MachineNote:
         """Converts the given note in this tempo to a machine note."""
-        actual_duration_wholes = note.articulation * note.duration
-        return MachineNote(round(note.pitch.freq440),
-                           self.__wholes_to_milliseconds(note.offset),
-                           (100 + self.__wholes_to_milliseconds(actual_duration_wholes) - round(note.articulation * 100)))
+        return self.notes_to_machine_notes([note])[0]
 
-    def __wholes_to_milliseconds(self, duration: Fraction) -> int:
+    def notes_to_machine_notes(self, notes: Sequence[Note]) -> list[MachineNote]:
+        """
+        Converts the given notes in this tempo to machine notes, in the same order.
+
+        Offsets keep the fraction of a millisecond, in 256ths (see note.hpp). Durations have to be whole milliseconds,
+        since that's what tone() takes, so rounding each one on its own would make every note in a run of 83 1/3 ms
+        notes 1/3 ms short. Instead, the rounding error of each duration is carried over to the next one (this is
+        called error diffusion): the run comes out as 83, 83, 84, 83, 83, 84, ... and never drifts.
+        """
+        machine_notes = []
+        error = Fraction(0)
+        for note in notes:
+            offset_millis, offset_fraction = divmod(self.wholes_to_fixed_point(note.offset), 256)
+            exact_duration = self.wholes_to_exact_milliseconds(note.articulation * note.duration) + error
+            duration_millis = round(exact_duration)
+            error = exact_duration - duration_millis
+            machine_notes.append(MachineNote(round(note.pitch.freq440), offset_millis,
+                                             100 + duration_millis - round(note.articulation * 100), offset_fraction))
+        return machine_notes
+
+    def wholes_to_milliseconds(self, duration: Fraction) -> int:
         """
         Converts the given number of whole-lengths in this tempo to milliseconds. This rounds to the
         nearest millisecond.
         :param duration: The number of whole-lengths to convert.
         """
-        return round(duration / (self.beats_per_minute * self.subdivision) * 60_000)
+        return round(self.wholes_to_exact_milliseconds(duration))
+
+    def wholes_to_fixed_point(self, duration: Fraction) -> int:
+        """
+        Converts the given number of whole-lengths in this tempo to 256ths of a millisecond (see note.hpp), the way note
+        offsets are stored. This rounds to the nearest 256th.
+        :param duration: The number of whole-lengths to convert.
+        """
+        return round(self.wholes_to_exact_milliseconds(duration) * 256)
+
+    def wholes_to_exact_milliseconds(self, duration: Fraction) -> Fraction:
+        """
+        Converts the given number of whole-lengths in this tempo to milliseconds, without rounding.
+        :param duration: The number of whole-lengths to convert.
+        """
+        return duration / (self.beats_per_minute * self.subdivision) * 60_000
 
     # This just allows us to convert the tempo to a nice human-readable string
     def __str__(self) -> str:
@@ -0,0 +1,131 @@
+"""
+Converts melodies to TickMelody definitions for the Arduino, which are timed in ticks of a quarter note instead of
+milliseconds. See ticks.hpp for the format.
+"""
+
+from __future__ import annotations
+
+from collections.abc import Sequence
+from dataclasses import dataclass
+from fractions import Fraction
+from typing import Self, TYPE_CHECKING
+
+from melody_creator.melody import Melody
+
+# music21 is only imported where it's needed (see note.py).
+if TYPE_CHECKING:
+    import music21 as m21
+
+TICKS_PER_QUARTER = 96
+"""The number of ticks in a quarter note (TICKS_PER_QUARTER in ticks.hpp)."""
+TICKS_PER_WHOLE = 4 * TICKS_PER_QUARTER
+"""The number of ticks in a whole note. Offsets and durations in melody_creator are in whole-lengths."""
+MIN_TEMPO = 10
+"""The slowest tempo the Arduino can play, in quarter notes per minute (MIN_TICK_TEMPO in ticks.hpp)."""
+DEFAULT_TEMPO = 120
+"""The tempo before the first tempo change, in quarter notes per minute."""
+MAX_DELTA = 0xFFFF
+"""The most ticks that fit between two notes or in a duration (they're unsigned 16-bit)."""
+
+
+@dataclass(frozen=True)
+class TickNote:
+    """A note timed in ticks (TickNote in ticks.hpp)."""
+
+    frequency: int
+    """The pitch of the note, in Hertz."""
+    delta: int
+    """The number of ticks from the start of the previous note to the start of this one."""
+    duration: int
+    """The number of ticks the note sounds for."""
+
+
+@dataclass(frozen=True)
+class TempoChange:
+    """A change of tempo (TempoChange in ticks.hpp)."""
+
+    tick: int
+    """When the change happens, in ticks from the start of the song."""
+    beats_per_minute: int
+    """The new tempo, in quarter notes per minute."""
+
+
+def wholes_to_ticks(wholes: Fraction) -> int:
+    """Converts a number of whole-lengths to ticks, rounding to the nearest tick."""
+    return round(wholes * TICKS_PER_WHOLE)
+
+
+class TickMelody:
+    """A TickMelody stores notes timed in ticks and the tempo changes that say how fast the ticks go."""
+
+    def __init__(self, notes: Sequence[TickNote], tempos: Sequence[TempoChange] = ()) -> None:
+        """
+        Initializes a new TickMelody.
+        :param notes: The notes, in the order they're played.
+        :param tempos: The tempo changes, sorted by tick. Before the first one the tempo is DEFAULT_TEMPO.
+        """
+        self.__notes = list(notes)
+        self.__tempos = list(tempos)
+
+    @property
+    def notes(self) -> list[TickNote]:
+        """The notes, in the order they're played."""
+        return list(self.__notes)
+
+    @property
+    def tempos(self) -> list[TempoChange]:
+        """The tempo changes, sorted by tick."""
+        return list(self.__tempos)
+
+    @classmethod
+    def from_melody(cls, melody: Melody, tempos: Sequence[TempoChange] | None = None) -> Self:
+        """
+        Creates a TickMelody from a Melody. Offsets and durations are exact unless they are shorter than a tick (e.g.
+        quintuplet 64th notes), in which case they're rounded to the nearest tick.
+        :param melody: The melody.
+        :param tempos: The tempo changes. By default, the melody's tempo is used for the whole song.
+        """
+        if tempos is None:
+            tempos = [TempoChange(0, melody.tempo.convert_to_subdivision(Fraction(1, 4)).beats_per_minute)]
+        tick_notes = []
+        previous_tick = 0
+        for note in melody.notes:
+            tick = wholes_to_ticks(note.offset)
+            # Articulations shorten the sounding part of the note, like in Tempo.note_to_machine_note().
+            duration = max(1, wholes_to_ticks(note.articulation * note.duration))
+            if tick - previous_tick > MAX_DELTA or duration > MAX_DELTA:
+                raise ValueError(f'{note} is too far from the previous note or too long to be stored in ticks')
+            tick_notes.append(TickNote(round(note.pitch.freq440), tick - previous_tick, duration))
+            previous_tick = tick
+        return cls(tick_notes, tempos)
+
+    @classmethod
+    def from_stream(cls, stream: m21.stream.Stream) -> Self:
+        """Creates a TickMelody from a music21 stream, keeping every tempo change in the score."""
+        return cls.from_melody(Melody.from_stream(stream), get_tempo_changes(stream))
+
+    def get_cpp_string(self, variable_name: str = 'MY_MELODY') -> str:
+        """Returns the source code of the C++ definitions required to define this melody as a TickMelody."""
+        note_lines = [f'  {{{n.frequency}, {n.delta}, {n.duration}}}' for n in self.__notes]
+        tempo_lines = [f'  {{{t.tick}, {t.beats_per_minute}}}' for t in self.__tempos]
+        return (f'const TickNote {variable_name}_NOTES[] = {{\n{',\n'.join(note_lines)}\n}};\n'
+                f'const TempoChange {variable_name}_TEMPOS[] = {{\n{',\n'.join(tempo_lines)}\n}};\n'
+                f'const TickMelody {variable_name} = {{{variable_name}_NOTES, {len(self.__notes)}, '
+                f'{variable_name}_TEMPOS, {len(self.__tempos)}}};')
+
+
+def get_tempo_changes(stream: m21.stream.Stream) -> list[TempoChange]:
+    """
+    Returns every tempo change in the stream, converted to quarter notes per minute. If the stream has none, the
+    result only has the default tempo.
+    """
+    import music21 as m21
+    changes: dict[int, int] = {0: DEFAULT_TEMPO}
+    tempo_indication: m21.tempo.TempoIndication
+    for tempo_indication in stream.flatten().getElementsByClass(m21.tempo.TempoIndication):
+        metronome_mark = tempo_indication.getSoundingMetronomeMark()
+        # A tempo like "dotted quarter = 60" is the same speed as "quarter = 90".
+        beats_per_minute = round(metronome_mark.numberSounding * Fraction(metronome_mark.referent.quarterLength))
+        # Offsets are in quarter-lengths. Later marks at the same place replace earlier ones.
+        changes[wholes_to_ticks(Fraction(tempo_indication.offset) / 4)] = max(MIN_TEMPO, beats_per_minute)
+    return [TempoChange(tick, bpm) for tick, bpm in sorted(changes.items())]
@@ -0,0 +1,155 @@
+"""
+Prints tuning tables for the Arduino (see tuning.hpp): equal temperaments with any number of steps per octave, just
+intonation in any key, or any scale from a Scala file (.scl, the format most tuning software reads and writes):
+
+    python3 -m melody_creator.tuning equal 19 -n EDO_19
+    python3 -m melody_creator.tuning just -t D -n JUST_D
+    python3 -m melody_creator.tuning scala werckmeister3.scl -n WERCKMEISTER
+"""
+
+import argparse
+import math
+import sys
+from collections.abc import Sequence
+from fractions import Fraction
+from pathlib import Path
+
+TOP_OCTAVE = 8
+"""The octave the table holds the frequencies of (TUNING_TOP_OCTAVE in tuning.hpp)."""
+FRACTION_BITS = 2
+"""The table holds frequencies in quarters of a Hertz (TUNING_FRACTION_BITS in tuning.hpp)."""
+LOWEST_OCTAVE = 0
+"""The lowest octave the table is checked against. Lower notes are below what the buzzer can play anyway."""
+
+JUST_RATIOS = [Fraction(1), Fraction(16, 15), Fraction(9, 8), Fraction(6, 5), Fraction(5, 4), Fraction(4, 3),
+               Fraction(45, 32), Fraction(3, 2), Fraction(8, 5), Fraction(5, 3), Fraction(9, 5), Fraction(15, 8)]
+"""The ratio of each note of a 5-limit just intonation scale to its tonic (JUST_INTONATION in tuning.hpp)."""
+
+PITCH_CLASSES = {'C': 0, 'D': 2, 'E': 4, 'F': 5, 'G': 7, 'A': 9, 'B': 11}
+"""The pitch classes of the natural notes, which a tonic like 'F#' or 'Bb' adds to."""
+
+
+def equal_cents(size: int) -> list[float]:
+    """Returns the steps of an equal temperament with the given number of steps per octave, in cents above the first."""
+    return [1200 * step / size for step in range(size)]
+
+
+def ratio_cents(ratios: Sequence[Fraction]) -> list[float]:
+    """Returns the given frequency ratios (to the first step) in cents."""
+    return [1200 * math.log2(ratio) for ratio in ratios]
+
+
+def read_scala(text: str) -> list[float]:
+    """
+    Returns the steps of a scale in a Scala file, in cents above its first step. Lines starting with '!' are comments.
+    The first other line describes the scale and the second is how many notes it has. Each note after that is cents if
+    it has a '.' in it and a ratio (like 5/4 or 2) otherwise. The first step (0 cents) is left out of the file, and the
+    last note is where the scale repeats, which has to be an octave.
+    """
+    lines = [line.strip() for line in text.splitlines() if not line.strip().startswith('!')]
+    if len(lines) < 2:
+        raise ValueError('a Scala file needs a description and a number of notes')
+    try:
+        count = int(lines[1].split()[0])
+        values = [line.split()[0] for line in lines[2:2 + count] if line]
+        cents = [float(value) if '.' in value else 1200 * math.log2(Fraction(value)) for value in values]
+    except (ValueError, IndexError, ZeroDivisionError):
+        raise ValueError('the notes of a Scala file must be cents (with a .) or ratios')
+    if len(cents) != count or count == 0:
+        raise ValueError(f'the Scala file says it has {count} notes but has {len(cents)}')
+    if abs(cents[-1] - 1200) > 1e-6:
+        raise ValueError('the scale must repeat every octave (its last note must be 2/1 or 1200.0)')
+    steps = [0.0] + cents[:-1]
+    if steps != sorted(steps) or len(set(steps)) != len(steps):
+        raise ValueError('the notes of the scale must go up, between 0 and 1200 cents')
+    if len(steps) > 254:
+        raise ValueError('a tuning can have at most 254 steps per octave')
+    return steps
+
+
+def parse_tonic(tonic: str, size: int) -> int:
+    """Returns the step of a tonic, given as a note name (like 'F#', only for 12 steps per octave) or a number."""
+    if tonic.lstrip('-').isdigit():
+        return int(tonic) % size
+    if size != 12 or tonic[0].upper() not in PITCH_CLASSES:
+        raise ValueError(f'{tonic} is not a step number' + ('' if size != 12 else ' or a note name'))
+    return (PITCH_CLASSES[tonic[0].upper()] + tonic[1:].count('#') - tonic[1:].count('b')) % 12
+
+
+def table_frequencies(cents: Sequence[float], tonic: int = 0, a4: float = 440.0) -> list[float]:
+    """
+    Returns the exact frequencies of the steps of the top octave, from C upwards. The tonic is the step the scale starts
+    on. Where it is is taken from the equal temperament with the same number of steps, with A4 at the given frequency.
+    """
+    size = len(cents)
+    c_top = a4 * 2 ** (TOP_OCTAVE - 4 - 9 / 12)
+    tonic_frequency = c_top * 2 ** (tonic / size)
+    # The steps below the tonic come from the scale of the octave below, so every frequency is in the top octave.
+    return [tonic_frequency * 2 ** (cents[(step - tonic) % size] / 1200 - (1 if step < tonic else 0))
+            for step in range(size)]
+
+
+def table_entry(frequency: float) -> int:
+    """
+    Returns the table entry of a frequency in the top octave. The Arduino divides the entry by a power of 2 for each
+    octave and rounds, so of the two entries closest to the frequency, this picks the one that rounds to the nearest
+    Hertz in the most octaves: rounding twice is sometimes off by 1 Hz otherwise.
+    """
+    exact = frequency * (1 << FRACTION_BITS)
+
+    def misses(entry: int) -> int:
+        count = 0
+        for octave in range(LOWEST_OCTAVE, TOP_OCTAVE + 1):
+            shift = TOP_OCTAVE - octave + FRACTION_BITS
+            count += (entry + (1 << (shift - 1))) >> shift != round(frequency / 2 ** (TOP_OCTAVE - octave))
+        return count
+
+    return min(math.floor(exact), math.ceil(exact), key=lambda entry: (misses(entry), abs(entry - exact)))
+
+
+def get_cpp_string(cents: Sequence[float], name: str, tonic: int = 0, a4: float = 440.0) -> str:
+    """Returns the C++ of a tuning table and the Tuning that uses it."""
+    entries = [table_entry(frequency) for frequency in table_frequencies(cents, tonic, a4)]
+    lines = [f'const uint16_t {name}_STEPS[{len(entries)}] = {{']
+    for start in range(0, len(entries), 12):
+        lines.append('  ' + ', '.join(str(entry) for entry in entries[start:start + 12]) + ',')
+    lines.append('};')
+    lines.append(f'const Tuning {name} = {{{name}_STEPS, {len(entries)}}};')
+    return '\n'.join(lines)
+
+
+def main() -> None:
+    """Prints a tuning table."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.tuning',
+                                     description='Print a tuning table for the Arduino (see tuning.hpp).')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+    equal_parser = subparsers.add_parser('equal', help='An equal temperament.')
+    equal_parser.add_argument('size', type=int, help='The number of steps per octave (12 is the usual one).')
+    just_parser = subparsers.add_parser('just', help='5-limit just intonation, 12 steps per octave.')
+    scala_parser = subparsers.add_parser('scala', help='The scale in a Scala (.scl) file.')
+    scala_parser.add_argument('path', type=Path, help='The Scala file.')
+    for subparser in (equal_parser, just_parser, scala_parser):
+        subparser.add_argument('-t', '--tonic', type=str, default='0',
+                               help='The note the scale starts on: a name like Eb, or a step number (default C).')
+        subparser.add_argument('-a', '--a4', type=float, default=440.0,
+                               help='The frequency of A4 in the equal temperament the tonic is taken from (default 440).')
+        subparser.add_argument('-n', '--name', dest='var_name', type=str, default='MY_TUNING',
+                               help='The name of the C++ variable.')
+    namespace = parser.parse_args()
+
+    try:
+        if namespace.command == 'equal':
+            if not 1 <= namespace.size <= 254:
+                raise ValueError('an equal temperament can have 1 to 254 steps per octave')
+            cents = equal_cents(namespace.size)
+        elif namespace.command == 'just':
+            cents = ratio_cents(JUST_RATIOS)
+        else:
+            cents = read_scala(namespace.path.read_text())
+        print(get_cpp_string(cents, namespace.var_name, parse_tonic(namespace.tonic, len(cents)), namespace.a4))
+    except (OSError, ValueError) as e:
+        sys.exit(f'ERROR: {e}')
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,282 @@
+"""
+Uploads melodies to an Arduino running a MelodyReceiver (see receiver.hpp) over a serial connection.
+
+The protocol is described at the top of receiver.hpp. This module is the computer's side of it, plus a loopback check
+that uploads to the Arduino's side (receiver.ino) running on this computer (see host/receiver_host.cpp):
+
+    python3 -m melody_creator.upload --loopback songs.hpp
+"""
+
+import argparse
+import re
+import struct
+import subprocess
+import sys
+import threading
+import time
+from collections.abc import Sequence
+from pathlib import Path
+
+import serial
+
+from melody_creator.note import MachineNote
+from melody_creator.songs_file import read_songs
+
+SYNC = 0x7E
+BEGIN = 0x01
+NOTES = 0x02
+END = 0x03
+ACK = 0x81
+NAK = 0x82
+
+MAX_NOTES_PER_FRAME = 8
+"""The largest number of notes in a NOTES frame. Must match UPLOAD_MAX_NOTES in receiver.hpp."""
+
+BAUD_RATE = 9600
+
+
+def fletcher16(data: bytes) -> tuple[int, int]:
+    """Returns the two sums of the Fletcher-16 checksum of the given bytes."""
+    sum1 = sum2 = 0
+    for byte in data:
+        sum1 = (sum1 + byte) % 255
+        sum2 = (sum2 + sum1) % 255
+    return sum1, sum2
+
+
+def encode_frame(frame_type: int, payload: bytes) -> bytes:
+    """Returns the bytes of a complete frame with the given type and payload."""
+    body = bytes([frame_type, len(payload)]) + payload
+    return bytes([SYNC]) + body + bytes(fletcher16(body))
+
+
+def encode_notes(notes: Sequence[MachineNote]) -> bytes:
+    """Packs notes into the 8-byte little-endian records used by NOTES frames."""
+    # "<HIH" means little-endian (<), then an unsigned 16-bit, an unsigned 32-bit, and another unsigned 16-bit integer.
+    return b''.join(struct.pack('<HIH', n.frequency, n.offset_millis, n.duration_millis) for n in notes)
+
+
+class FrameReader:
+    """Collects received bytes and splits them into frames, skipping any that are garbled."""
+
+    def __init__(self) -> None:
+        self.__buffer = bytearray()
+
+    def feed(self, data: bytes) -> list[tuple[int, bytes]]:
+        """
+        Adds received bytes.
+        :return: The (type, payload) of every complete frame with a valid checksum.
+        """
+        self.__buffer += data
+        frames = []
+        while True:
+            # Throw away everything before the next sync byte.
+            start = self.__buffer.find(SYNC)
+            if start < 0:
+                self.__buffer.clear()
+                return frames
+            del self.__buffer[:start]
+            if len(self.__buffer) < 3 or len(self.__buffer) < 5 + self.__buffer[2]:
+                return frames  # The rest of the frame hasn't arrived yet.
+            length = self.__buffer[2]
+            body = bytes(self.__buffer[1:3 + length])
+            checksum = tuple(self.__buffer[3 + length:5 + length])
+            if checksum == fletcher16(body):
+                frames.append((body[0], body[2:]))
+                del self.__buffer[:5 + length]
+            else:
+                # Skip this sync byte; the real start of a frame may be inside what we thought was this one.
+                del self.__buffer[:1]
+
+
+class UploadError(Exception):
+    """Raised when the Arduino stops responding during an upload."""
+
+
+def upload(port: serial.Serial, notes: Sequence[MachineNote], timeout: float = 0.5, retries: int = 10,
+           log=None) -> None:
+    """
+    Uploads a melody and returns once the Arduino has accepted every note. The Arduino starts playing after the first
+    few notes arrive.
+    :param port: An open serial port connected to the Arduino.
+    :param notes: The notes of the melody, which will be sent sorted by offset.
+    :param timeout: How long to wait for an answer to a frame before sending it again, in seconds.
+    :param retries: How many times to send a frame (or to ask for room while waiting for it) before giving up.
+    :param log: If given, a function called with a message about every retry and pause.
+    """
+    notes = sorted(notes, key=lambda n: n.offset_millis)
+    for note in notes:
+        if not (0 <= note.frequency < 1 << 16 and 0 <= note.duration_millis < 1 << 16):
+            raise ValueError(f'{note} does not fit in a NOTES frame')
+    reader = FrameReader()
+    sequence = 0
+    space = 0
+    last_frame = b''
+
+    def send(frame_type: int, payload: bytes) -> None:
+        """Sends a frame until it's acknowledged. Updates the space the Arduino has reported."""
+        nonlocal space, last_frame
+        frame = encode_frame(frame_type, bytes([sequence]) + payload)
+        last_frame = frame
+        for attempt in range(retries):
+            port.write(frame)
+            deadline = time.monotonic() + timeout
+            while time.monotonic() < deadline:
+                for reply_type, reply in reader.feed(port.read(max(1, port.in_waiting))):
+                    if len(reply) != 2 or reply[0] != sequence:
+                        continue  # An answer to an earlier frame.
+                    space = reply[1]
+                    if reply_type == ACK:
+                        return
+                    if reply_type == NAK:
+                        deadline = 0  # Send again straight away.
+                        break
+            if log is not None:
+                log(f'retrying frame {sequence} (attempt {attempt + 2})')
+        raise UploadError(f'no acknowledgement for frame {sequence} after {retries} attempts')
+
+    def wait_for_space(needed: int) -> None:
+        """Waits until the Arduino reports room for the given number of notes."""
+        nonlocal space
+        attempt = 0
+        while True:
+            deadline = time.monotonic() + timeout
+            answered = False
+            while time.monotonic() < deadline:
+                for reply_type, reply in reader.feed(port.read(max(1, port.in_waiting))):
+                    if reply_type == ACK and len(reply) == 2 and reply[0] == sequence:
+                        space = reply[1]
+                        answered = True
+                if space >= needed:
+                    return
+            # Making room can take a while if the notes are long, but the extra ACK might also have been lost, or the
+            # Arduino might have been reset. Sending the last frame again asks it how much room it has: it recognizes
+            # the sequence number, doesn't use the frame twice, and ACKs it again. Only unanswered questions count as
+            # failed attempts, so a slow song doesn't run out of them. A reset Arduino NAKs the frame instead.
+            if answered:
+                attempt = 0
+            else:
+                attempt += 1
+                if attempt == retries:
+                    raise UploadError(f'no room reported after frame {sequence} in {retries} attempts')
+                if log is not None:
+                    log(f'asking the Arduino for room again (attempt {attempt + 1})')
+            port.write(last_frame)
+
+    send(BEGIN, b'')
+    sent = 0
+    while sent < len(notes):
+        # Flow control: never send more notes than the Arduino said it has room for. If there's no room, wait for the
+        # extra ACK it sends once a full frame fits again (see wait_for_space()).
+        if space < min(MAX_NOTES_PER_FRAME, len(notes) - sent) and log is not None:
+            log(f'waiting for the Arduino to make room ({sent}/{len(notes)} notes sent)')
+        wait_for_space(min(MAX_NOTES_PER_FRAME, len(notes) - sent))
+        count = min(MAX_NOTES_PER_FRAME, space, len(notes) - sent)
+        sequence = (sequence + 1) % 256
+        send(NOTES, encode_notes(notes[sent:sent + count]))
+        sent += count
+    sequence = (sequence + 1) % 256
+    send(END, b'')
+
+
+HOST_PROGRAM = Path(__file__).resolve().parents[2] / 'host' / 'receiver_host'
+"""The program that runs receiver.ino on a computer, built from host/receiver_host.cpp."""
+
+TONE_PATTERN = re.compile(r'(\d+) us: tone\(pin \d+, (\d+) Hz, (\d+) ms\)')
+"""Matches the lines arduino_host.hpp prints for tone() calls."""
+
+
+def loopback_check(notes: Sequence[MachineNote], program: Path = HOST_PROGRAM, speed: int = 20) -> bool:
+    """
+    Uploads notes to the real receiver code (receiver.ino) running on this computer through a pseudo-terminal (a pair
+    of connected fake serial ports, Linux/macOS only), and checks that every note is played intact and in order.
+    :param program: host/receiver_host.cpp, built (see the top of that file).
+    :param speed: How many times faster than normal the song plays, so the check doesn't take as long as the song.
+    :return: True if the check passed.
+    """
+    if not program.exists():
+        print(f'ERROR: {program} not found. Build host/receiver_host.cpp first (see the top of that file).',
+              file=sys.stderr)
+        return False
+    # The program prints the name of its pseudo-terminal, then a line for every tone() and noTone() call as it plays.
+    # Its output is read by a thread, so that the notes are collected while the upload is still going.
+    process = subprocess.Popen([str(program), str(speed)], stdout=subprocess.PIPE, text=True)
+    port_name = process.stdout.readline().split()[-1]
+    played: list[tuple[int, int, int]] = []
+    summary = []
+
+    def read_output() -> None:
+        for line in process.stdout:
+            match = TONE_PATTERN.match(line)
+            if match:
+                played.append(tuple(int(group) for group in match.groups()))
+            elif 'frames rejected' in line:
+                summary.append(line.strip())
+
+    thread = threading.Thread(target=read_output)
+    thread.start()
+    started = time.monotonic()
+    try:
+        with serial.Serial(port_name, BAUD_RATE, timeout=0.01) as port:
+            upload(port, notes, log=lambda message: print(message, file=sys.stderr))
+        uploaded = time.monotonic()
+        process.wait(timeout=60 + sum(n.duration_millis for n in notes) / 1000 / speed)
+    finally:
+        if process.poll() is None:
+            process.kill()
+        thread.join()
+
+    expected = sorted(notes, key=lambda n: n.offset_millis)
+    passed = process.returncode == 0 and [(frequency, duration) for _, frequency, duration in played] == [
+        (n.frequency, n.duration_millis) for n in expected]
+    print(f'{len(played)}/{len(expected)} notes played in order: {"PASS" if passed else "FAIL"}')
+    if played and len(played) == len(expected):
+        # The receiver printed real times, so they're sped up to compare them with the offsets. Waiting on the
+        # computer's scheduler makes them a little late, so this is reported rather than checked.
+        first_time = played[0][0]
+        error = max(abs((time_micros - first_time) * speed / 1000 - (n.offset_millis - expected[0].offset_millis))
+                    for (time_micros, _, _), n in zip(played, expected))
+        print(f'notes started at most {error:.1f} ms from their offsets')
+    print(f'upload finished after {1000 * (uploaded - started):.1f} ms')
+    for line in summary:
+        print(line)
+    return passed
+
+
+def upload_to_port(port_name: str, notes: Sequence[MachineNote]) -> None:
+    """Opens the serial port with the given name, waits for the Arduino to start up, and uploads the notes to it."""
+    with serial.Serial(port_name, BAUD_RATE, timeout=0.01) as port:
+        # Opening the port resets most Arduinos, so give it time to start up.
+        time.sleep(2)
+        upload(port, notes, log=lambda message: print(message, file=sys.stderr))
+
+
+def main() -> None:
+    """Uploads a melody from a C++ file such as songs.hpp, or runs the loopback check."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.upload',
+                                     description='Upload a melody to an Arduino running a MelodyReceiver.')
+    parser.add_argument('songs_path', type=Path, help='Path to a C++ file with melody definitions, e.g. songs.hpp.')
+    parser.add_argument('-n', '--name', dest='var_name', type=str,
+                        help='The name of the melody to upload. Defaults to the first one in the file.')
+    parser.add_argument('-p', '--port', type=str, help='The serial port of the Arduino, e.g. /dev/ttyACM0.')
+    parser.add_argument('--loopback', action='store_true', default=False,
+                        help='Instead of uploading to an Arduino, upload to receiver.ino running on this computer '
+                             '(host/receiver_host.cpp, built) over a pseudo-terminal and check that every note plays.')
+    namespace = parser.parse_args()
+
+    songs = read_songs(namespace.songs_path)
+    if not songs:
+        sys.exit(f'ERROR: no melodies found in {namespace.songs_path}')
+    name = namespace.var_name or next(iter(songs))
+    if name not in songs:
+        sys.exit(f'ERROR: no melody called {name} in {namespace.songs_path}')
+
+    if namespace.loopback:
+        sys.exit(0 if loopback_check(songs[name]) else 1)
+    if namespace.port is None:
+        sys.exit('ERROR: either --port or --loopback is required')
+    upload_to_port(namespace.port, songs[name])
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,174 @@
+"""
+Splits a melody with overlapping notes (chords, or several parts) into voices that each play one note at a time, so
+that every voice can be played by its own MelodyPlayer, or a few voices by a PriorityPlayer or an arpeggiating
+MelodyPlayer (see player.hpp). Print the voices of a song with a report of how the notes were split with:
+
+    python3 -m melody_creator.voices song.mid
+"""
+
+import argparse
+import bisect
+import heapq
+import itertools
+import math
+import sys
+import time
+from collections.abc import Sequence
+from fractions import Fraction
+from pathlib import Path
+
+from melody_creator.melody import Melody
+from melody_creator.midi import MidiError, read_midi
+from melody_creator.note import Note, MachineNote
+
+
+def _pitch(note: Note) -> float:
+    """Returns the pitch of the note in semitones above A4, which (unlike Hertz) measures how far apart notes sound."""
+    return 12 * math.log2(note.pitch.freq440 / 440)
+
+
+def _sounding_end(note: Note) -> Fraction:
+    """Returns when the note stops sounding (which its articulation can make earlier than written), in whole-lengths."""
+    return note.offset + note.duration * note.articulation
+
+
+def _best_window(short: Sequence[float], long: Sequence[float]) -> int:
+    """
+    Returns where to line up the sorted pitches of short against the sorted pitches of long (which has at least as many)
+    so that they're as close as possible: the i-th of short is matched with the (result + i)-th of long.
+    """
+    return min(range(len(long) - len(short) + 1),
+               key=lambda first: sum(abs(pitch - long[first + i]) for i, pitch in enumerate(short)))
+
+
+def allocate_voices(notes: Sequence[Note], max_voices: int = 0) -> tuple[list[list[Note]], int]:
+    """
+    Splits the notes into voices whose notes never overlap, using as few voices as possible. Returns the voices, highest
+    first, and how many notes were left out because all max_voices voices were busy.
+    :param notes: The notes to split, in any order.
+    :param max_voices: The most voices to use, or 0 for as many as it takes (optional).
+    """
+    # This is the greedy way to color an interval graph: going through the notes in order of when they start, each one
+    # goes into a voice that's free by then, and a new voice is only made when none is. That never uses more voices
+    # than the most notes that sound at once, which is the fewest possible.
+    # To keep melodic lines together, notes go into the free voices whose last notes are closest in pitch, so a bass
+    # line stays in one voice and a tune in another. The notes that start together (a chord) are matched with free
+    # voices in order of pitch, lowest with lowest, so voices never cross.
+    # Sorting takes O(n log n). Busy voices are kept in a heap by when they're free again (see priority_player.hpp for
+    # how heaps work), and free voices in a list sorted by pitch, so each note takes O(log v) steps for v voices, plus
+    # matching chords, which takes about v steps per note. v is only as big as the biggest chord, so even orchestral
+    # scores with tens of thousands of notes are split in a fraction of a second.
+    # Times are the exact ones in the score rather than milliseconds, so rounding can't make two notes of the same line
+    # overlap by a fraction of a millisecond.
+    voices: list[list[Note]] = []
+    # (end, voice index) of every voice that's playing a note.
+    busy: list[tuple[Fraction, int]] = []
+    # (pitch of the last note, voice index) of every voice that's free, sorted.
+    free: list[tuple[float, int]] = []
+    dropped = 0
+    for offset, group in itertools.groupby(sorted(notes, key=lambda n: (n.offset, _pitch(n))), key=lambda n: n.offset):
+        chord = list(group)
+        # A voice is free again once its note has ended, including a note that ends exactly when this one starts.
+        while busy and busy[0][0] <= offset:
+            _, voice = heapq.heappop(busy)
+            bisect.insort(free, (_pitch(voices[voice][-1]), voice))
+        # If there aren't enough voices left for the whole chord, its inner notes are left out first, since the highest
+        # (usually the tune) and the lowest (the bass) matter most.
+        room = len(free) + max_voices - len(voices) if max_voices > 0 else len(chord)
+        if len(chord) > room:
+            dropped += len(chord) - room
+            chord = [] if room == 0 else chord[-1:] if room == 1 else chord[:1] + chord[len(chord) - room + 1:]
+        pitches = [_pitch(note) for note in chord]
+        free_pitches = [pitch for pitch, _ in free]
+        if len(free) >= len(chord):
+            first = _best_window(pitches, free_pitches)
+            matched = list(zip(chord, (voice for _, voice in free[first:first + len(chord)])))
+            unmatched = []
+            del free[first:first + len(chord)]
+        else:
+            first = _best_window(free_pitches, pitches)
+            matched = list(zip(chord[first:first + len(free)], (voice for _, voice in free)))
+            unmatched = chord[:first] + chord[first + len(free):]
+            free.clear()
+        for note in unmatched:
+            matched.append((note, len(voices)))
+            voices.append([])
+        for note, voice in matched:
+            voices[voice].append(note)
+            heapq.heappush(busy, (_sounding_end(note), voice))
+    # Voices are made in the order their first notes start, so they're sorted to put the tune (usually the highest
+    # part) first and the bass last.
+    voices.sort(key=lambda v: -sum(_pitch(n) for n in v) / len(v))
+    return voices, dropped
+
+
+def get_cpp_string(voices: Sequence[Melody], variable_name: str = 'MY_MELODY') -> str:
+    """
+    Returns the source code of the C++ definitions of every voice as its own Melody, named variable_name followed by the
+    number of the voice (MY_MELODY_1 is the highest).
+    """
+    return '\n'.join(voice.get_cpp_string(f'{variable_name}_{number}') for number, voice in enumerate(voices, 1))
+
+
+def get_timeline_cpp_string(voices: Sequence[Melody], variable_name: str = 'MY_MELODY') -> str:
+    """
+    Returns the source code of the C++ definitions of the voices interleaved into a single Melody, along with an array
+    holding the voice of each note (starting at 0), named variable_name followed by _VOICES.
+    """
+    # Each voice is turned into milliseconds on its own (see Tempo.notes_to_machine_notes()), so its notes come out
+    # exactly as they would in its own Melody. Notes that start together keep the order of their voices, since Python's
+    # sort is stable.
+    timeline: list[tuple[MachineNote, int]] = sorted(
+        ((mnote, number) for number, voice in enumerate(voices) for mnote in voice.get_machine_notes()),
+        key=lambda item: item[0].exact_offset_millis)
+    notes = ',\n'.join(f'  {mnote.get_cpp_string()}' for mnote, _ in timeline)
+    numbers = [str(number) for _, number in timeline]
+    lines = [', '.join(numbers[i:i + 32]) for i in range(0, len(numbers), 32)]
+    return (f'constexpr Melody<{len(timeline)}> {variable_name} = {{{{\n{notes}\n}}}};\n'
+            f'// The voice of each note of {variable_name}, in the same order.\n'
+            f'const uint8_t {variable_name}_VOICES[] = {{\n  {',\n  '.join(lines)}\n}};')
+
+
+def split_melody(melody: Melody, max_voices: int = 0) -> tuple[list[Melody], int]:
+    """Splits the melody into voices (see allocate_voices()) at its tempo."""
+    voices, dropped = allocate_voices(melody.notes, max_voices)
+    return [Melody(voice, melody.tempo) for voice in voices], dropped
+
+
+def main() -> None:
+    """Prints the voices of a MIDI file, with a report of how its notes were split."""
+    parser = argparse.ArgumentParser(prog='python3 -m melody_creator.voices',
+                                     description='Split a MIDI file into voices that each play one note at a time.')
+    parser.add_argument('midi_path', type=Path, help='MIDI file to split.')
+    parser.add_argument('-n', '--name', dest='var_name', type=str, default='MY_MELODY',
+                        help='The name of the printed variables. Must be a valid C++ variable name.')
+    parser.add_argument('-v', '--voices', dest='max_voices', type=int, default=0,
+                        help='The most voices to use (default 0, as many as it takes).')
+    parser.add_argument('-i', '--interleave', action='store_true', default=False,
+                        help='Print the voices as one Melody with the voice of each note, instead of one Melody each.')
+    namespace = parser.parse_args()
+
+    try:
+        song = read_midi(namespace.midi_path)
+    except (MidiError, IndexError) as e:
+        sys.exit(f'ERROR: {namespace.midi_path} could not be read: {e or "it ends too early"}')
+    start = time.perf_counter()
+    voices, dropped = split_melody(song.melody, namespace.max_voices)
+    elapsed = time.perf_counter() - start
+    if namespace.interleave:
+        print(get_timeline_cpp_string(voices, namespace.var_name))
+    else:
+        print(get_cpp_string(voices, namespace.var_name))
+
+    # The report goes to stderr so that the C++ can be redirected into a file on its own.
+    print(f'{len(song.notes)} notes split into {len(voices)} voices in {elapsed * 1000:.1f} ms, {dropped} left out',
+          file=sys.stderr)
+    print(f'{"Voice":>6} {"Notes":>6} {"Lowest":>7} {"Highest":>8}', file=sys.stderr)
+    for number, voice in enumerate(voices, 1):
+        frequencies = [mnote.frequency for mnote in voice.get_machine_notes()]
+        print(f'{number:>6} {voice.number_of_notes:>6} {min(frequencies):>5}Hz {max(frequencies):>6}Hz',
+              file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
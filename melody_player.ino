@@ -2,13 +2,70 @@
 // compilation. This particular one, #include, will insert the contents of the header file on the right into
 // the location of the #include directive.
 #include "melody.hpp"
+#include "player.hpp"
+#include "scheduler.hpp"
 #include "songs.hpp"
 
 // Indicates the pin on the Arduino to which the buzzer is connected.
 const int BUZZER_PIN = 8;
 
-// Ensures the melody plays only once
-bool shouldPlayMelody = true;
+// Indicates the pins of the LED that lights up while a note plays and the LED that toggles on every beat.
+const int NOTE_LED_PIN = 7;
+const int BEAT_LED_PIN = 6;
+
+// The length of a beat of THRILLER in milliseconds, and how long (in microseconds) each LED callback may take.
+const unsigned long BEAT_LENGTH = 500;
+const unsigned long LED_CALLBACK_BUDGET = 100;
+
+// How late (in microseconds) the melody task may run before notes could be heard starting late.
+const unsigned long MELODY_LATENCY_LIMIT = 1000;
+
+// Indicates the analog pin from which sensor readings are taken.
+const int SENSOR_PIN = A0;
+
+// How often (in microseconds) the LED is toggled and the sensor is read.
+const unsigned long LED_PERIOD = 250000UL;
+const unsigned long SENSOR_PERIOD = 20000UL;
+
+// The player plays the melody one note at a time, and the scheduler decides when each of our three tasks gets to run.
+// See player.hpp and scheduler.hpp for how they work.
+MelodyPlayer<> player(BUZZER_PIN);
+Scheduler<3> scheduler;
+uint8_t melodyTask;
+
+// The most recent sensor reading.
+int sensorValue = 0;
+
+// Ensures the task report is printed only once
+bool shouldPrintReport = true;
+
+// These two functions are tasks. Each one does a tiny bit of work and then says when it wants to run next. They don't
+// need a context, so they ignore the first argument (which is why it has no name).
+/// Toggles the built-in LED.
+bool blinkLed(void*, unsigned long now, unsigned long& nextRun) {
+  digitalWrite(LED_BUILTIN, digitalRead(LED_BUILTIN) == HIGH ? LOW : HIGH);
+  nextRun = now + LED_PERIOD;
+  return true;
+}
+
+/// Reads the sensor.
+bool pollSensor(void*, unsigned long now, unsigned long& nextRun) {
+  sensorValue = analogRead(SENSOR_PIN);
+  nextRun = now + SENSOR_PERIOD;
+  return true;
+}
+
+// These two functions are callbacks, called by the player when something happens in the music (see events.hpp).
+/// Lights the note LED while a note is playing.
+void lightNote(const NoteEvent& event, void*) {
+  digitalWrite(NOTE_LED_PIN, event.type == NOTE_ON ? HIGH : LOW);
+}
+
+/// Toggles the beat LED on every beat.
+void toggleBeat(const NoteEvent& event, void*) {
+  // The % 2 makes the LED turn on for even beats and off for odd ones.
+  digitalWrite(BEAT_LED_PIN, event.beat % 2 == 0 ? HIGH : LOW);
+}
 
 void setup() {
   // Where was Serial.begin #included from, you may ask? The answer is the header file declaring it is automatically
@@ -16,15 +73,37 @@ void setup() {
   // Serial allows a device connected to the USB port to communicate with the Arduino. Serial.begin() opens that
   // connection and sets the number of bits per second (baud) data will be sent. 9600 baud is usually good.
   Serial.begin(9600);
+  pinMode(LED_BUILTIN, OUTPUT);
+  pinMode(NOTE_LED_PIN, OUTPUT);
+  pinMode(BEAT_LED_PIN, OUTPUT);
+
+  player.setBeatLength(BEAT_LENGTH);
+  player.addCallback(lightNote, nullptr, NOTE_ON_MASK | NOTE_OFF_MASK, LED_CALLBACK_BUDGET);
+  player.addCallback(toggleBeat, nullptr, BEAT_MASK, LED_CALLBACK_BUDGET);
+
+  unsigned long now = micros();
+  // The player was #included from player.hpp. It plays THRILLER once, starting now.
+  player.start(THRILLER, now);
+  // The & in front of player gets its address (a pointer to it), which the scheduler passes back to
+  // MelodyPlayer<>::task every time the melody task runs.
+  melodyTask = scheduler.addTask("melody", MelodyPlayer<>::task, &player, now);
+  scheduler.addTask("led", blinkLed, nullptr, now);
+  scheduler.addTask("sensor", pollSensor, nullptr, now);
 }
 
 void loop() {
-  if (shouldPlayMelody) { // If we haven't played the melody yet...
-    // The playMelody function was #included from melody.hpp. If the implementation is changed down the road, we don't
-    // need to do anything in this file unless the signature changed.
-    playMelody(BUZZER_PIN, THRILLER);  // ...play it...
-    // 
-    shouldPlayMelody = false;  // ...and then indicate we've already played it.
-    
+  // Instead of playing the whole melody at once, loop() now just asks the scheduler to run whichever task is due.
+  // Because loop() is called over and over again, every task gets its turn.
+  scheduler.runNext();
+
+  if (shouldPrintReport && !player.isPlaying()) { // Once the melody is over...
+    // ...print how late each task ran and how often each callback overran its budget. If the melody task's worst
+    // latency is small (well under a millisecond), the other tasks aren't disturbing the music...
+    scheduler.printReport();
+    player.callbacks().printReport();
+    Serial.print("Melody task worst latency: ");
+    Serial.print(scheduler.worstLatency(melodyTask));
+    Serial.println(scheduler.worstLatency(melodyTask) < MELODY_LATENCY_LIMIT ? " us (fine)" : " us (notes may be late)");
+    shouldPrintReport = false;  // ...and then indicate we've already printed it.
   }
 }
@@ -0,0 +1,148 @@
+/// Defines pitch modulation (glides, bends, vibrato, and ornaments) for notes played by an EnvelopePlayer.
+
+// See note.hpp for an explanation of header guards.
+#ifndef MODULATION_HPP
+#define MODULATION_HPP
+
+// A PwmBuzzer (see envelope.hpp) sets its pitch by how far Timer1 counts for each wave, its "period". Changing the
+// period while a note plays bends the pitch without starting the note over, which is what a Modulator does on every
+// tick of the envelope interrupt:
+//
+// * A glide (or portamento) slides from the pitch of one note to the next instead of jumping, the way a singer or a
+//   violinist plays the notes of a slur.
+// * A bend slides into the note from a semitone below (a scoop) or above (a plop).
+// * Vibrato wobbles the pitch up and down a few times per second around the note, once it's been held for a moment.
+// * An ornament (a trill, a mordent, a turn, or a grace note) plays a few quick neighboring notes as part of the note.
+//
+// Which of these a note gets is up to its expression, one byte per note in an array next to the melody, like the
+// velocities (melody_creator prints it with -e). The bottom four bits are flags, one bit each, so a note can have any
+// of them at once. The top four bits are the number of an ornament in ORNAMENTS, so a trill that lasts four bars takes
+// one byte instead of dozens of notes: the modulator plays its notes by changing the pitch while the note plays.
+//
+// Everything is worked out in periods rather than frequencies, since a period is what the timer needs: finding the
+// period of a frequency takes a division, which is slow on an Arduino (it has no instruction for it), so it's only done
+// once per note. Each tick then only adds a step to the period, like an envelope does to the volume, and looks the
+// vibrato up in a small table of sine values instead of working the sine out.
+
+/// The note slides from the pitch of the note before it, if that one is still held. It doesn't start a new attack.
+const uint8_t EXPRESSION_GLIDE = 0x01;
+/// The pitch of the note wobbles up and down once it's been held for Modulation::vibratoDelay.
+const uint8_t EXPRESSION_VIBRATO = 0x02;
+/// The note starts a semitone low and slides up to its pitch.
+const uint8_t EXPRESSION_SCOOP = 0x04;
+/// The note starts a semitone high and slides down to its pitch.
+const uint8_t EXPRESSION_PLOP = 0x08;
+/// The bits of an expression that hold its ornament. Shifting the expression right by 4 gives the ornament's number.
+const uint8_t EXPRESSION_ORNAMENT = 0xF0;
+
+/// The notes of an ornament, which are played quickly at the start of a note before the note itself.
+struct Ornament {
+  /// How far each note is from the note itself, in semitones (0 is the note itself).
+  int8_t steps[3];
+  /// How many of the steps are used.
+  uint8_t length;
+  /// Whether the steps repeat until the note ends, like a trill, instead of being played once.
+  bool repeats;
+};
+
+// These are the ornaments that fit in an expression. Which neighbors an ornament uses depends on the key, so there's
+// one for each interval that comes up in major and minor keys. melody_creator (see expressions.py) has a copy of this
+// table, and plays ornaments that aren't in it as ordinary notes. A trill with the note a semitone above is number 1,
+// so its expression is 0x10.
+/// The ornaments of expressions, by number.
+const Ornament ORNAMENTS[16] = {
+  {{0}, 0, false},         // 0: none
+  {{0, 1}, 2, true},       // 1: trill with the note a semitone above
+  {{0, 2}, 2, true},       // 2: trill with the note a whole tone above
+  {{0, -1}, 2, false},     // 3: mordent (the note, a semitone below, and back)
+  {{0, -2}, 2, false},     // 4: mordent a whole tone below
+  {{0, 1}, 2, false},      // 5: inverted mordent (the note, a semitone above, and back)
+  {{0, 2}, 2, false},      // 6: inverted mordent a whole tone above
+  {{2, 0, -1}, 3, false},  // 7: turn (above, the note, below, and back) a tone above and a semitone below
+  {{2, 0, -2}, 3, false},  // 8: turn a tone above and a tone below
+  {{1, 0, -2}, 3, false},  // 9: turn a semitone above and a tone below
+  {{-1, 0, 2}, 3, false},  // 10: inverted turn (below, the note, above, and back) a semitone below and a tone above
+  {{-2, 0, 2}, 3, false},  // 11: inverted turn a tone below and a tone above
+  {{1}, 1, false},         // 12: grace note a semitone above
+  {{2}, 1, false},         // 13: grace note a whole tone above
+  {{-1}, 1, false},        // 14: grace note a semitone below
+  {{-2}, 1, false},        // 15: grace note a whole tone below
+};
+
+/// How much and how fast notes bend.
+struct Modulation {
+  /// How long a glide from one note to the next takes, in milliseconds.
+  uint16_t glide;
+  /// How long a scoop or a plop takes, in milliseconds.
+  uint16_t bend;
+  // A semitone is about 60 of these, so 17 is a little over a quarter of a semitone either way.
+  /// How far vibrato bends the pitch either way, in 1024ths of the note's period.
+  uint8_t vibratoDepth;
+  /// How many times per second vibrato wobbles, in tenths of a Hertz (55 is 5.5 times per second).
+  uint8_t vibratoRate;
+  /// How long a note is held before vibrato starts, in milliseconds.
+  uint16_t vibratoDelay;
+  // A trill repeats its two notes for as long as the note lasts. The other ornaments are played once at this speed and
+  // then the note carries on, but they're squeezed in faster on notes too short to fit them.
+  /// How long each note of an ornament lasts, in milliseconds.
+  uint16_t ornament;
+};
+
+/// A quick glide, a gentle vibrato, and ornaments of about 14 notes per second, a bit like a violin.
+const Modulation DEFAULT_MODULATION = {60, 80, 17, 55, 250, 70};
+
+// Timer1 counts 2 million times per second (see PwmBuzzer::begin()), and one wave takes the period + 1 counts.
+/// Returns the period (the TOP of Timer1) of a PwmBuzzer playing the given frequency, which must be at least 31 Hz.
+inline uint16_t timerPeriodOf(uint16_t frequency) { return F_CPU / 8 / frequency - 1; }
+
+/// Returns how much the given period changes to move its pitch by the given number of semitones (-2 to 2).
+long periodShift(uint16_t period, int8_t semitones);
+
+/// Works out the period of a note one tick at a time.
+struct Modulator {
+
+  /// Constructs a modulator that hasn't played a note yet.
+  Modulator();
+
+  // A glide starts from wherever the pitch is now, so gliding into a note before the last glide has finished doesn't
+  // jump. The duration is only needed to fit the note's ornament into it.
+  /// Starts a note with the given frequency, expression, and duration (in milliseconds).
+  void noteOn(const Modulation& modulation, uint16_t frequency, uint8_t expression, unsigned int duration);
+
+  /// Moves the pitch one tick forward and returns the period to play.
+  uint16_t tick();
+
+  /// Returns the period of the note without vibrato, or 0 before the first note.
+  uint16_t period() const {
+    long period = (long)(m_period >> 8) + m_ornamentShift;
+    return period > 0xFFFF ? 0xFFFF : period;
+  }
+
+private:
+
+  // The period in 256ths, so that a slow glide can change it by less than 1 per tick.
+  unsigned long m_period;
+  // How much m_period changes each tick, and for how many more ticks. The step is negative when the pitch rises.
+  long m_step;
+  uint16_t m_slideTicks;
+  // The period of the note itself, where a slide ends.
+  uint16_t m_target;
+  // The ticks left before vibrato starts, and how far through its wobble it is: 65536 is one whole wobble, so adding
+  // m_vibratoStep on every tick wraps back to 0 exactly when the wobble is over. m_vibratoStep is 0 without vibrato.
+  uint16_t m_vibratoWait;
+  uint16_t m_vibratoPhase;
+  uint16_t m_vibratoStep;
+  // How far the period moves at the top of a wobble.
+  uint16_t m_vibratoAmplitude;
+  // The ornament, the step of it that's playing, how many ticks each step lasts and how many are left of this one, how
+  // many steps are left (0 once the ornament is over), and how far the step moves the period.
+  const Ornament* m_ornament;
+  uint8_t m_ornamentIndex;
+  uint16_t m_ornamentTicks;
+  uint16_t m_ornamentWait;
+  uint16_t m_ornamentLeft;
+  int16_t m_ornamentShift;
+
+};
+
+#endif /* MODULATION_HPP */
@@ -0,0 +1,137 @@
+// Implementations for the things declared in modulation.hpp. See melody.ino for an explanation of why they're separated.
+#include "envelope.hpp"
+#include "modulation.hpp"
+
+// A sine wave is the same shape in each quarter, just flipped, so only the first quarter is stored: 127 * sin(x) for
+// 17 evenly spaced x from 0 to 90 degrees. The whole wave is 64 steps long.
+const int8_t QUARTER_SINE[17] = {0, 12, 25, 37, 49, 60, 71, 81, 90, 98, 106, 112, 117, 122, 125, 126, 127};
+
+/// Returns 127 * the sine of the given step (0 to 63) of a wave.
+int8_t sineOf(uint8_t step) {
+  // Steps 16 to 31 go back down the quarter, and steps 32 to 63 are the first half upside down.
+  uint8_t index = step & 15;
+  int8_t value = QUARTER_SINE[(step & 16) ? 16 - index : index];
+  return (step & 32) ? -value : value;
+}
+
+long periodShift(uint16_t period, int8_t semitones) {
+  // A higher pitch has a shorter period. A semitone up is 1.0595 times the frequency, so the period of a semitone above
+  // is about 1 - 57/1024 times as long, and the period of a semitone below is about 1 + 61/1024 times. Two semitones
+  // are 1.1225 times the frequency.
+  switch (semitones) {
+    case 2: return -(((unsigned long)period * 112) >> 10);
+    case 1: return -(((unsigned long)period * 57) >> 10);
+    case -1: return ((unsigned long)period * 61) >> 10;
+    case -2: return ((unsigned long)period * 125) >> 10;
+    default: return 0;
+  }
+}
+
+Modulator::Modulator()
+  : m_period(0), m_step(0), m_slideTicks(0), m_target(0), m_vibratoWait(0), m_vibratoPhase(0), m_vibratoStep(0),
+    m_vibratoAmplitude(0), m_ornament(&ORNAMENTS[0]), m_ornamentIndex(0), m_ornamentTicks(0), m_ornamentWait(0),
+    m_ornamentLeft(0), m_ornamentShift(0) {}
+
+void Modulator::noteOn(const Modulation& modulation, uint16_t frequency, uint8_t expression, unsigned int duration) {
+  m_target = timerPeriodOf(frequency < 31 ? 31 : frequency);
+  unsigned long start = m_target;
+  uint16_t slide = 0;
+  if ((expression & EXPRESSION_GLIDE) && m_period > 0) {
+    start = period();
+    slide = modulation.glide;
+  } else if (expression & EXPRESSION_SCOOP) {
+    start = m_target + periodShift(m_target, -1);
+    slide = modulation.bend;
+  } else if (expression & EXPRESSION_PLOP) {
+    start = m_target + periodShift(m_target, 1);
+    slide = modulation.bend;
+  }
+  if (start > 0xFFFF) {
+    start = 0xFFFF;
+  }
+  m_slideTicks = (unsigned long)slide * ENVELOPE_TICK_HZ / 1000;
+  if (m_slideTicks > 0) {
+    m_period = start << 8;
+    // Like in EnvelopeGenerator, the one division happens here, outside of tick().
+    m_step = (((long)m_target << 8) - (long)m_period) / (long)m_slideTicks;
+  } else {
+    m_period = (unsigned long)m_target << 8;
+  }
+
+  m_vibratoPhase = 0;
+  if (expression & EXPRESSION_VIBRATO) {
+    m_vibratoWait = (unsigned long)modulation.vibratoDelay * ENVELOPE_TICK_HZ / 1000;
+    // One wobble is 65536, so the step per tick is 65536 * (vibratoRate / 10) / ENVELOPE_TICK_HZ.
+    m_vibratoStep = 65536UL * modulation.vibratoRate / (10UL * ENVELOPE_TICK_HZ);
+    m_vibratoAmplitude = ((unsigned long)m_target * modulation.vibratoDepth) >> 10;
+  } else {
+    m_vibratoStep = 0;
+  }
+
+  m_ornament = &ORNAMENTS[expression >> 4];
+  m_ornamentIndex = 0;
+  m_ornamentLeft = 0;
+  m_ornamentShift = 0;
+  if (m_ornament->length > 0) {
+    unsigned long noteTicks = (unsigned long)duration * ENVELOPE_TICK_HZ / 1000;
+    unsigned long stepTicks = (unsigned long)modulation.ornament * ENVELOPE_TICK_HZ / 1000;
+    if (m_ornament->repeats) {
+      // A trill needs at least its two notes, so on a short note they're squeezed in.
+      if (stepTicks * 2 > noteTicks) {
+        stepTicks = noteTicks / 2;
+      }
+      m_ornamentLeft = stepTicks > 0 ? noteTicks / stepTicks : 0;
+    } else {
+      // There's always some of the note itself left after the ornament, at least as long as one of its steps.
+      if (stepTicks * (m_ornament->length + 1) > noteTicks) {
+        stepTicks = noteTicks / (m_ornament->length + 1);
+      }
+      m_ornamentLeft = stepTicks > 0 ? m_ornament->length : 0;
+    }
+    // A note too short for even one tick per step is played without its ornament.
+    if (m_ornamentLeft > 0) {
+      m_ornamentTicks = stepTicks;
+      m_ornamentWait = stepTicks;
+      m_ornamentShift = periodShift(m_target, m_ornament->steps[0]);
+    }
+  }
+}
+
+uint16_t Modulator::tick() {
+  if (m_slideTicks > 0) {
+    m_slideTicks--;
+    // The slide ends exactly on the note, so rounding in m_step never leaves it out of tune.
+    if (m_slideTicks == 0) {
+      m_period = (unsigned long)m_target << 8;
+    } else {
+      m_period += m_step;
+    }
+  }
+  // Each step of the ornament moves the pitch away from the note by a fixed amount, worked out once when the step
+  // starts. After the last one, the note itself plays for the rest of its time.
+  if (m_ornamentLeft > 0) {
+    m_ornamentWait--;
+    if (m_ornamentWait == 0) {
+      m_ornamentLeft--;
+      m_ornamentIndex++;
+      if (m_ornamentIndex == m_ornament->length) {
+        m_ornamentIndex = 0;
+      }
+      m_ornamentShift = m_ornamentLeft > 0 ? periodShift(m_target, m_ornament->steps[m_ornamentIndex]) : 0;
+      m_ornamentWait = m_ornamentTicks;
+    }
+  }
+  long result = period();
+  if (m_vibratoStep > 0) {
+    if (m_vibratoWait > 0) {
+      m_vibratoWait--;
+    } else {
+      m_vibratoPhase += m_vibratoStep;
+      // The top 6 bits of the phase are the step of the sine wave. Multiplying by the sine (up to 127) and shifting
+      // right by 7 (dividing by 128) moves the period by up to m_vibratoAmplitude either way. It's subtracted so that
+      // the pitch goes up first.
+      result -= ((long)m_vibratoAmplitude * sineOf(m_vibratoPhase >> 10)) >> 7;
+    }
+  }
+  return result > 0xFFFF ? 0xFFFF : result;
+}
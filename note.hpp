@@ -16,21 +16,55 @@
 #ifndef NOTE_HPP
 #define NOTE_HPP
 
+/// The largest offset a note can have, in milliseconds (about 4 hours and 40 minutes). See Note::m_offset.
+const unsigned long MAX_NOTE_OFFSET = 0xFFFFFFUL;
+
+/// Selects the constructor of Note that takes its offset in 256ths of a millisecond.
+struct FixedPointOffset {};
+
+// The constructor of Note calls these when it's given a bad note. Under normal circumstances you would want to throw
+// the error, but unfortunately that is not possible in the Arduino subset of C++. They return the bad value, which the
+// note keeps. They aren't constexpr, so a bad note in a melody worked out while compiling (see compose.hpp) is an
+// error the compiler reports, like "call to non-constexpr function 'uint16_t noteErrorLowFrequency(uint16_t)'".
+inline uint16_t noteErrorLowFrequency(uint16_t frequency) {
+  Serial.println("ERROR: Frequency less than 31 Hz provided");
+  return frequency;
+}
+inline unsigned long noteErrorLargeOffset(unsigned long offset) {
+  Serial.println("ERROR: Note offset too large (more than 4 hours)");
+  return offset;
+}
+
 // A "struct" defines a blueprint for objects, encapsulate data. In this case, the blueprint's name is Note, and it
 // has all objects created from the blueprint contain information about individual notes that will be played.
 struct Note {
 
+  // A default constructor takes no arguments. This one creates a silent placeholder note, which allows arrays of notes
+  // to be declared before we know what goes in them (see melody_buffer.hpp).
+  /// Constructs a placeholder note with no frequency, offset, or duration.
+  constexpr Note() : m_frequency(0), m_offset(0), m_duration(0) {}
+
   // uint16_t indicates that the type is an unsigned (>= 0) 16-bit integer. We use this instead of things like short
   // or int because it guarantees that the 16-bit integer will be chosen.
   // This is an
-  Note(const uint16_t& frequency, const unsigned long offset, const unsigned long duration): m_frequency(frequency), m_offset(offset), m_duration(duration) {
-    if (frequency < 31) {
-      // Under normal circumstances you would want to throw this string, but unfortunately that is not possible in
-      // the Arduino subset of C++.
-      Serial.println("ERROR: Frequency less than 31 Hz provided");
-    }
-  }
+  // The last argument has a default value, so it can be left out: {440, 1000, 250} is the same as {440, 1000, 250, 0}.
+  // It's there for melodies whose notes don't start on a whole millisecond, such as fast triplets (see m_offset).
+  // constexpr means the constructor can also run while the program is being compiled, which is how the melodies in
+  // songs.hpp end up finished and sorted before the Arduino even starts (see melody.hpp). The body of a constexpr
+  // constructor has to be empty, so the checks are done with the ?: operator ("a ? b : c" is b if a is true and c
+  // otherwise) while the members are initialized.
+  constexpr Note(const uint16_t& frequency, const unsigned long offset, const unsigned long duration,
+                 const uint8_t offsetFraction = 0)
+      : m_frequency(frequency >= 31 ? frequency : noteErrorLowFrequency(frequency)),
+        m_offset((offset <= MAX_NOTE_OFFSET ? offset : noteErrorLargeOffset(offset)) << 8 | offsetFraction),
+        m_duration(duration) {}
   
+  // This one doesn't check anything: whatever uses it has to check the note itself (see rtttl.hpp). FixedPointOffset
+  // is an empty type that's only there to give this constructor different arguments from the one above.
+  /// Constructs a note from an offset in 256ths of a millisecond (see m_offset), without checking it.
+  constexpr Note(FixedPointOffset, uint16_t frequency, unsigned long offset, unsigned int duration)
+      : m_frequency(frequency), m_offset(offset), m_duration(duration) {}
+
   // The three declarations below are known as member functions, since they will be members of each object created from
   // this struct and they are callable functions. These particular member functions are known as getters because they
   // get the data stored by each of the members listed in the private section, but in a way such that they cannot be 
@@ -41,22 +75,43 @@ struct Note {
   // 16-bit integer."" The second "const" indicates that this member function doesn't modify the Note, which
   // means a const Note object will have this member function.
   /// Returns the pitch of the note as a frequency in Hertz.
-  const uint16_t& frequency() const { return m_frequency; }
+  constexpr const uint16_t& frequency() const { return m_frequency; }
 
-  // "unsigned long" is a large integer type that stores only positive integers.
-  /// Returns the offset of the note (position from the start) in milliseconds.
-  const unsigned long& offset() const { return m_offset; }
+  // "unsigned long" is a large integer type that stores only positive integers. The >> moves the bits of m_offset 8
+  // places to the right, which throws away the fraction of a millisecond (see m_offset).
+  /// Returns the offset of the note (position from the start) in whole milliseconds.
+  constexpr unsigned long offset() const { return m_offset >> 8; }
+
+  // & 0xFF keeps only the lowest 8 bits, which are the fraction.
+  /// Returns the part of the offset smaller than a millisecond, in 256ths of a millisecond.
+  constexpr uint8_t offsetFraction() const { return m_offset & 0xFF; }
+
+  /// Returns the whole offset in 256ths of a millisecond (see m_offset).
+  constexpr unsigned long fixedPointOffset() const { return m_offset; }
+
+  // Players wait for notes with micros(), so this is the offset they use. Multiplying all of m_offset by 1000 could
+  // overflow, so the whole milliseconds and the fraction are converted separately. Adding 128 before shifting by 8
+  // (dividing by 256) rounds to the nearest microsecond.
+  /// Returns the offset of the note in microseconds, including the fraction of a millisecond.
+  constexpr unsigned long offsetMicros() const {
+    return offset() * 1000UL + (((unsigned long)offsetFraction() * 1000UL + 128) >> 8);
+  }
   
   // "unsigned int" is slightly smaller than 
   /// Returns the duration of the note in milliseconds.
-  const unsigned int& duration() const { return m_duration; }
+  constexpr const unsigned int& duration() const { return m_duration; }
+
+  // Ends are worked out from offsetMicros() rather than offset(), so a note that starts part of the way through a
+  // millisecond also ends that far through one, and isn't cut short.
+  /// Returns when the note stops sounding, in microseconds from the start (offset 0).
+  constexpr unsigned long endMicros() const { return offsetMicros() + duration() * 1000UL; }
 
   // This function is special in two ways: it overloads an operator and it is a friend. Operator overloading implements
   // the behavior of the given operator (in this case, the > operator) for the given signature (comparing two Notes).
   // This allows us to do something like note1 > note2 and get a sensible result.
   // friend indicates that this actually isn't a member function, but that wherever else it's defined it can access
   // private members of the instance.
-  friend bool operator>(const Note& lhs, const Note& rhs);
+  friend constexpr bool operator>(const Note& lhs, const Note& rhs);
 
 // By default, struct members are public, which means that any client code that can access Note is able to access the
 // member. However, to prevent the client from modifying the internal data of objects created from Note, we indicate
@@ -67,17 +122,33 @@ private:
   // stands for member. This form of disambiguation is almost always unnecessary in other programming languages (or
   // a different convention is used).
   uint16_t m_frequency;
+  // The offset is stored in fixed point: the top 24 bits are whole milliseconds and the bottom 8 bits are 256ths of a
+  // millisecond (about 4 microseconds each, which is also how precise micros() is on most Arduinos). Rounding every
+  // offset to a whole millisecond would make fast notes up to half a millisecond early or late, and unevenly spaced.
+  // The fraction costs no memory, since 24 bits of milliseconds is still more than 4 hours.
   unsigned long m_offset;
   unsigned int m_duration;
 
 };
 
-// This is our actual implementation of >. It's declared inline to encourage the compiler to basically substitute the
+// This is our actual implementation of >. It's declared constexpr (which includes inline) so that melodies can be
+// sorted while the program compiles (see melody.hpp). inline encourages the compiler to basically substitute the
 // comparison in for efficiency.
 // The reference (&) means we won't copy notes when trying to compare them, saving memory; and const ensures the
 // implementation cannot modify the passed in Note.
 // "bool" is a true/false data type (it stores Boolean data).
-inline bool operator>(const Note& lhs, const Note& rhs) { return lhs.m_offset > rhs.m_offset; }
+constexpr bool operator>(const Note& lhs, const Note& rhs) { return lhs.m_offset > rhs.m_offset; }
+
+// Sources that keep time in microseconds (see ticks.hpp and bytecode.hpp) use this to keep the fraction of a
+// millisecond instead of rounding it away. % gives the remainder of a division: the microseconds that don't make up a
+// whole millisecond. There are 1000 of those in a millisecond but only 256 steps in the fraction, so it's rounded to
+// the nearest step. Rounding 999 microseconds up gives 256 steps, which is a whole millisecond, so / 256 and % 256
+// carry it over.
+/// Constructs a note that starts the given number of microseconds after the start of its melody.
+inline Note noteAtMicros(uint16_t frequency, unsigned long offsetMicros, unsigned long duration) {
+  unsigned long fraction = ((offsetMicros % 1000) * 256 + 500) / 1000;
+  return Note(frequency, offsetMicros / 1000 + fraction / 256, duration, fraction % 256);
+}
 
 // The NOTE_HPP down here is optional (it's in a comment).
 #endif /* NOTE_HPP */
\ No newline at end of file
@@ -0,0 +1,96 @@
+/// Defines a compact way of storing melodies that repeat themselves, and a source that plays them back note by note.
+
+// See note.hpp for an explanation of header guards.
+#ifndef PHRASE_HPP
+#define PHRASE_HPP
+
+#include "note.hpp"
+#include "tuning.hpp"
+
+// Most songs repeat themselves: a verse comes back, a riff is played again, or the same tune is played a few semitones
+// higher. A Melody stores every one of those notes again. A PhraseMelody stores each repeated run of notes (a phrase)
+// once, and everywhere it's played just stores a short "call" that says "play phrase 2 here, 5 semitones higher".
+// Phrases can call other phrases too. melody_creator finds the phrases automatically (see
+// melody_creator/melody_creator/phrases.py) and prints how many bytes each song saves.
+//
+// Each item is 6 bytes instead of the 8 bytes of a Note, so even a song without any repeats gets smaller:
+//
+//   * Instead of an offset from the start of the song, an item stores how long after the item before it it starts.
+//     That difference is almost always small enough for 16 bits, while an offset needs 32.
+//   * Instead of a frequency, a note item stores a MIDI note number (see pitches.hpp), which fits in one byte and can
+//     be transposed by simply adding to it. The current tuning turns it into a frequency as it plays (see tuning.hpp).
+
+/// The pitch that marks a PhraseItem as a call to another phrase instead of a note.
+const uint8_t PHRASE_CALL = 0xFF;
+
+/// The most phrases that can be in progress at once: the song itself plus up to three levels of calls.
+const uint8_t MAX_PHRASE_DEPTH = 4;
+
+/// One note of a phrase, or a call to another phrase.
+struct PhraseItem {
+  /// The time in milliseconds from the start of the previous note (or call) to the start of this one.
+  uint16_t delta;
+  /// For a note, its duration in milliseconds. For a call, the number of the phrase to play.
+  uint16_t value;
+  /// For a note, its MIDI note number. For a call, PHRASE_CALL.
+  uint8_t pitch;
+  /// For a call, how many semitones higher (or, if negative, lower) to play the phrase. Unused for notes.
+  int8_t transpose;
+};
+
+// Unlike the other structs in this project, PhraseItem and PhraseMelody have no constructors or private members. That
+// makes them "aggregates", which can be written as lists in braces like {250, 142, 68, 0}, and which the compiler can
+// store as constants without running any code when the Arduino starts.
+//
+// The items and phrase starts are what makes a song smaller, so they're kept in flash: on an AVR board (like the Uno),
+// a plain const array would be copied into the much smaller RAM when the sketch starts (see lz.hpp). That's why both
+// arrays must be declared PROGMEM, as melody_creator prints them, and why PhraseStream reads them with memcpy_P() and
+// pgm_read_word() instead of normal pointers. The PhraseMelody itself is only a few bytes, so it can stay a normal
+// constant.
+/// A melody stored as phrases. Phrase i is made up of items[phrases[i]] up to (but not including)
+/// items[phrases[i + 1]], and phrase 0 is the song itself.
+struct PhraseMelody {
+  /// Every item of every phrase, one phrase after another, in flash (declared PROGMEM).
+  const PhraseItem* items;
+  /// Where each phrase starts in items, followed by the total number of items (so there are phraseCount + 1 numbers),
+  /// in flash (declared PROGMEM).
+  const uint16_t* phrases;
+  /// The number of phrases, including phrase 0.
+  uint16_t phraseCount;
+};
+
+// Playing a phrase in the middle of another one is like calling a function in the middle of another one: when the
+// inner phrase ends, the outer one has to carry on exactly where it left off. The computer remembers where to carry on
+// using a "call stack", and so does PhraseStream: each phrase in progress has a frame saying which item is next, where
+// the phrase ends, and how far it's transposed. Calling a phrase pushes a frame on top, and finishing one pops it off.
+/// Expands a PhraseMelody into notes one at a time. Can be used as a source for StreamPlayer (see stream_player.hpp).
+struct PhraseStream {
+
+  /// Constructs a stream that plays the given melody from the beginning.
+  explicit PhraseStream(const PhraseMelody& melody);
+
+  /// Goes back to the beginning of the melody.
+  void rewind();
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  struct Frame {
+    // The position in m_melody.items of the phrase's next item, and of the item after its last one.
+    uint16_t position;
+    uint16_t end;
+    // How many semitones every note of the phrase is moved by (including the transpositions of every outer call).
+    int8_t transpose;
+  };
+
+  const PhraseMelody& m_melody;
+  Frame m_stack[MAX_PHRASE_DEPTH];
+  uint8_t m_depth;
+  // The offset (in milliseconds) of the latest item. Items store the time since the previous item, so this adds up.
+  unsigned long m_time;
+
+};
+
+#endif /* PHRASE_HPP */
@@ -0,0 +1,50 @@
+// Implementations for the things declared in phrase.hpp. See melody.ino for an explanation of why they're separated.
+#include "phrase.hpp"
+
+PhraseStream::PhraseStream(const PhraseMelody& melody) : m_melody(melody), m_depth(0), m_time(0) {
+  rewind();
+}
+
+void PhraseStream::rewind() {
+  m_time = 0;
+  m_depth = 0;
+  if (m_melody.phraseCount == 0) {
+    return;
+  }
+  // The bottom frame is phrase 0: the song itself.
+  m_stack[0].position = pgm_read_word(&m_melody.phrases[0]);
+  m_stack[0].end = pgm_read_word(&m_melody.phrases[1]);
+  m_stack[0].transpose = 0;
+  m_depth = 1;
+}
+
+bool PhraseStream::next(Note& note) {
+  while (m_depth > 0) {
+    Frame& frame = m_stack[m_depth - 1];
+    if (frame.position == frame.end) {
+      // The phrase is over, so pop its frame and carry on with the phrase that called it.
+      m_depth--;
+      continue;
+    }
+    // The item is in flash, so it's copied into RAM to be read (see phrase.hpp).
+    PhraseItem item;
+    memcpy_P(&item, &m_melody.items[frame.position++], sizeof(item));
+    m_time += item.delta;
+    if (item.pitch != PHRASE_CALL) {
+      note = Note(tunedFrequency(item.pitch + frame.transpose), m_time, item.value);
+      return true;
+    }
+    if (m_depth == MAX_PHRASE_DEPTH || item.value >= m_melody.phraseCount) {
+      // melody_creator never writes melodies like this, so the melody must have been typed in by hand. Skipping the
+      // call keeps the rest of the song playing.
+      Serial.println("ERROR: Phrase call too deep or to a phrase that doesn't exist");
+      continue;
+    }
+    // Push a frame for the called phrase. Its first item has a delta of 0, so it starts exactly when the call does.
+    Frame& called = m_stack[m_depth++];
+    called.position = pgm_read_word(&m_melody.phrases[item.value]);
+    called.end = pgm_read_word(&m_melody.phrases[item.value + 1]);
+    called.transpose = frame.transpose + item.transpose;
+  }
+  return false;
+}
@@ -1,6 +1,7 @@
 /// Pre-compilation definitions for some common pitches and their frequencies rounded to the nearest integer.
 
-// This file is currently unused due to the melody_creator Python library doing this automatically.
+// melody_creator works out frequencies itself, so songs don't need these names, but phrase.hpp uses the table at the
+// bottom to turn MIDI note numbers into frequencies.
 
 // See note.hpp for an explanation of header guards.
 #ifndef PITCHES_HPP
@@ -103,4 +104,46 @@
 #define NOTE_D8  4699
 #define NOTE_DS8 4978
 
+// Each pitch above also has a number, called its MIDI note number: C4 (middle C) is 60, and every semitone up or down
+// adds or subtracts 1. Numbers make it easy to move a whole melody up or down (transpose it): add the same number of
+// semitones to every note. This table turns those numbers back into frequencies.
+/// The MIDI note numbers of the lowest (NOTE_B0) and highest (NOTE_DS8) pitches above.
+const uint8_t LOWEST_PITCH = 23;
+const uint8_t HIGHEST_PITCH = 111;
+
+// constexpr (instead of const) lets the compiler read the table while it compiles (see rtttl.hpp).
+/// The frequency of every pitch above, in order: PITCH_FREQUENCIES[pitch - LOWEST_PITCH] is the frequency of MIDI note
+/// number pitch.
+constexpr uint16_t PITCH_FREQUENCIES[] = {
+  NOTE_B0, NOTE_C1, NOTE_CS1, NOTE_D1, NOTE_DS1, NOTE_E1, NOTE_F1, NOTE_FS1, NOTE_G1, NOTE_GS1, NOTE_A1, NOTE_AS1,
+  NOTE_B1, NOTE_C2, NOTE_CS2, NOTE_D2, NOTE_DS2, NOTE_E2, NOTE_F2, NOTE_FS2, NOTE_G2, NOTE_GS2, NOTE_A2, NOTE_AS2,
+  NOTE_B2, NOTE_C3, NOTE_CS3, NOTE_D3, NOTE_DS3, NOTE_E3, NOTE_F3, NOTE_FS3, NOTE_G3, NOTE_GS3, NOTE_A3, NOTE_AS3,
+  NOTE_B3, NOTE_C4, NOTE_CS4, NOTE_D4, NOTE_DS4, NOTE_E4, NOTE_F4, NOTE_FS4, NOTE_G4, NOTE_GS4, NOTE_A4, NOTE_AS4,
+  NOTE_B4, NOTE_C5, NOTE_CS5, NOTE_D5, NOTE_DS5, NOTE_E5, NOTE_F5, NOTE_FS5, NOTE_G5, NOTE_GS5, NOTE_A5, NOTE_AS5,
+  NOTE_B5, NOTE_C6, NOTE_CS6, NOTE_D6, NOTE_DS6, NOTE_E6, NOTE_F6, NOTE_FS6, NOTE_G6, NOTE_GS6, NOTE_A6, NOTE_AS6,
+  NOTE_B6, NOTE_C7, NOTE_CS7, NOTE_D7, NOTE_DS7, NOTE_E7, NOTE_F7, NOTE_FS7, NOTE_G7, NOTE_GS7, NOTE_A7, NOTE_AS7,
+  NOTE_B7, NOTE_C8, NOTE_CS8, NOTE_D8, NOTE_DS8
+};
+
+// Pitches outside the table are moved to the nearest end of it, so this always returns a frequency the buzzer can play.
+// A constexpr function can also run while the program is compiling, if its arguments are known then (see rtttl.hpp).
+// The rules for that (in the version of C++ the Arduino IDE uses) only allow a single return statement, so the ifs are
+// written with the ?: operator instead: "a ? b : c" is b if a is true and c otherwise.
+/// Returns the frequency in Hertz of the given MIDI note number.
+constexpr uint16_t pitchFrequency(int pitch) {
+  return PITCH_FREQUENCIES[(pitch < LOWEST_PITCH ? LOWEST_PITCH : pitch > HIGHEST_PITCH ? HIGHEST_PITCH : pitch)
+                           - LOWEST_PITCH];
+}
+
+// This is a binary search: each call checks the pitch halfway between low and high and keeps searching the half the
+// frequency is in, until only two neighbouring pitches are left. That takes 7 steps for the whole table instead of up
+// to 88 for checking every pitch.
+/// Returns the MIDI note number whose frequency (between the pitches low and high) is closest to the given one.
+constexpr int nearestPitch(uint16_t frequency, int low = LOWEST_PITCH, int high = HIGHEST_PITCH) {
+  return high - low <= 1
+             ? (frequency - pitchFrequency(low) <= pitchFrequency(high) - frequency ? low : high)
+         : pitchFrequency((low + high) / 2) <= frequency ? nearestPitch(frequency, (low + high) / 2, high)
+         : nearestPitch(frequency, low, (low + high) / 2);
+}
+
 #endif /* PITCHES_HPP */
\ No newline at end of file
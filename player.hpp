@@ -0,0 +1,145 @@
+/// Defines a melody player that plays notes one event at a time instead of blocking until the melody is over.
+
+// See note.hpp for an explanation of header guards.
+#ifndef PLAYER_HPP
+#define PLAYER_HPP
+
+#include "backend.hpp"
+#include "events.hpp"
+#include "melody.hpp"
+#include "melody_buffer.hpp"
+
+// playMelody() in melody.hpp is the simplest way to play a melody, but it waits between notes, which means the
+// Arduino can't do anything else until the melody is over. MelodyPlayer does the same job in small steps: every time
+// update() is called it plays whatever note is due and then tells the caller when it next needs to be called. In
+// between those times the Arduino is free to do other work (see scheduler.hpp).
+//
+// Like StreamPlayer (see stream_player.hpp), it plays the notes on a backend (see backend.hpp), which is tone() unless
+// another one is given: MelodyPlayer<TimerBackend> plays on Timer1 instead. MelodyPlayer<> (with the empty brackets)
+// uses the default.
+/// Plays a melody on a backend without blocking.
+template <typename Backend = ToneBackend>
+struct MelodyPlayer {
+
+  // The explicit keyword prevents the compiler from silently converting a plain number into a MelodyPlayer, which
+  // would almost certainly be a mistake. A pin number still works as the backend, since it turns into a ToneBackend by
+  // itself.
+  /// Constructs a new player that plays notes on (a copy of) the given backend.
+  explicit MelodyPlayer(const Backend& backend);
+
+  // This is a member function template: a template inside a struct, with a template parameter of its own. It lets
+  // start() accept a melody of any length. Because it's so short, it's defined right here instead of in player.ino.
+  /// Starts playing the given melody. The first note plays at the given time (in microseconds) plus its offset.
+  template <size_t N>
+  void start(const Melody<N>& melody, unsigned long now) { start(melody.cbegin(), melody.cend(), now); }
+
+  /// Starts playing the given runtime-built melody (see melody_buffer.hpp). The melody must not change while playing.
+  void start(const MelodyBuffer& melody, unsigned long now) { start(melody.cbegin(), melody.cend(), now); }
+
+  // Pointers to the first note and to the memory just past the last note is exactly what cbegin() and cend() return,
+  // so any sorted array of notes can be played, not only Melody objects.
+  /// Starts playing the sorted notes in [first, last). The first note plays at the given time plus its offset.
+  void start(const Note* first, const Note* last, unsigned long now);
+
+  /// Stops playback immediately.
+  void stop();
+
+  /// Returns true if the player still has notes to play (or a note to finish).
+  bool isPlaying() const { return m_playing; }
+
+  /// Sets the length of a beat in milliseconds, so that BEAT events are reported. 0 (the default) turns them off.
+  void setBeatLength(unsigned long beatMillis) { m_beatMillis = beatMillis; }
+
+  // A buzzer can only play one note at a time, so normally a note cuts off whichever note was sounding before it, and
+  // only the top (last-started) note of a chord is heard. With arpeggiation on, the player keeps track of every note
+  // that's sounding at once (up to MAX_CHORD_NOTES) and switches between them this many times per second. 30 to 60
+  // switches per second is too fast to hear as separate notes, so it sounds like a buzzy chord (old video game consoles
+  // did exactly this). The newest note always sounds first, so every note still starts on time. Each switch is just
+  // another event for the scheduler, so nothing blocks.
+  /// Sets how many times per second to switch between the notes of a chord. 0 (the default) turns arpeggiation off.
+  /// Call it before start().
+  void setArpeggioRate(unsigned int hertz) { m_arpeggioPeriod = hertz > 0 ? 1000000UL / hertz : 0; }
+
+  // See events.hpp for how callbacks and their budgets work.
+  /// Adds a callback for the events in the given mask. Returns false if the callback table is full.
+  bool addCallback(NoteEventCallback callback, void* context, uint8_t eventMask, unsigned long budget) {
+    return m_callbacks.add(callback, context, eventMask, budget);
+  }
+
+  /// Returns the callbacks of this player, e.g. to print a report of their overruns.
+  const CallbackTable& callbacks() const { return m_callbacks; }
+
+  /// Returns how many events were dropped because too many were waiting to be dispatched.
+  unsigned long droppedEvents() const { return m_droppedEvents; }
+
+  // The second argument is a reference, which lets this function give back a second result on top of the bool it
+  // returns: the time (in microseconds, like micros()) at which update() needs to be called again.
+  /// Plays every note that is due at the given time. Returns false once the melody is over; otherwise stores the time
+  /// of the next note event in nextEvent.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  // Static member functions don't belong to a specific MelodyPlayer, so they can be passed around as plain function
+  // pointers. This one just forwards to update() on the player passed in as context, which lets a MelodyPlayer be
+  // added to a Scheduler as a task.
+  /// Task adapter for Scheduler: context must point to a MelodyPlayer<Backend>.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+private:
+
+  /// Returns the time (in microseconds) at which the given offset (in milliseconds) from the start is reached.
+  unsigned long timeOf(unsigned long offsetMillis) const { return m_startTime + offsetMillis * 1000UL; }
+  // Notes can start part of the way through a millisecond (see note.hpp), so they're scheduled in microseconds.
+  unsigned long startOf(const Note& note) const { return m_startTime + note.offsetMicros(); }
+
+  // Adds an event to the back of the pending events, or counts it as dropped if there's no room.
+  void queueEvent(NoteEventType type, const Note* note, unsigned long beat, unsigned long time);
+
+  // Dispatches pending events until there are none left or the next note is too close to risk it.
+  void dispatchEvents(unsigned long now);
+
+  // The arpeggiation version of playing due notes: updates the chord and switches notes if it's time to.
+  void updateChord(unsigned long now);
+  // Takes the note at the given index out of the chord.
+  void removeFromChord(uint8_t index);
+
+  Backend m_backend;
+  // The next note to play and the end of the notes.
+  const Note* m_next;
+  const Note* m_end;
+  // The time (from micros()) that offset 0 corresponds to.
+  unsigned long m_startTime;
+  // When the last note finishes sounding, in microseconds from the start.
+  unsigned long m_endMicros;
+  bool m_playing;
+
+  // The note that is currently sounding (or nullptr) and when it stops, in microseconds.
+  const Note* m_sounding;
+  unsigned long m_soundingEnd;
+  // The length of a beat in milliseconds (0 for no beats) and the number of the next beat to report.
+  unsigned long m_beatMillis;
+  unsigned long m_nextBeat;
+
+  CallbackTable m_callbacks;
+  // Events wait here between being noticed and being dispatched. This is a ring buffer: m_firstEvent is the position of
+  // the oldest event and positions wrap around to 0 after the end of the array, so events never need to be moved.
+  static const size_t MAX_PENDING_EVENTS = 8;
+  NoteEvent m_pendingEvents[MAX_PENDING_EVENTS];
+  size_t m_firstEvent;
+  size_t m_eventCount;
+  unsigned long m_droppedEvents;
+
+  // The time (in microseconds) between switches, or 0 if arpeggiation is off.
+  unsigned long m_arpeggioPeriod;
+  // The notes sounding together, oldest first, with the times they end. If another note starts when the chord is full,
+  // the oldest one is cut off.
+  static const uint8_t MAX_CHORD_NOTES = 4;
+  const Note* m_chord[MAX_CHORD_NOTES];
+  unsigned long m_chordEnds[MAX_CHORD_NOTES];
+  uint8_t m_chordSize;
+  // The index in m_chord of the note the buzzer is playing, and when to switch to the next one.
+  uint8_t m_chordIndex;
+  unsigned long m_nextSwitch;
+
+};
+
+#endif /* PLAYER_HPP */
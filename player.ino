@@ -0,0 +1,213 @@
+// Implementations for the things declared in player.hpp. See melody.ino for an explanation of why they're separated.
+#include "player.hpp"
+
+// The part after the colon is called a member initializer list. It sets each member before the body of the
+// constructor runs, which is the preferred way of initializing members in C++.
+template <typename Backend>
+MelodyPlayer<Backend>::MelodyPlayer(const Backend& backend)
+  : m_backend(backend), m_next(nullptr), m_end(nullptr), m_startTime(0), m_endMicros(0), m_playing(false),
+    m_sounding(nullptr), m_soundingEnd(0), m_beatMillis(0), m_nextBeat(0), m_firstEvent(0), m_eventCount(0),
+    m_droppedEvents(0), m_arpeggioPeriod(0), m_chordSize(0), m_chordIndex(0), m_nextSwitch(0) {}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::start(const Note* first, const Note* last, unsigned long now) {
+  m_next = first;
+  m_end = last;
+  m_startTime = now;
+  m_playing = first < last;
+  m_sounding = nullptr;
+  m_chordSize = 0;
+  m_nextBeat = 0;
+  m_eventCount = 0;
+  if (m_playing) {
+    // Notes are sorted by offset, not by end, so a long early note might end after the last one starts. We only need
+    // the end of the melody as a whole, so the largest end is found once here instead of on every update.
+    m_endMicros = 0;
+    for (const Note* note = first; note < last; note++) {
+      if (note->endMicros() > m_endMicros) {
+        m_endMicros = note->endMicros();
+      }
+    }
+  }
+}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::stop() {
+  if (m_playing) {
+    m_backend.stop();
+  }
+  m_next = m_end;
+  m_playing = false;
+  m_sounding = nullptr;
+  m_chordSize = 0;
+  m_eventCount = 0;
+}
+
+template <typename Backend>
+bool MelodyPlayer<Backend>::update(unsigned long now, unsigned long& nextEvent) {
+  if (!m_playing) {
+    return false;
+  }
+  // micros() wraps around to 0 after about 70 minutes. Subtracting two unsigned times and reading the result as a
+  // signed number gives the right answer even across the wrap, as long as they're less than 35 minutes apart. A
+  // result >= 0 means the time has been reached.
+  if (m_arpeggioPeriod > 0) {
+    updateChord(now);
+  } else {
+    // If we were called late, several notes may be due at once. Only the last of them is worth playing because a
+    // buzzer can only play one note at a time, but we still need to step over all of them.
+    const Note* due = nullptr;
+    while (m_next < m_end && (long)(now - startOf(*m_next)) >= 0) {
+      due = m_next;
+      m_next++;
+    }
+    // Playing the note comes before anything else, and callbacks are only queued here, not called, so that listening
+    // for events never makes a note late.
+    if (m_sounding != nullptr && (long)(now - m_soundingEnd) >= 0) {
+      queueEvent(NOTE_OFF, m_sounding, 0, m_soundingEnd);
+      m_sounding = nullptr;
+    }
+    if (due != nullptr) {
+      m_backend.play(due->frequency(), due->duration());
+      if (m_sounding != nullptr) {
+        // The new note cut the previous one off.
+        queueEvent(NOTE_OFF, m_sounding, 0, now);
+      }
+      queueEvent(NOTE_ON, due, 0, now);
+      m_sounding = due;
+      m_soundingEnd = m_startTime + due->endMicros();
+    }
+  }
+  while (m_beatMillis > 0 && m_nextBeat * m_beatMillis * 1000UL < m_endMicros
+         && (long)(now - timeOf(m_nextBeat * m_beatMillis)) >= 0) {
+    queueEvent(BEAT, nullptr, m_nextBeat, timeOf(m_nextBeat * m_beatMillis));
+    m_nextBeat++;
+  }
+
+  if (m_next >= m_end && (long)(now - (m_startTime + m_endMicros)) >= 0) {
+    // After the last note has ended, silence the buzzer just like playMelody() does. There are no more notes to be
+    // late for, so every remaining event can be dispatched.
+    m_backend.stop();
+    m_playing = false;
+    dispatchEvents(now);
+    return false;
+  }
+
+  dispatchEvents(now);
+
+  // The next event is whichever comes first: the next note, the end of the sounding note (or of any note in the
+  // chord), the next switch between the notes of a chord, the next beat, or the end of the melody.
+  nextEvent = m_next < m_end ? startOf(*m_next) : m_startTime + m_endMicros;
+  if (m_sounding != nullptr && (long)(m_soundingEnd - nextEvent) < 0) {
+    nextEvent = m_soundingEnd;
+  }
+  for (uint8_t i = 0; i < m_chordSize; i++) {
+    if ((long)(m_chordEnds[i] - nextEvent) < 0) {
+      nextEvent = m_chordEnds[i];
+    }
+  }
+  if (m_chordSize > 1 && (long)(m_nextSwitch - nextEvent) < 0) {
+    nextEvent = m_nextSwitch;
+  }
+  if (m_beatMillis > 0 && m_nextBeat * m_beatMillis * 1000UL < m_endMicros
+      && (long)(timeOf(m_nextBeat * m_beatMillis) - nextEvent) < 0) {
+    nextEvent = timeOf(m_nextBeat * m_beatMillis);
+  }
+  return true;
+}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::updateChord(unsigned long now) {
+  const Note* sounding = m_chordSize > 0 ? m_chord[m_chordIndex] : nullptr;
+  // Notes that have ended leave the chord before new ones join, so a note that ends exactly when the next one starts
+  // (like in a legato melody) doesn't make a chord with it.
+  uint8_t i = 0;
+  while (i < m_chordSize) {
+    if ((long)(now - m_chordEnds[i]) >= 0) {
+      queueEvent(NOTE_OFF, m_chord[i], 0, m_chordEnds[i]);
+      removeFromChord(i);
+    } else {
+      i++;
+    }
+  }
+  bool added = false;
+  while (m_next < m_end && (long)(now - startOf(*m_next)) >= 0) {
+    if (m_chordSize == MAX_CHORD_NOTES) {
+      queueEvent(NOTE_OFF, m_chord[0], 0, now);
+      removeFromChord(0);
+    }
+    m_chord[m_chordSize] = m_next;
+    m_chordEnds[m_chordSize] = m_startTime + m_next->endMicros();
+    queueEvent(NOTE_ON, m_next, 0, now);
+    m_chordIndex = m_chordSize;
+    m_chordSize++;
+    m_next++;
+    added = true;
+  }
+  if (!added && m_chordSize > 1 && (long)(now - m_nextSwitch) >= 0) {
+    m_chordIndex = (m_chordIndex + 1) % m_chordSize;
+  }
+
+  // Nothing needs to change if the same note should keep sounding, e.g. when a different note of the chord ended.
+  const Note* next = m_chordSize > 0 ? m_chord[m_chordIndex] : nullptr;
+  if (next == sounding) {
+    return;
+  }
+  // With a duration of 0, the backend keeps playing until it's told otherwise, which is what's needed here: the chord
+  // decides when each note stops.
+  if (next != nullptr) {
+    m_backend.play(next->frequency(), 0);
+  } else {
+    m_backend.stop();
+  }
+  m_nextSwitch = now + m_arpeggioPeriod;
+}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::removeFromChord(uint8_t index) {
+  for (uint8_t i = index + 1; i < m_chordSize; i++) {
+    m_chord[i - 1] = m_chord[i];
+    m_chordEnds[i - 1] = m_chordEnds[i];
+  }
+  m_chordSize--;
+  // The sounding note keeps sounding if it's still in the chord. If it's the one that left, the note after it (which
+  // has just moved into its place) plays next.
+  if (index < m_chordIndex) {
+    m_chordIndex--;
+  }
+  if (m_chordIndex >= m_chordSize) {
+    m_chordIndex = 0;
+  }
+}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::queueEvent(NoteEventType type, const Note* note, unsigned long beat, unsigned long time) {
+  if (m_eventCount >= MAX_PENDING_EVENTS) {
+    m_droppedEvents++;
+    return;
+  }
+  // % (modulo) gives the remainder of a division, which is what makes the positions wrap around to 0.
+  m_pendingEvents[(m_firstEvent + m_eventCount) % MAX_PENDING_EVENTS] = NoteEvent{type, note, beat, time};
+  m_eventCount++;
+}
+
+template <typename Backend>
+void MelodyPlayer<Backend>::dispatchEvents(unsigned long now) {
+  while (m_eventCount > 0) {
+    // If the next note is due before the slowest callback would be finished, the events wait until after that note
+    // has been played. They're still dispatched in order, just a little later.
+    if (m_next < m_end && (long)(startOf(*m_next) - now) < (long)m_callbacks.largestBudget()) {
+      return;
+    }
+    m_callbacks.dispatch(m_pendingEvents[m_firstEvent]);
+    m_firstEvent = (m_firstEvent + 1) % MAX_PENDING_EVENTS;
+    m_eventCount--;
+    now = micros();
+  }
+}
+
+template <typename Backend>
+bool MelodyPlayer<Backend>::task(void* context, unsigned long now, unsigned long& nextRun) {
+  // static_cast converts the untyped pointer back into the type we know it really points to.
+  return static_cast<MelodyPlayer<Backend>*>(context)->update(now, nextRun);
+}
@@ -0,0 +1,69 @@
+/// Defines a pool of notes shared by a whole library of songs, and a source that plays a song out of it.
+
+// See note.hpp for an explanation of header guards.
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include "note.hpp"
+
+// Songs borrow from each other: the same jingle ends several of them, two arrangements of one tune share most of their
+// bars, and scales and arpeggios come up everywhere. Each Melody stores all of its own notes, so a run that's in five
+// songs takes up memory five times. A PhraseMelody (see phrase.hpp) only finds the repeats inside one song.
+//
+// A note pool is one array of notes for every song in the library, with each shared run stored once. A song is then
+// just a list of segments: "play 12 notes of the pool starting at note 40, with the first one 8 seconds into the song".
+// The offsets of the notes in the pool are from whichever song added them to it, so only the time between them
+// matters: a note plays at the start of its segment plus how long after the segment's first note it comes in the pool.
+//
+// melody_creator builds the pool from every song in a C++ file, finding the shared runs with a suffix array, and
+// reports how many bytes the whole library saves (see melody_creator/melody_creator/pool.py).
+
+// Like PhraseMelody (see phrase.hpp), these are aggregates, so they can be written as lists in braces.
+/// Some notes of a song, played from a note pool.
+struct PoolSegment {
+  /// The position in the pool of the first note.
+  uint16_t first;
+  /// The number of notes.
+  uint16_t count;
+  /// When the first note starts, in 256ths of a millisecond from the start of the song (see Note::m_offset).
+  uint32_t start;
+};
+
+/// A melody stored as segments of a note pool.
+struct PooledMelody {
+  /// The pool, which other melodies share.
+  const Note* pool;
+  /// The segments of this melody, in order.
+  const PoolSegment* segments;
+  /// The number of segments.
+  uint16_t segmentCount;
+};
+
+/// Plays the segments of a PooledMelody in order, one note at a time. Can be used as a source for StreamPlayer (see
+/// stream_player.hpp).
+struct PoolStream {
+
+  /// Constructs a stream that plays the given melody from the beginning.
+  explicit PoolStream(const PooledMelody& melody);
+
+  /// Goes back to the beginning of the melody.
+  void rewind();
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  const PooledMelody& m_melody;
+  // The position in m_melody.segments of the next segment.
+  uint16_t m_segment;
+  // The position in the pool of the next note of the current segment, and how many of its notes are left.
+  uint16_t m_note;
+  uint16_t m_remaining;
+  // How much to add to the offset of a note in the pool to get its offset in the song, in 256ths of a millisecond.
+  // Adding it wraps around like any unsigned number, so it works when the note is earlier in the song than in the pool.
+  unsigned long m_shift;
+
+};
+
+#endif /* POOL_HPP */
@@ -0,0 +1,32 @@
+// Implementations for the things declared in pool.hpp. See melody.ino for an explanation of why they're separated.
+#include "pool.hpp"
+
+PoolStream::PoolStream(const PooledMelody& melody)
+  : m_melody(melody), m_segment(0), m_note(0), m_remaining(0), m_shift(0) {
+  rewind();
+}
+
+void PoolStream::rewind() {
+  m_segment = 0;
+  m_remaining = 0;
+}
+
+bool PoolStream::next(Note& note) {
+  // melody_creator never writes empty segments, but a loop (rather than an if) skips them anyway.
+  while (m_remaining == 0) {
+    if (m_segment == m_melody.segmentCount) {
+      return false;
+    }
+    const PoolSegment& segment = m_melody.segments[m_segment++];
+    m_note = segment.first;
+    m_remaining = segment.count;
+    if (m_remaining > 0) {
+      m_shift = segment.start - m_melody.pool[segment.first].fixedPointOffset();
+    }
+  }
+
+  const Note& pooled = m_melody.pool[m_note++];
+  m_remaining--;
+  note = Note(FixedPointOffset(), pooled.frequency(), pooled.fixedPointOffset() + m_shift, pooled.duration());
+  return true;
+}
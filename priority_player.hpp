@@ -0,0 +1,140 @@
+/// Defines a player that mixes several melodies on one buzzer, letting more important ones (like alerts) interrupt
+/// less important ones (like background music).
+
+// See note.hpp for an explanation of header guards.
+#ifndef PRIORITY_PLAYER_HPP
+#define PRIORITY_PLAYER_HPP
+
+#include "backend.hpp"
+#include "melody.hpp"
+
+/// A note event in an EventQueue: the source with the given index has a note that starts at the given time.
+struct QueuedEvent {
+  /// When the note starts, in microseconds (like micros()).
+  unsigned long time;
+  /// The index of the source the note belongs to.
+  uint8_t source;
+};
+
+// A heap is a way of arranging items in an array so that the smallest one is always at the front, without keeping the
+// whole array sorted. Think of the array as a tree: the item at position i has "children" at positions 2i + 1 and
+// 2i + 2, and every item is smaller than (or equal to) its children. Adding or removing an item only needs to fix up
+// one path from the top of the tree to the bottom, which takes about log2(Capacity) steps instead of the Capacity steps
+// insertion into a sorted array would need.
+// See https://en.wikipedia.org/wiki/Binary_heap for pictures.
+/// A fixed-capacity min-heap of events ordered by time. It never allocates memory.
+template <size_t Capacity>
+struct EventQueue {
+
+  /// Constructs an empty queue.
+  EventQueue() : m_size(0) {}
+
+  /// Returns true if there are no events in the queue.
+  bool isEmpty() const { return m_size == 0; }
+
+  /// Returns the event with the earliest time. Only valid when the queue isn't empty.
+  const QueuedEvent& top() const { return m_events[0]; }
+
+  /// Adds an event. Returns false if the queue is full.
+  bool push(const QueuedEvent& event);
+
+  /// Removes the event with the earliest time. Only valid when the queue isn't empty.
+  void pop() { removeAt(0); }
+
+  /// Removes the event of the given source, if there is one.
+  void removeSource(uint8_t source);
+
+private:
+
+  // Removes the event at the given position and restores the heap order.
+  void removeAt(size_t index);
+
+  // Move the event at the given position up or down the tree until it's in the right place.
+  void siftUp(size_t index);
+  void siftDown(size_t index);
+
+  QueuedEvent m_events[Capacity];
+  size_t m_size;
+
+};
+
+/// Returned by PriorityPlayer::addSource() when there's no room for another source.
+const uint8_t NO_SOURCE = 0xFF;
+
+// Every source is a melody with a priority. All sources keep running on their own timelines, but only the sounding
+// note of the highest-priority source is heard. When an alert (a high-priority source) finishes, the background music
+// picks up with whichever note it would be playing at that moment, for however much of that note is left, so it stays
+// exactly in time as if it had never been interrupted.
+//
+// Merging the sources relies on every Melody<N> being sorted by offset. Because each source's notes are
+// already in order, the next note of a source can never come before its current one, so the queue only ever needs to
+// hold one event per source: its next note. When that note is taken out of the queue, the note after it is put in.
+// This is known as a k-way merge, and it's why the queue's capacity is simply the number of sources.
+//
+// The notes are played on a backend (see backend.hpp), which is tone() unless another one is given.
+/// Plays up to MaxSources melodies on one buzzer, where higher-priority sources preempt lower-priority ones.
+template <size_t MaxSources, typename Backend = ToneBackend>
+struct PriorityPlayer {
+
+  // A pin number works as the backend too, since it turns into a ToneBackend by itself.
+  /// Constructs a new player that plays notes on (a copy of) the given backend.
+  explicit PriorityPlayer(const Backend& backend);
+
+  /// Adds a melody with the given priority (higher numbers win). Looping sources start over after they end. The source
+  /// is silent until play() is called. Returns an index for the source, or NO_SOURCE if there's no room.
+  template <size_t N>
+  uint8_t addSource(const Melody<N>& melody, uint8_t priority, bool looping) {
+    return addSource(melody.cbegin(), melody.cend(), priority, looping);
+  }
+
+  /// Adds the sorted notes in [first, last) as a source. See the other overload.
+  uint8_t addSource(const Note* first, const Note* last, uint8_t priority, bool looping);
+
+  /// (Re)starts the given source from the beginning so that offset 0 is at the given time (in microseconds).
+  void play(uint8_t source, unsigned long now);
+
+  /// Silences the given source.
+  void stop(uint8_t source);
+
+  /// Plays every note that is due at the given time. Always returns true and stores the time at which it next needs to
+  /// be called in nextEvent, so that sources started later with play() are picked up.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  /// Task adapter for Scheduler (see scheduler.hpp): context must point to a PriorityPlayer<MaxSources, Backend>.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+private:
+
+  struct Source {
+    const Note* first;
+    const Note* last;
+    // The next note to start, and the note that's currently sounding (nullptr if none).
+    const Note* next;
+    const Note* sounding;
+    // The time offset 0 corresponds to, and when the sounding note ends (both in microseconds).
+    unsigned long startTime;
+    unsigned long soundingEnd;
+    // How long one pass through the melody takes, in microseconds. Looping sources restart this long after starting.
+    unsigned long length;
+    uint8_t priority;
+    bool looping;
+    bool active;
+  };
+
+  // Puts the next note of the given source into the queue, restarting it first if it's looping and has run out.
+  void queueNext(uint8_t source);
+
+  // When nothing is queued or sounding, update() asks to be called again after this many microseconds.
+  static const unsigned long IDLE_INTERVAL = 10000UL;
+
+  Backend m_backend;
+  Source m_sources[MaxSources];
+  size_t m_sourceCount;
+  EventQueue<MaxSources> m_queue;
+  // Which source is being heard, and which of its notes. NO_SOURCE and nullptr when the buzzer is silent.
+  uint8_t m_owner;
+  const Note* m_ownerNote;
+
+};
+
+#endif /* PRIORITY_PLAYER_HPP */
@@ -0,0 +1,187 @@
+// Implementations for the things declared in priority_player.hpp. See melody.ino for an explanation of why they're
+// separated.
+#include "priority_player.hpp"
+
+// See player.ino for why times are compared by subtracting them and reading the result as a signed number.
+/// Returns true if time a comes before time b.
+inline bool isEarlier(unsigned long a, unsigned long b) { return (long)(a - b) < 0; }
+
+template <size_t Capacity>
+bool EventQueue<Capacity>::push(const QueuedEvent& event) {
+  if (m_size >= Capacity) {
+    return false;
+  }
+  // The new event goes at the bottom of the tree and then climbs up to where it belongs.
+  m_events[m_size] = event;
+  siftUp(m_size);
+  m_size++;
+  return true;
+}
+
+template <size_t Capacity>
+void EventQueue<Capacity>::removeSource(uint8_t source) {
+  for (size_t i = 0; i < m_size; i++) {
+    if (m_events[i].source == source) {
+      removeAt(i);
+      return;
+    }
+  }
+}
+
+template <size_t Capacity>
+void EventQueue<Capacity>::removeAt(size_t index) {
+  // The last event fills the hole. It might be too big or too small for its new spot, so it's moved both ways (only one
+  // of the two will actually move it).
+  m_size--;
+  if (index < m_size) {
+    m_events[index] = m_events[m_size];
+    siftUp(index);
+    siftDown(index);
+  }
+}
+
+template <size_t Capacity>
+void EventQueue<Capacity>::siftUp(size_t index) {
+  while (index > 0) {
+    size_t parent = (index - 1) / 2;
+    if (!isEarlier(m_events[index].time, m_events[parent].time)) {
+      return;
+    }
+    // swap() is defined in melody.ino.
+    swap(m_events[index], m_events[parent]);
+    index = parent;
+  }
+}
+
+template <size_t Capacity>
+void EventQueue<Capacity>::siftDown(size_t index) {
+  while (true) {
+    size_t earliest = index;
+    size_t left = 2 * index + 1;
+    size_t right = left + 1;
+    if (left < m_size && isEarlier(m_events[left].time, m_events[earliest].time)) {
+      earliest = left;
+    }
+    if (right < m_size && isEarlier(m_events[right].time, m_events[earliest].time)) {
+      earliest = right;
+    }
+    if (earliest == index) {
+      return;
+    }
+    swap(m_events[index], m_events[earliest]);
+    index = earliest;
+  }
+}
+
+template <size_t MaxSources, typename Backend>
+PriorityPlayer<MaxSources, Backend>::PriorityPlayer(const Backend& backend)
+  : m_backend(backend), m_sourceCount(0), m_owner(NO_SOURCE), m_ownerNote(nullptr) {}
+
+template <size_t MaxSources, typename Backend>
+uint8_t PriorityPlayer<MaxSources, Backend>::addSource(const Note* first, const Note* last, uint8_t priority,
+                                                     bool looping) {
+  if (m_sourceCount >= MaxSources) {
+    return NO_SOURCE;
+  }
+  unsigned long length = 0;
+  for (const Note* note = first; note < last; note++) {
+    if (note->endMicros() > length) {
+      length = note->endMicros();
+    }
+  }
+  // A looping melody with no length would restart forever without ever moving forward in time.
+  if (length == 0) {
+    looping = false;
+  }
+  m_sources[m_sourceCount] = Source{first, last, last, nullptr, 0, 0, length, priority, looping, false};
+  return m_sourceCount++;
+}
+
+template <size_t MaxSources, typename Backend>
+void PriorityPlayer<MaxSources, Backend>::play(uint8_t source, unsigned long now) {
+  Source& s = m_sources[source];
+  m_queue.removeSource(source);
+  s.next = s.first;
+  s.sounding = nullptr;
+  s.startTime = now;
+  s.active = true;
+  queueNext(source);
+}
+
+template <size_t MaxSources, typename Backend>
+void PriorityPlayer<MaxSources, Backend>::stop(uint8_t source) {
+  m_queue.removeSource(source);
+  m_sources[source].active = false;
+  m_sources[source].sounding = nullptr;
+}
+
+template <size_t MaxSources, typename Backend>
+void PriorityPlayer<MaxSources, Backend>::queueNext(uint8_t source) {
+  Source& s = m_sources[source];
+  if (s.next >= s.last && s.looping) {
+    s.next = s.first;
+    s.startTime += s.length;
+  }
+  if (s.next < s.last) {
+    m_queue.push(QueuedEvent{s.startTime + s.next->offsetMicros(), source});
+  }
+}
+
+template <size_t MaxSources, typename Backend>
+bool PriorityPlayer<MaxSources, Backend>::update(unsigned long now, unsigned long& nextEvent) {
+  // First, let every source catch up to the current time. Sources that are being drowned out still move through their
+  // notes; they just aren't heard.
+  while (!m_queue.isEmpty() && !isEarlier(now, m_queue.top().time)) {
+    uint8_t source = m_queue.top().source;
+    m_queue.pop();
+    Source& s = m_sources[source];
+    s.sounding = s.next;
+    s.soundingEnd = s.startTime + s.next->endMicros();
+    s.next++;
+    queueNext(source);
+  }
+
+  // Then decide who gets the buzzer: the highest-priority source with a note that's still sounding.
+  uint8_t owner = NO_SOURCE;
+  for (size_t i = 0; i < m_sourceCount; i++) {
+    Source& s = m_sources[i];
+    if (s.active && s.sounding != nullptr && !isEarlier(now, s.soundingEnd)) {
+      s.sounding = nullptr;
+    }
+    if (s.active && s.sounding != nullptr && (owner == NO_SOURCE || s.priority > m_sources[owner].priority)) {
+      owner = i;
+    }
+  }
+
+  // Only touch the buzzer if what should be heard has changed. A resumed note is played for whatever is left of it,
+  // which is what keeps it in sync with its melody. A duration of 0 would play it until stop(), so a note with less
+  // than a millisecond left is played for one instead.
+  const Note* ownerNote = owner == NO_SOURCE ? nullptr : m_sources[owner].sounding;
+  if (owner != m_owner || ownerNote != m_ownerNote) {
+    if (ownerNote == nullptr) {
+      m_backend.stop();
+    } else {
+      unsigned long left = (m_sources[owner].soundingEnd - now) / 1000UL;
+      m_backend.play(ownerNote->frequency(), left > 0 ? left : 1);
+    }
+    m_owner = owner;
+    m_ownerNote = ownerNote;
+  }
+
+  // The next thing that can change what's heard is either the next note of any source or the end of a sounding note.
+  nextEvent = now + IDLE_INTERVAL;
+  if (!m_queue.isEmpty() && isEarlier(m_queue.top().time, nextEvent)) {
+    nextEvent = m_queue.top().time;
+  }
+  for (size_t i = 0; i < m_sourceCount; i++) {
+    if (m_sources[i].active && m_sources[i].sounding != nullptr && isEarlier(m_sources[i].soundingEnd, nextEvent)) {
+      nextEvent = m_sources[i].soundingEnd;
+    }
+  }
+  return true;
+}
+
+template <size_t MaxSources, typename Backend>
+bool PriorityPlayer<MaxSources, Backend>::task(void* context, unsigned long now, unsigned long& nextRun) {
+  return static_cast<PriorityPlayer<MaxSources, Backend>*>(context)->update(now, nextRun);
+}
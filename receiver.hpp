@@ -0,0 +1,173 @@
+/// Defines a receiver that plays a melody while it is still being uploaded over Serial.
+
+// See note.hpp for an explanation of header guards.
+#ifndef RECEIVER_HPP
+#define RECEIVER_HPP
+
+#include "backend.hpp"
+#include "note.hpp"
+
+// THE UPLOAD PROTOCOL
+//
+// Melodies are sent as frames. Every frame looks like this (all numbers are little-endian, meaning the lowest byte
+// comes first):
+//
+//   0x7E | type | length | payload (length bytes) | checksum (2 bytes)
+//
+// The first byte (the "sync" byte) marks the start of a frame. The checksum is a Fletcher-16 checksum of the type,
+// length, and payload bytes (see receiver.ino). If even one of those bytes gets garbled, the checksum almost certainly
+// won't match and the frame is rejected instead of playing a wrong note.
+//
+// The computer sends these frames, each of which starts with a sequence number (0-255, wrapping around) so that a
+// frame that's sent twice is only used once:
+//
+//   BEGIN  0x01: sequence                   A new melody is coming. Anything playing is stopped.
+//   NOTES  0x02: sequence, notes...         Up to 8 notes of 8 bytes each: frequency (2 bytes), offset (4 bytes),
+//                                           and duration (2 bytes), sorted by offset.
+//   END    0x03: sequence                   There are no more notes.
+//
+// The Arduino answers every frame with one of these:
+//
+//   ACK    0x81: sequence, free             The frame was accepted. free is the number of notes there's room for.
+//   NAK    0x82: sequence, free             The frame was rejected and should be sent again.
+//
+// Flow control: the computer only ever sends as many notes as the last ACK said there's room for. When the computer
+// has to stop because there's no room, the Arduino sends another ACK (with the same sequence number) as soon as there
+// is room for a full frame again. At 9600 baud a full frame of 8 notes takes about 75 ms to send, while 8 notes usually
+// take seconds to play, so one frame at a time is plenty to stay ahead of the music.
+//
+// melody_creator/melody_creator/upload.py is the computer's side of this protocol.
+
+const uint8_t UPLOAD_SYNC = 0x7E;
+const uint8_t UPLOAD_BEGIN = 0x01;
+const uint8_t UPLOAD_NOTES = 0x02;
+const uint8_t UPLOAD_END = 0x03;
+const uint8_t UPLOAD_ACK = 0x81;
+const uint8_t UPLOAD_NAK = 0x82;
+
+/// The number of bytes a note takes up in a NOTES frame.
+const size_t UPLOAD_NOTE_SIZE = 8;
+/// The largest number of notes in a NOTES frame.
+const size_t UPLOAD_MAX_NOTES = 8;
+
+// A ring buffer is an array used as a queue: notes are added at the back and removed from the front, and positions
+// wrap around to 0 after the end of the array, so notes never need to be moved. See player.hpp for another one.
+/// A fixed-capacity queue of notes.
+template <size_t Capacity>
+struct NoteRing {
+
+  NoteRing() : m_first(0), m_count(0) {}
+
+  size_t count() const { return m_count; }
+  size_t space() const { return Capacity - m_count; }
+  bool isEmpty() const { return m_count == 0; }
+  void clear() { m_count = 0; }
+
+  /// Returns the oldest note. Only valid when the ring isn't empty.
+  const Note& front() const { return m_notes[m_first]; }
+
+  /// Removes the oldest note. Only valid when the ring isn't empty.
+  void pop() {
+    m_first = (m_first + 1) % Capacity;
+    m_count--;
+  }
+
+  /// Adds a note at the back. Returns false if the ring is full.
+  bool push(const Note& note) {
+    if (m_count >= Capacity) {
+      return false;
+    }
+    m_notes[(m_first + m_count) % Capacity] = note;
+    m_count++;
+    return true;
+  }
+
+private:
+
+  Note m_notes[Capacity];
+  size_t m_first;
+  size_t m_count;
+
+};
+
+// Playback starts after this many notes have arrived (or after END, for shorter melodies), which gives the upload a
+// head start without having to wait for the whole melody.
+/// The number of notes buffered before playback starts.
+const size_t UPLOAD_PREBUFFER_NOTES = 4;
+
+// Capacity must be at least UPLOAD_MAX_NOTES, otherwise a full NOTES frame would never fit.
+// The notes are played on a backend (see backend.hpp), which is tone() unless another one is given.
+/// Receives melodies over a serial connection and plays them as they arrive, buffering up to Capacity notes.
+template <size_t Capacity, typename Backend = ToneBackend>
+struct MelodyReceiver {
+
+  // Stream is the Arduino type that Serial (and other serial ports) belong to, so any of them can be used. A pin number
+  // works as the backend too, since it turns into a ToneBackend by itself.
+  /// Constructs a receiver that reads frames from the given stream and plays notes on (a copy of) the given backend.
+  MelodyReceiver(Stream& stream, const Backend& backend);
+
+  /// Reads any bytes that have arrived and plays any note that's due. Always returns true and stores the time (in
+  /// microseconds) at which it next needs to be called in nextEvent.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  /// Returns true while a melody is playing.
+  bool isPlaying() const { return m_playing; }
+
+  /// Returns the number of frames rejected because of a bad checksum or because they didn't fit.
+  unsigned long rejectedFrames() const { return m_rejectedFrames; }
+
+  /// Returns the number of notes that hadn't arrived yet by the time they were due, so playback had to wait for them.
+  unsigned long underruns() const { return m_underruns; }
+
+  /// Task adapter for Scheduler (see scheduler.hpp): context must point to a MelodyReceiver<Capacity, Backend>.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+private:
+
+  // The parser reads one byte at a time, and these are the parts of a frame it can be waiting for. This pattern is
+  // called a state machine.
+  enum ParseState : uint8_t { WAIT_SYNC, READ_TYPE, READ_LENGTH, READ_PAYLOAD, READ_CHECKSUM_1, READ_CHECKSUM_2 };
+
+  // Feeds one received byte to the parser.
+  void receive(uint8_t byte);
+  // Acts on a frame whose checksum matched. Returns false if the frame should be rejected.
+  bool handleFrame();
+  // Sends an ACK or NAK frame.
+  void reply(uint8_t type, uint8_t sequence);
+  // Plays the front note if it's due.
+  void play(unsigned long now);
+
+  Stream& m_stream;
+  Backend m_backend;
+
+  ParseState m_state;
+  uint8_t m_type;
+  uint8_t m_length;
+  uint8_t m_received;
+  uint8_t m_payload[1 + UPLOAD_MAX_NOTES * UPLOAD_NOTE_SIZE];
+  uint8_t m_checksum1;
+  uint8_t m_sum1;
+  uint8_t m_sum2;
+  // The sequence number of the last accepted frame, so that a repeated frame can be recognized.
+  uint8_t m_lastSequence;
+  bool m_hasLastSequence;
+  // True when the last ACK told the computer there wasn't room for a full frame.
+  bool m_senderWaiting;
+
+  NoteRing<Capacity> m_notes;
+  bool m_receiving;
+  bool m_ended;
+  bool m_playing;
+  // The time offset 0 of the melody corresponds to, in microseconds.
+  unsigned long m_startTime;
+  // True when playback ran out of notes before the melody ended, and the last time (from micros()) there were none.
+  bool m_starved;
+  unsigned long m_lastEmpty;
+  // The latest end (see endMicros() in note.hpp) of the notes played so far, in microseconds from the start.
+  unsigned long m_lastEnd;
+  unsigned long m_rejectedFrames;
+  unsigned long m_underruns;
+
+};
+
+#endif /* RECEIVER_HPP */
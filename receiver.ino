@@ -0,0 +1,213 @@
+// Implementations for the things declared in receiver.hpp. See melody.ino for an explanation of why they're
+// separated.
+#include "receiver.hpp"
+
+// The serial hardware can hold 64 bytes on its own, which takes about 66 ms to fill at 9600 baud, so checking for new
+// bytes every few milliseconds is more than enough.
+/// How often (in microseconds) the receiver checks for new bytes when it has nothing else to do.
+const unsigned long RECEIVE_POLL_INTERVAL = 5000UL;
+
+template <size_t Capacity, typename Backend>
+MelodyReceiver<Capacity, Backend>::MelodyReceiver(Stream& stream, const Backend& backend)
+  : m_stream(stream), m_backend(backend), m_state(WAIT_SYNC), m_type(0), m_length(0), m_received(0),
+    m_checksum1(0), m_sum1(0), m_sum2(0), m_lastSequence(0), m_hasLastSequence(false), m_senderWaiting(false),
+    m_receiving(false), m_ended(false), m_playing(false), m_startTime(0), m_starved(false), m_lastEmpty(0),
+    m_lastEnd(0), m_rejectedFrames(0), m_underruns(0) {}
+
+template <size_t Capacity, typename Backend>
+bool MelodyReceiver<Capacity, Backend>::update(unsigned long now, unsigned long& nextEvent) {
+  while (m_stream.available() > 0) {
+    receive(m_stream.read());
+  }
+
+  // Playback starts as soon as enough notes have arrived, long before the whole melody has.
+  if (!m_playing && !m_notes.isEmpty() && (m_notes.count() >= UPLOAD_PREBUFFER_NOTES || m_ended)) {
+    m_playing = true;
+    m_starved = false;
+    m_lastEnd = 0;
+    m_startTime = now;
+  }
+  play(now);
+
+  nextEvent = now + RECEIVE_POLL_INTERVAL;
+  if (m_playing && !m_notes.isEmpty()) {
+    unsigned long due = m_startTime + m_notes.front().offsetMicros();
+    if ((long)(due - nextEvent) < 0) {
+      nextEvent = due;
+    }
+  }
+  return true;
+}
+
+template <size_t Capacity, typename Backend>
+void MelodyReceiver<Capacity, Backend>::play(unsigned long now) {
+  if (!m_playing) {
+    return;
+  }
+  if (m_notes.isEmpty()) {
+    if (!m_ended) {
+      // The next note hasn't arrived yet. That's only a problem if it's due before it arrives, which play() finds out
+      // once it has.
+      m_starved = true;
+      m_lastEmpty = now;
+    } else if ((long)(now - (m_startTime + m_lastEnd)) >= 0) {
+      m_backend.stop();
+      m_playing = false;
+      m_receiving = false;
+    }
+    return;
+  }
+
+  const Note& note = m_notes.front();
+  long late = (long)(now - (m_startTime + note.offsetMicros()));
+  if (late < 0) {
+    return;
+  }
+  if (m_starved) {
+    // If the note was already due while there were no notes, it arrived after it should have been played. Rather than
+    // rushing through the rest of the melody to catch up, the whole melody is shifted later by however late this note
+    // is, so the rhythm stays intact. A note that arrived before it was due is simply on time, however briefly the
+    // ring was empty, so the melody isn't shifted by how long it took to get to it.
+    if ((long)(m_lastEmpty - (m_startTime + note.offsetMicros())) >= 0) {
+      m_startTime += late;
+      m_underruns++;
+    }
+    m_starved = false;
+  }
+  m_backend.play(note.frequency(), note.duration());
+  if (note.endMicros() > m_lastEnd) {
+    m_lastEnd = note.endMicros();
+  }
+  m_notes.pop();
+
+  // Tell the computer it can send more as soon as there's room for a full frame again.
+  if (m_senderWaiting && m_notes.space() >= UPLOAD_MAX_NOTES) {
+    m_senderWaiting = false;
+    reply(UPLOAD_ACK, m_lastSequence);
+  }
+}
+
+template <size_t Capacity, typename Backend>
+void MelodyReceiver<Capacity, Backend>::receive(uint8_t byte) {
+  // Fletcher-16 keeps two running sums. The first is the sum of all bytes and the second is the sum of the first sum
+  // after each byte, so swapped bytes change the second sum even though they don't change the first. Both wrap around
+  // at 255. See https://en.wikipedia.org/wiki/Fletcher%27s_checksum
+  if (m_state != WAIT_SYNC && m_state != READ_CHECKSUM_1 && m_state != READ_CHECKSUM_2) {
+    m_sum1 = (m_sum1 + byte) % 255;
+    m_sum2 = (m_sum2 + m_sum1) % 255;
+  }
+
+  // A switch statement jumps to the case that matches the value in parentheses. The break at the end of each case
+  // prevents it from continuing on into the next one.
+  switch (m_state) {
+    case WAIT_SYNC:
+      // Anything other than the sync byte (like the rest of a garbled frame) is skipped.
+      if (byte == UPLOAD_SYNC) {
+        m_sum1 = 0;
+        m_sum2 = 0;
+        m_state = READ_TYPE;
+      }
+      break;
+    case READ_TYPE:
+      m_type = byte;
+      m_state = READ_LENGTH;
+      break;
+    case READ_LENGTH:
+      m_length = byte;
+      m_received = 0;
+      if (m_length > sizeof(m_payload)) {
+        m_rejectedFrames++;
+        m_state = WAIT_SYNC;
+      } else {
+        m_state = m_length > 0 ? READ_PAYLOAD : READ_CHECKSUM_1;
+      }
+      break;
+    case READ_PAYLOAD:
+      m_payload[m_received++] = byte;
+      if (m_received == m_length) {
+        m_state = READ_CHECKSUM_1;
+      }
+      break;
+    case READ_CHECKSUM_1:
+      m_checksum1 = byte;
+      m_state = READ_CHECKSUM_2;
+      break;
+    case READ_CHECKSUM_2:
+      m_state = WAIT_SYNC;
+      if (m_checksum1 != m_sum1 || byte != m_sum2 || !handleFrame()) {
+        m_rejectedFrames++;
+        reply(UPLOAD_NAK, m_length > 0 ? m_payload[0] : 0);
+      }
+      break;
+  }
+}
+
+template <size_t Capacity, typename Backend>
+bool MelodyReceiver<Capacity, Backend>::handleFrame() {
+  if (m_length < 1) {
+    return false;
+  }
+  uint8_t sequence = m_payload[0];
+
+  if (m_type == UPLOAD_BEGIN) {
+    // A new melody replaces whatever was playing. BEGIN is always acted on (even if its sequence number matches the
+    // last frame) because it's always the first frame of an upload.
+    if (m_playing) {
+      m_backend.stop();
+    }
+    m_notes.clear();
+    m_receiving = true;
+    m_ended = false;
+    m_playing = false;
+  } else if (m_hasLastSequence && sequence == m_lastSequence) {
+    // The computer didn't get our ACK and sent the same frame again. It has already been used, so just ACK again.
+  } else if (m_type == UPLOAD_NOTES && m_receiving && !m_ended) {
+    size_t count = (m_length - 1) / UPLOAD_NOTE_SIZE;
+    if ((m_length - 1) % UPLOAD_NOTE_SIZE != 0 || count > m_notes.space()) {
+      return false;
+    }
+    const uint8_t* bytes = m_payload + 1;
+    for (size_t i = 0; i < count; i++, bytes += UPLOAD_NOTE_SIZE) {
+      // Little-endian numbers are put back together by shifting each byte into place and combining them with |. The
+      // casts make sure the shifts happen on numbers large enough to hold the result.
+      uint16_t frequency = bytes[0] | (uint16_t)bytes[1] << 8;
+      unsigned long offset = bytes[2] | (unsigned long)bytes[3] << 8 | (unsigned long)bytes[4] << 16
+                             | (unsigned long)bytes[5] << 24;
+      uint16_t duration = bytes[6] | (uint16_t)bytes[7] << 8;
+      m_notes.push(Note(frequency, offset, duration));
+    }
+  } else if (m_type == UPLOAD_END && m_receiving) {
+    m_ended = true;
+  } else {
+    return false;
+  }
+
+  m_lastSequence = sequence;
+  m_hasLastSequence = true;
+  reply(UPLOAD_ACK, sequence);
+  return true;
+}
+
+template <size_t Capacity, typename Backend>
+void MelodyReceiver<Capacity, Backend>::reply(uint8_t type, uint8_t sequence) {
+  // There's no point saying there's room for more notes than a byte can hold.
+  uint8_t space = m_notes.space() > 255 ? 255 : m_notes.space();
+  if (type == UPLOAD_ACK && !m_ended && space < UPLOAD_MAX_NOTES) {
+    m_senderWaiting = true;
+  }
+  uint8_t frame[] = {UPLOAD_SYNC, type, 2, sequence, space, 0, 0};
+  uint8_t sum1 = 0;
+  uint8_t sum2 = 0;
+  for (size_t i = 1; i < 5; i++) {
+    sum1 = (sum1 + frame[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  frame[5] = sum1;
+  frame[6] = sum2;
+  m_stream.write(frame, sizeof(frame));
+}
+
+template <size_t Capacity, typename Backend>
+bool MelodyReceiver<Capacity, Backend>::task(void* context, unsigned long now, unsigned long& nextRun) {
+  return static_cast<MelodyReceiver<Capacity, Backend>*>(context)->update(now, nextRun);
+}
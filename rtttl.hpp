@@ -0,0 +1,268 @@
+/// Defines a parser that turns RTTTL ringtone text into a Melody while the program compiles.
+
+// See note.hpp for an explanation of header guards.
+#ifndef RTTTL_HPP
+#define RTTTL_HPP
+
+#include "melody.hpp"
+#include "pitches.hpp"
+
+// RTTTL (Ring Tone Text Transfer Language) is how old mobile phones stored ringtones, and thousands of songs can still
+// be found written in it. A ringtone is a name, some default settings, and a list of notes, separated by colons:
+//
+//   tetris:d=4,o=5,b=160:e6,8b,8c6,8d6,16e6,16d6,8c6,8b,a,8a,8c6,e6,8d6,8c6,b,8b,8c6,d6,e6,c6,a,2a
+//
+// The settings are the default duration (d, 4 meaning a quarter note), the default octave (o), and the tempo in beats
+// (quarter notes) per minute (b). Each note is an optional duration (1, 2, 4, 8, 16, 32 or 64 for whole, half,
+// quarter... notes), a letter from a to g (or p for a pause), an optional # for sharp, an optional octave (middle C is
+// c4), and an optional . that makes it half as long again. Anything left out uses the default.
+//
+// Everything below is constexpr, so when a melody is made with RTTTL_MELODY() and stored in a constexpr variable, the
+// compiler reads the text and works out every note while compiling. The Arduino only gets the finished notes, laid out
+// exactly like a melody written out note by note in songs.hpp: none of this code or the text ends up in its memory.
+//
+// In the version of C++ the Arduino IDE uses, a constexpr function may only contain a single return statement, so
+// there are no loops or variables here. Loops are done with recursion (a function calling itself with the next
+// position) and ifs with the ?: operator ("a ? b : c" is b if a is true and c otherwise). The compiler gives up after
+// 512 nested calls, and every note or pause adds one, so a ringtone can have up to about 500 of them.
+
+/// How long each note sounds, as a percentage of its length. The rest of its length is silent, so that repeated notes
+/// can be told apart (like the articulation used by melody_creator).
+const uint8_t RTTTL_ARTICULATION = 90;
+
+// If the text has a mistake, the parser calls one of these functions. Calling a function that isn't constexpr while
+// compiling is an error, so the compiler stops and prints something like "call to non-constexpr function
+// 'size_t rtttlErrorUnknownNoteLetter()'", which says what's wrong. They're never defined because they're never
+// actually called.
+size_t rtttlErrorMissingColon();
+size_t rtttlErrorMissingEquals();
+size_t rtttlErrorZeroTempo();
+size_t rtttlErrorInvalidDuration();
+size_t rtttlErrorUnknownNoteLetter();
+size_t rtttlErrorUnexpectedCharacter();
+size_t rtttlErrorPitchOutOfRange();
+size_t rtttlErrorNoteTooLong();
+size_t rtttlErrorMelodyTooLong();
+
+// Positions in the text are indexes into it (text[position] is the character there).
+/// The notes of an RTTTL ringtone, read from the text while compiling.
+class RtttlNotes {
+
+public:
+
+  /// Reads the name and the default settings of the given ringtone.
+  constexpr explicit RtttlNotes(const char* text)
+      : m_text(text),
+        m_notesStart(skipSpaces(text, colonAfter(text, colonAfter(text, 0) + 1) + 1)),
+        m_duration(setting(text, colonAfter(text, 0) + 1, 'd', 4)),
+        m_octave(setting(text, colonAfter(text, 0) + 1, 'o', 6)),
+        m_tempo(nonZero(setting(text, colonAfter(text, 0) + 1, 'b', 63))) {}
+
+  /// Returns the number of notes (not counting pauses).
+  constexpr size_t count() const { return countFrom(m_notesStart); }
+
+  /// Where the parser is in the text: the position of a note, and the time (in 128ths of a whole note) it starts at.
+  struct Place {
+    size_t position;
+    unsigned long long start;
+  };
+
+  /// Returns the place of the first note.
+  constexpr Place first() const { return skipPauses(Place{m_notesStart, 0}); }
+  /// Returns the place of the note after the one at place.
+  constexpr Place after(Place place) const {
+    return skipPauses(Place{item(place.position).next, place.start + item(place.position).length});
+  }
+  /// Returns the note at place.
+  constexpr Note noteAt(Place place) const {
+    return Note(FixedPointOffset(), pitchFrequency(item(place.position).pitch), offsetAt(place.start),
+                soundingTime(item(place.position).length));
+  }
+
+private:
+
+  // Functions for reading any text.
+
+  static constexpr bool isDigit(char c) { return c >= '0' && c <= '9'; }
+  static constexpr char lower(char c) { return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c; }
+  static constexpr size_t skipSpaces(const char* text, size_t position) {
+    return text[position] == ' ' ? skipSpaces(text, position + 1) : position;
+  }
+  // Returns the position just past the digits starting at position.
+  static constexpr size_t numberEnd(const char* text, size_t position) {
+    return isDigit(text[position]) ? numberEnd(text, position + 1) : position;
+  }
+  // Reads the number starting at position. value is the number made of the digits before it.
+  static constexpr size_t readNumber(const char* text, size_t position, size_t value = 0) {
+    return isDigit(text[position]) ? readNumber(text, position + 1, value * 10 + text[position] - '0') : value;
+  }
+  // Returns the position of the first comma or colon at or after position, or of the end of the text.
+  static constexpr size_t separatorAfter(const char* text, size_t position) {
+    return text[position] == ',' || text[position] == ':' || text[position] == '\0' ? position
+         : separatorAfter(text, position + 1);
+  }
+  static constexpr size_t colonAfter(const char* text, size_t position) {
+    return text[position] == ':' ? position
+         : text[position] == '\0' ? rtttlErrorMissingColon()
+         : colonAfter(text, position + 1);
+  }
+
+  // Functions for reading the default settings, like "d=4,o=5,b=160".
+
+  // Returns the value of the setting called key, or fallback if there isn't one. Unknown settings are skipped.
+  static constexpr size_t setting(const char* text, size_t position, char key, size_t fallback) {
+    return text[skipSpaces(text, position)] == ':' || text[skipSpaces(text, position)] == '\0' ? fallback
+         : lower(text[skipSpaces(text, position)]) != key
+             ? setting(text, separatorAfter(text, position) + (text[separatorAfter(text, position)] == ','), key,
+                       fallback)
+         : text[skipSpaces(text, skipSpaces(text, position) + 1)] != '=' ? rtttlErrorMissingEquals()
+         : readNumber(text, skipSpaces(text, skipSpaces(text, skipSpaces(text, position) + 1) + 1));
+  }
+  static constexpr size_t nonZero(size_t tempo) { return tempo > 0 ? tempo : rtttlErrorZeroTempo(); }
+
+  // Functions for reading the note or pause at position (after any spaces), like "8c#6.".
+
+  // Everything about one note or pause.
+  struct Item {
+    // The length in 128ths of a whole note, the shortest length needed: a dotted 64th note is 3/128.
+    size_t length;
+    // The MIDI note number (see pitches.hpp), or 0 for a pause.
+    size_t pitch;
+    // The position of the next note or pause, or of the end of the text.
+    size_t next;
+  };
+
+  // A constexpr function can't have variables, so each of these reads one part of the item and passes what it has read
+  // so far on to the next one as arguments. That way nothing is read twice.
+  constexpr Item item(size_t position) const {
+    return readLetter(numberEnd(m_text, position) > position ? readNumber(m_text, position) : m_duration,
+                      numberEnd(m_text, position));
+  }
+  // letter is the position of the note's letter.
+  constexpr Item readLetter(size_t duration, size_t letter) const {
+    return readDot(duration, semitones(lower(m_text[letter])) + (m_text[letter + 1] == '#'),
+                   letter + 1 + (m_text[letter + 1] == '#'));
+  }
+  // The dot can come before or after the octave: both "c.6" and "c6." are used.
+  constexpr Item readDot(size_t duration, size_t semitone, size_t position) const {
+    return readOctave(duration, semitone, m_text[position] == '.', position + (m_text[position] == '.'));
+  }
+  constexpr Item readOctave(size_t duration, size_t semitone, bool dotted, size_t position) const {
+    return isDigit(m_text[position]) ? finish(duration, semitone, m_text[position] - '0', dotted, position + 1)
+         : finish(duration, semitone, m_octave, dotted, position);
+  }
+  constexpr Item finish(size_t duration, size_t semitone, size_t octave, bool dotted, size_t position) const {
+    return Item{lengthOf(duration, dotted || m_text[position] == '.'),
+                semitone >= PAUSE ? 0 : checkedPitch(12 * (octave + 1) + semitone),
+                nextAfter(skipSpaces(m_text, position + (m_text[position] == '.')))};
+  }
+
+  // Returns the number of semitones from C to the given letter, or PAUSE for a pause.
+  static constexpr size_t semitones(char letter) {
+    return letter == 'c' ? 0 : letter == 'd' ? 2 : letter == 'e' ? 4 : letter == 'f' ? 5 : letter == 'g' ? 7
+         : letter == 'a' ? 9 : letter == 'b' ? 11 : letter == 'p' ? PAUSE : rtttlErrorUnknownNoteLetter();
+  }
+  static constexpr size_t checkedPitch(size_t pitch) {
+    return pitch >= LOWEST_PITCH && pitch <= HIGHEST_PITCH ? pitch : rtttlErrorPitchOutOfRange();
+  }
+  static constexpr size_t lengthOf(size_t duration, bool dotted) {
+    return (duration == 1 || duration == 2 || duration == 4 || duration == 8 || duration == 16 || duration == 32
+            || duration == 64 ? 128 / duration : rtttlErrorInvalidDuration())
+           * (dotted ? 3 : 2) / 2;
+  }
+  // end is the position just past the item and any spaces after it.
+  constexpr size_t nextAfter(size_t end) const {
+    return m_text[end] == ',' ? skipSpaces(m_text, end + 1)
+         : m_text[end] == '\0' ? end
+         : rtttlErrorUnexpectedCharacter();
+  }
+
+  // A quarter note lasts 60000 / m_tempo milliseconds, so a 128th lasts 60000 / (32 * m_tempo) = 1875 / m_tempo. The
+  // offset is in 256ths of a millisecond (see Note::m_offset). Each time is rounded to the nearest unit on its own, so
+  // rounding errors don't add up over the melody.
+  constexpr unsigned long long offsetAt(unsigned long long start) const {
+    return (start * 1875 * 256 + m_tempo / 2) / m_tempo <= 0xFFFFFFFFULL
+               ? (start * 1875 * 256 + m_tempo / 2) / m_tempo
+               : rtttlErrorMelodyTooLong();
+  }
+  constexpr unsigned long long soundingTime(unsigned long long length) const {
+    return (length * 1875 * RTTTL_ARTICULATION + 50 * m_tempo) / (100 * m_tempo) <= 0xFFFF
+               ? (length * 1875 * RTTTL_ARTICULATION + 50 * m_tempo) / (100 * m_tempo)
+               : rtttlErrorNoteTooLong();
+  }
+
+  // Functions for walking through the notes. Calling item() again with the same position is cheap: the compiler
+  // remembers the results of constexpr calls.
+
+  constexpr size_t countFrom(size_t position) const {
+    return m_text[position] == '\0' ? 0 : (item(position).pitch != 0) + countFrom(item(position).next);
+  }
+  // Moves place past any pauses, to the next note or the end of the text.
+  constexpr Place skipPauses(Place place) const {
+    return m_text[place.position] != '\0' && item(place.position).pitch == 0
+               ? skipPauses(Place{item(place.position).next, place.start + item(place.position).length})
+               : place;
+  }
+
+  // Larger than any number of semitones, so that semitones() can return it for a pause.
+  static constexpr size_t PAUSE = 0xFF;
+
+  const char* m_text;
+  size_t m_notesStart;
+  size_t m_duration;
+  size_t m_octave;
+  size_t m_tempo;
+
+};
+
+/// Returns the number of notes in the given ringtone, not counting pauses.
+constexpr size_t rtttlNoteCount(const char* text) { return RtttlNotes(text).count(); }
+
+// Melody's constexpr constructor asks for the notes by index, but finding a note in the text means reading every note
+// before it, so asking for each one separately would read the text over and over. Instead, RtttlBuilder reads the
+// notes in order, once, collecting them as arguments: build() for Remaining notes adds the note at place to the
+// notes done so far, and calls build() for Remaining - 1 with the place after it. Once none remain, the collected
+// notes are put in a NoteList and passed to Melody's constexpr constructor.
+/// Notes stored in order, which is a Generator for Melody's constexpr constructor (see melody.hpp).
+template <size_t N>
+struct NoteList {
+  Note notes[N];
+  constexpr Note note(size_t index) const { return notes[index]; }
+};
+
+/// Builds a Melody<N> from an RTTTL ringtone with Remaining notes left to read.
+template <size_t N, size_t Remaining>
+struct RtttlBuilder {
+  // "Notes..." is any number of arguments, each of its own type (always Note here).
+  template <typename... Notes>
+  static constexpr Melody<N> build(const RtttlNotes& rtttl, RtttlNotes::Place place, Notes... done) {
+    return RtttlBuilder<N, Remaining - 1>::build(rtttl, rtttl.after(place), done..., rtttl.noteAt(place));
+  }
+};
+// This "partial specialization" is used instead of the one above when no notes remain.
+template <size_t N>
+struct RtttlBuilder<N, 0> {
+  template <typename... Notes>
+  static constexpr Melody<N> build(const RtttlNotes&, RtttlNotes::Place, Notes... done) {
+    return Melody<N>(NoteList<N>{{done...}});
+  }
+};
+
+/// Returns the notes of the given ringtone as a melody. N must be rtttlNoteCount(text): use RTTTL_MELODY() instead.
+template <size_t N>
+constexpr Melody<N> rtttlMelody(const char* text) {
+  return RtttlBuilder<N, N>::build(RtttlNotes(text), RtttlNotes(text).first());
+}
+
+// A macro is replaced by its definition before the code is compiled, so this saves writing the text twice (once to
+// count the notes for the template argument and once to read them). "auto" lets the compiler work out the type:
+//
+//   constexpr auto TETRIS = RTTTL_MELODY("tetris:d=4,o=5,b=160:e6,8b,8c6,8d6,16e6,16d6,8c6,8b,a,8a,8c6,e6");
+//   playMelody(8, TETRIS);
+//
+// Without the constexpr, the compiler doesn't have to read the text while compiling (though it usually does), and
+// mistakes in it are only found when the program is linked, as "undefined reference to rtttlError...()".
+/// Returns the notes of the given RTTTL ringtone (a string literal) as a Melody.
+#define RTTTL_MELODY(text) rtttlMelody<rtttlNoteCount(text)>(text)
+
+#endif /* RTTTL_HPP */
@@ -0,0 +1,82 @@
+/// Defines a tiny cooperative scheduler for running several tasks (such as melody playback) side by side.
+
+// See note.hpp for an explanation of header guards.
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+// The scheduler is "cooperative": it never interrupts a task. Instead, each task does a small amount of work when it
+// is run and then returns, telling the scheduler when it wants to run again (its deadline). The scheduler always runs
+// the task with the earliest deadline first. This only works if every task is quick, so tasks must never call delay().
+//
+// Nothing here uses new or malloc(). The tasks live in a fixed-size table and the run queue is a fixed-size array of
+// table positions kept sorted by deadline. On an Arduino with 2 KB of RAM, memory that's reserved when the program is
+// compiled is much safer than memory that's requested while it runs.
+
+// "typedef" gives a type a new, shorter name. This one names a pointer to a function: any function that takes a
+// void*, an unsigned long, and a reference to an unsigned long and returns a bool can be stored in a TaskFunction.
+// The void* ("pointer to anything") lets each task receive its own data, such as the MelodyPlayer it should update.
+/// A task function. It is passed its context pointer and the current time in microseconds. It returns false when the
+/// task is finished, or true after storing the time (in microseconds) at which it wants to run next in nextRun.
+typedef bool (*TaskFunction)(void* context, unsigned long now, unsigned long& nextRun);
+
+/// Returned by Scheduler::addTask() when there's no room left in the task table.
+const uint8_t NO_TASK = 0xFF;
+
+// See melody.hpp for an explanation of templates. MaxTasks sets the size of the task table, so a scheduler that
+// only needs three tasks only uses memory for three.
+/// Runs up to MaxTasks tasks in order of their deadlines and records how late each task was run.
+template <size_t MaxTasks>
+struct Scheduler {
+
+  /// Constructs a new scheduler with no tasks.
+  Scheduler();
+
+  /// Adds a task that first runs at the given time (in microseconds). Returns an ID for the task, or NO_TASK if the
+  /// task table is full. The name is only used by printReport(), and must stay valid while the scheduler is used.
+  uint8_t addTask(const char* name, TaskFunction function, void* context, unsigned long firstRun);
+
+  /// Runs the task with the earliest deadline if that deadline has been reached. Returns true if a task was run.
+  bool runNext();
+
+  /// Returns true if any task is still waiting to run.
+  bool hasTasks() const { return m_queueLength > 0; }
+
+  /// Returns the deadline of the next task to run. Only meaningful when hasTasks() is true.
+  unsigned long nextDeadline() const { return m_tasks[m_queue[0]].deadline; }
+
+  /// Returns the largest delay (in microseconds) between the given task's deadline and when it actually ran.
+  unsigned long worstLatency(uint8_t taskId) const { return m_tasks[taskId].worstLatency; }
+
+  /// Returns the longest time (in microseconds) the given task took to run once.
+  unsigned long worstRunTime(uint8_t taskId) const { return m_tasks[taskId].worstRunTime; }
+
+  /// Prints the number of runs, the worst latency, and the worst run time of every task to Serial.
+  void printReport() const;
+
+private:
+
+  // A struct can be declared inside another struct. Nothing outside of Scheduler needs to know about Task.
+  struct Task {
+    const char* name;
+    TaskFunction function;
+    void* context;
+    unsigned long deadline;
+    unsigned long worstLatency;
+    unsigned long worstRunTime;
+    unsigned long runs;
+  };
+
+  // Puts the given task into the run queue at the position that keeps the queue sorted by deadline.
+  void enqueue(uint8_t taskId);
+
+  Task m_tasks[MaxTasks];
+  size_t m_taskCount;
+
+  // Positions of tasks in m_tasks, sorted so that the earliest deadline is at the front. A finished task is simply
+  // not put back into the queue.
+  uint8_t m_queue[MaxTasks];
+  size_t m_queueLength;
+
+};
+
+#endif /* SCHEDULER_HPP */
@@ -0,0 +1,87 @@
+// Implementations for the things declared in scheduler.hpp. See melody.ino for an explanation of why they're
+// separated.
+#include "scheduler.hpp"
+
+template <size_t MaxTasks>
+Scheduler<MaxTasks>::Scheduler() : m_taskCount(0), m_queueLength(0) {}
+
+template <size_t MaxTasks>
+uint8_t Scheduler<MaxTasks>::addTask(const char* name, TaskFunction function, void* context, unsigned long firstRun) {
+  if (m_taskCount >= MaxTasks) {
+    return NO_TASK;
+  }
+  uint8_t taskId = m_taskCount++;
+  // This syntax (a type followed by values in braces) creates a Task with each member set in order of declaration.
+  m_tasks[taskId] = Task{name, function, context, firstRun, 0, 0, 0};
+  enqueue(taskId);
+  return taskId;
+}
+
+template <size_t MaxTasks>
+void Scheduler<MaxTasks>::enqueue(uint8_t taskId) {
+  // This is a single step of insertion sort: starting from the back of the queue,
+  // every task with a later deadline is moved back one place until the right spot for the new task is found. The queue
+  // is already sorted, so this is all that's needed to keep it sorted.
+  // See player.ino for why times are compared by subtracting them and reading the result as a signed number.
+  unsigned long deadline = m_tasks[taskId].deadline;
+  size_t i = m_queueLength;
+  while (i > 0 && (long)(m_tasks[m_queue[i - 1]].deadline - deadline) > 0) {
+    m_queue[i] = m_queue[i - 1];
+    i--;
+  }
+  m_queue[i] = taskId;
+  m_queueLength++;
+}
+
+template <size_t MaxTasks>
+bool Scheduler<MaxTasks>::runNext() {
+  if (m_queueLength == 0) {
+    return false;
+  }
+  unsigned long now = micros();
+  uint8_t taskId = m_queue[0];
+  Task& task = m_tasks[taskId];
+  if ((long)(now - task.deadline) < 0) {
+    // The earliest deadline hasn't been reached yet, so no other task is due either.
+    return false;
+  }
+
+  // Take the task off the front of the queue before running it.
+  for (size_t i = 1; i < m_queueLength; i++) {
+    m_queue[i - 1] = m_queue[i];
+  }
+  m_queueLength--;
+
+  // The latency is how long after its deadline the task actually started. For the melody task, this is exactly how
+  // late a note was played, so it's the number to check to make sure other tasks aren't disturbing the music.
+  unsigned long latency = now - task.deadline;
+  if (latency > task.worstLatency) {
+    task.worstLatency = latency;
+  }
+  task.runs++;
+
+  bool keepRunning = task.function(task.context, now, task.deadline);
+
+  unsigned long runTime = micros() - now;
+  if (runTime > task.worstRunTime) {
+    task.worstRunTime = runTime;
+  }
+  if (keepRunning) {
+    enqueue(taskId);
+  }
+  return true;
+}
+
+template <size_t MaxTasks>
+void Scheduler<MaxTasks>::printReport() const {
+  for (size_t i = 0; i < m_taskCount; i++) {
+    Serial.print(m_tasks[i].name);
+    Serial.print(": runs=");
+    Serial.print(m_tasks[i].runs);
+    Serial.print(" worst latency=");
+    Serial.print(m_tasks[i].worstLatency);
+    Serial.print("us worst run time=");
+    Serial.print(m_tasks[i].worstRunTime);
+    Serial.println("us");
+  }
+}
@@ -0,0 +1,102 @@
+/// Defines melodies made of sections that can be repeated, like repeat signs and first and second endings in a score.
+
+// See note.hpp for an explanation of header guards.
+#ifndef SECTIONS_HPP
+#define SECTIONS_HPP
+
+#include "note.hpp"
+
+// Sheet music rarely writes a verse out three times. It writes it once between repeat signs, and marks the bars that
+// change with numbered brackets called voltas (first and second endings): "play bar 8 the first two times, and bar 9
+// the third time". D.C. ("from the beginning") and D.S. ("from the sign") work the same way on a larger scale.
+//
+// A SectionMelody keeps that structure. Its notes are stored once, split into sections, and a table of sections says
+// in which order to play them:
+//
+//   * A notes section plays some of the notes. Their offsets are measured from the start of the section, so the same
+//     notes can be played at different times in the song.
+//   * A loop plays the sections right after it (its body) a number of times. Each time through is called a pass.
+//   * Every entry has a passes mask saying on which passes of the loop around it the entry plays. That's how voltas
+//     work: the first ending's mask is 0b01 and the second ending's is 0b10. Entries outside any loop are on the first
+//     (and only) pass of the song itself, so they use bit 0.
+//
+// melody_creator writes these tables from MusicXML files (see melody_creator/melody_creator/sections.py).
+
+/// A passes mask that plays an entry on every pass.
+const uint8_t ALL_PASSES = 0xFF;
+
+/// The most loops that can be in progress at once, including the song itself.
+const uint8_t MAX_LOOP_DEPTH = 4;
+
+/// One entry of a section table: either some notes or a loop.
+struct Section {
+  /// For notes, the position of the first note in the melody's notes. For a loop, the number of entries in its body.
+  uint16_t first;
+  /// For notes, the number of notes. Unused for loops.
+  uint16_t count;
+  /// For notes, the time in 256ths of a millisecond (see Note::m_offset) from the start of the section to the start of
+  /// whatever plays after it. Unused for loops.
+  uint32_t length;
+  /// For a loop, how many times to play its body. 0 for notes.
+  uint8_t times;
+  /// On which passes of the enclosing loop this entry plays: bit 0 for the first pass, bit 1 for the second, and so
+  /// on. Passes after the eighth use bit 7.
+  uint8_t passes;
+};
+
+// Like PhraseMelody (see phrase.hpp), this is an aggregate, so it can be written as a list in braces.
+/// A melody stored as a table of sections.
+struct SectionMelody {
+  /// Every note, written out once. Offsets are from the start of the note's section.
+  const Note* notes;
+  /// The section table.
+  const Section* sections;
+  /// The number of entries in the section table.
+  uint8_t sectionCount;
+};
+
+// Walking the table needs one frame per loop in progress: where its body starts and ends, which pass it's on, and how
+// many passes it has. That's 4 bytes per loop, so a song with a verse played three times costs the memory of one verse
+// plus a few bytes, instead of three verses.
+/// Plays the sections of a SectionMelody in order, one note at a time. Can be used as a source for StreamPlayer (see
+/// stream_player.hpp).
+struct SectionStream {
+
+  /// Constructs a stream that plays the given melody from the beginning.
+  explicit SectionStream(const SectionMelody& melody);
+
+  /// Goes back to the beginning of the melody.
+  void rewind();
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  struct Frame {
+    // The positions in the section table of the first entry of the body and of the entry after the body.
+    uint8_t start;
+    uint8_t end;
+    uint8_t pass;
+    uint8_t times;
+  };
+
+  // Returns true if the given entry plays on the current pass of the innermost loop.
+  bool playsNow(const Section& section) const;
+
+  const SectionMelody& m_melody;
+  Frame m_stack[MAX_LOOP_DEPTH];
+  uint8_t m_depth;
+  // The position in the section table of the next entry.
+  uint8_t m_entry;
+  // The position in m_melody.notes of the next note of the current section, and how many of its notes are left.
+  uint16_t m_note;
+  uint16_t m_remaining;
+  // When (in 256ths of a millisecond from the start of the song) the current section started, and when the next one
+  // starts. Sections can start part of the way through a millisecond, just like notes.
+  unsigned long m_sectionStart;
+  unsigned long m_nextStart;
+
+};
+
+#endif /* SECTIONS_HPP */
@@ -0,0 +1,76 @@
+// Implementations for the things declared in sections.hpp. See melody.ino for an explanation of why they're separated.
+#include "sections.hpp"
+
+SectionStream::SectionStream(const SectionMelody& melody)
+  : m_melody(melody), m_depth(0), m_entry(0), m_note(0), m_remaining(0), m_sectionStart(0), m_nextStart(0) {
+  rewind();
+}
+
+void SectionStream::rewind() {
+  // The song itself is the bottom frame: a loop over the whole table that's played once.
+  m_stack[0].start = 0;
+  m_stack[0].end = m_melody.sectionCount;
+  m_stack[0].pass = 0;
+  m_stack[0].times = 1;
+  m_depth = 1;
+  m_entry = 0;
+  m_remaining = 0;
+  m_sectionStart = 0;
+  m_nextStart = 0;
+}
+
+bool SectionStream::playsNow(const Section& section) const {
+  uint8_t pass = m_stack[m_depth - 1].pass;
+  return (section.passes >> (pass < 7 ? pass : 7)) & 1;
+}
+
+bool SectionStream::next(Note& note) {
+  while (m_remaining == 0) {
+    if (m_depth == 0) {
+      return false;
+    }
+    Frame& loop = m_stack[m_depth - 1];
+    if (m_entry == loop.end) {
+      // The end of the body: go around again, or pop the loop and carry on with the entry after it (which is
+      // loop.end, so m_entry is already right).
+      if (++loop.pass < loop.times) {
+        m_entry = loop.start;
+      } else {
+        m_depth--;
+      }
+      continue;
+    }
+
+    const Section& section = m_melody.sections[m_entry];
+    if (!playsNow(section)) {
+      // Skip the entry, and for a loop, its whole body too.
+      m_entry += section.times > 0 ? 1 + section.first : 1;
+      continue;
+    }
+    if (section.times > 0) {
+      if (m_depth == MAX_LOOP_DEPTH) {
+        // melody_creator never writes tables like this. Playing the body once keeps the rest of the song going.
+        Serial.println("ERROR: Loops nested too deeply");
+        m_entry++;
+        continue;
+      }
+      Frame& inner = m_stack[m_depth++];
+      inner.start = m_entry + 1;
+      inner.end = m_entry + 1 + section.first;
+      inner.pass = 0;
+      inner.times = section.times;
+      m_entry++;
+      continue;
+    }
+    m_note = section.first;
+    m_remaining = section.count;
+    m_sectionStart = m_nextStart;
+    m_nextStart += section.length;
+    m_entry++;
+  }
+
+  const Note& written = m_melody.notes[m_note++];
+  m_remaining--;
+  note = Note(FixedPointOffset(), written.frequency(), m_sectionStart + written.fixedPointOffset(), written.duration());
+  return true;
+}
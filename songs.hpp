@@ -6,6 +6,10 @@
 
 // To define Melody objects, we need to include the place where they're declared: melody.hpp.
 #include "melody.hpp"
+// rtttl.hpp lets a melody be written as a ringtone instead of note by note, and compose.hpp lets it be built out of
+// other melodies (see the end of this file).
+#include "compose.hpp"
+#include "rtttl.hpp"
 
 // I've commented some out to avoid consuming unnecessary additional memory.
 // const Melody<29> GOOD_OLD_SONG = {{
@@ -129,8 +133,9 @@
 // constructor is an array, it's easy to use another initializer list to initialize that array as well. This causes the
 // double braces. The notes themselves are initialized similarly.
 // The left side features the use of the Melody template struct, which is created with argument 45 because there are 45
-// notes.
-const Melody<45> THRILLER = {{
+// notes. constexpr (instead of const) means the compiler works out the whole melody while compiling, which also lets it
+// be used to build other melodies (see compose.hpp).
+constexpr Melody<45> THRILLER = {{
   {415, 250, 142},
   {494, 500, 142},
   {415, 750, 142},
@@ -178,4 +183,12 @@ const Melody<45> THRILLER = {{
   {554, 17000, 1458}
 }};
 
+// The compiler turns this ringtone into exactly the same kind of Melody as the ones above, so playing it costs no more
+// than playing THRILLER. A mistake in the text is a compiler error (see rtttl.hpp).
+// constexpr auto TETRIS = RTTTL_MELODY("tetris:d=4,o=5,b=160:e6,8b,8c6,8d6,16e6,16d6,8c6,8b,a,8a,8c6,e6,8d6,8c6,b,8b,"
+//                                      "8c6,d6,e6,c6,a,2a");
+
+// Variations on a song don't need to be copied and pasted either. This is THRILLER an octave higher and twice as fast.
+// constexpr auto THRILLER_REMIX = timeStretch(transpose(THRILLER, 12), 1, 2);
+
 #endif /* SONGS_HPP */
\ No newline at end of file
@@ -0,0 +1,59 @@
+/// Defines a player for melodies whose notes are produced one at a time, e.g. read from an SD card.
+
+// See note.hpp for an explanation of header guards.
+#ifndef STREAM_PLAYER_HPP
+#define STREAM_PLAYER_HPP
+
+#include "note.hpp"
+#include "backend.hpp"
+
+// MelodyPlayer (see player.hpp) needs every note of a melody to be in memory at once. StreamPlayer only ever holds the
+// next note. It asks a "source" for notes one at a time, right after playing the previous one, so the source has the
+// whole gap between two notes to get the next one ready.
+//
+// A source can be any type with this member function:
+//
+//   bool next(Note& note);  // Stores the next note (in order of offset) in note, or returns false if there are no more.
+//
+// Because Source is a template parameter, the compiler knows exactly which next() to call, so using a source costs no
+// more than calling the function directly. The notes are played on a backend (see backend.hpp) the same way, which is
+// tone() unless another one is given: StreamPlayer<PoolStream, TimerBackend> plays on Timer1 instead.
+/// Plays the notes produced by a source on a backend without blocking.
+template <typename Source, typename Backend = ToneBackend>
+struct StreamPlayer {
+
+  // A pin number works as the backend too, since it turns into a ToneBackend by itself.
+  /// Constructs a new player that plays notes from the given source on (a copy of) the given backend.
+  StreamPlayer(Source& source, const Backend& backend);
+
+  /// Starts playing. The first note plays at the given time (in microseconds) plus its offset.
+  void start(unsigned long now);
+
+  /// Returns true if the player still has notes to play (or a note to finish).
+  bool isPlaying() const { return m_playing; }
+
+  /// Plays the next note if it's due. Returns false once the melody is over; otherwise stores the time of the next note
+  /// event in nextEvent.
+  bool update(unsigned long now, unsigned long& nextEvent);
+
+  /// Task adapter for Scheduler (see scheduler.hpp): context must point to a StreamPlayer<Source, Backend>.
+  static bool task(void* context, unsigned long now, unsigned long& nextRun);
+
+private:
+
+  // Notes can start part of the way through a millisecond (see note.hpp), so they're scheduled in microseconds.
+  unsigned long startOf(const Note& note) const { return m_startTime + note.offsetMicros(); }
+
+  Source& m_source;
+  Backend m_backend;
+  // The next note to play, if m_hasNext is true.
+  Note m_next;
+  bool m_hasNext;
+  bool m_playing;
+  unsigned long m_startTime;
+  // The latest end (see endMicros() in note.hpp) of the notes played so far, in microseconds from the start.
+  unsigned long m_endMicros;
+
+};
+
+#endif /* STREAM_PLAYER_HPP */
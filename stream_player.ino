@@ -0,0 +1,48 @@
+// Implementations for the things declared in stream_player.hpp. See melody.ino for an explanation of why they're
+// separated.
+#include "stream_player.hpp"
+
+template <typename Source, typename Backend>
+StreamPlayer<Source, Backend>::StreamPlayer(Source& source, const Backend& backend)
+  : m_source(source), m_backend(backend), m_hasNext(false), m_playing(false), m_startTime(0), m_endMicros(0) {}
+
+template <typename Source, typename Backend>
+void StreamPlayer<Source, Backend>::start(unsigned long now) {
+  m_startTime = now;
+  m_endMicros = 0;
+  m_hasNext = m_source.next(m_next);
+  m_playing = m_hasNext;
+}
+
+template <typename Source, typename Backend>
+bool StreamPlayer<Source, Backend>::update(unsigned long now, unsigned long& nextEvent) {
+  if (!m_playing) {
+    return false;
+  }
+  // See player.ino for why times are compared this way.
+  if (m_hasNext && (long)(now - startOf(m_next)) >= 0) {
+    m_backend.play(m_next.frequency(), m_next.duration());
+    if (m_next.endMicros() > m_endMicros) {
+      m_endMicros = m_next.endMicros();
+    }
+    // The note has just started, so now is the best time to get the next one: it has until that note is due.
+    m_hasNext = m_source.next(m_next);
+  }
+
+  if (m_hasNext) {
+    nextEvent = startOf(m_next);
+    return true;
+  }
+  if ((long)(now - (m_startTime + m_endMicros)) >= 0) {
+    m_backend.stop();
+    m_playing = false;
+    return false;
+  }
+  nextEvent = m_startTime + m_endMicros;
+  return true;
+}
+
+template <typename Source, typename Backend>
+bool StreamPlayer<Source, Backend>::task(void* context, unsigned long now, unsigned long& nextRun) {
+  return static_cast<StreamPlayer<Source, Backend>*>(context)->update(now, nextRun);
+}
@@ -0,0 +1,91 @@
+/// Defines melodies timed in musical ticks instead of milliseconds, so that their tempo can change while they play.
+
+// See note.hpp for an explanation of header guards.
+#ifndef TICKS_HPP
+#define TICKS_HPP
+
+#include "note.hpp"
+
+// A Melody stores times in milliseconds, which means the tempo is baked into every note: playing it faster means
+// changing every number. Music itself counts in beats, so a TickMelody does too. A quarter note is TICKS_PER_QUARTER
+// ticks (an eighth is 48, a triplet eighth is 32, and so on), and a separate list of tempo changes says how fast the
+// ticks go. Changing the tempo, even in the middle of a song, only changes how ticks are turned into time.
+//
+// Turning ticks into microseconds needs the length of a tick, which is 60,000,000 / (beats per minute * 96) = 625,000 /
+// beats per minute microseconds. Dividing is slow on an Arduino, so the length of a tick is worked out once per tempo
+// as a fixed-point number: a whole number of microseconds in the upper 16 bits and the fraction of a microsecond (in
+// 65536ths) in the lower 16 bits. After that, every conversion is just multiplications and a shift.
+
+/// The number of ticks in a quarter note (pulses per quarter note, or PPQN).
+const uint8_t TICKS_PER_QUARTER = 96;
+
+/// The slowest tempo a tick multiplier can represent, in quarter notes per minute.
+const uint16_t MIN_TICK_TEMPO = 10;
+
+/// A note timed in ticks.
+struct TickNote {
+  /// The pitch of the note as a frequency in Hertz.
+  uint16_t frequency;
+  /// The number of ticks from the start of the previous note to the start of this one.
+  uint16_t delta;
+  /// The number of ticks the note sounds for.
+  uint16_t duration;
+};
+
+/// A change of tempo.
+struct TempoChange {
+  /// When the change happens, in ticks from the start of the song.
+  uint32_t tick;
+  /// The new tempo, in quarter notes per minute.
+  uint16_t beatsPerMinute;
+};
+
+// An aggregate, like PhraseMelody (see phrase.hpp).
+/// A melody timed in ticks, with a list of tempo changes.
+struct TickMelody {
+  const TickNote* notes;
+  uint16_t noteCount;
+  /// The tempo changes, sorted by tick. Before the first one (or if there are none) the tempo is 120.
+  const TempoChange* tempos;
+  uint8_t tempoCount;
+};
+
+/// Returns the length of a tick at the given tempo (in quarter notes per minute), in 65536ths of a microsecond.
+uint32_t tickMultiplier(uint16_t beatsPerMinute);
+
+/// Converts a number of ticks to microseconds using a multiplier from tickMultiplier().
+inline unsigned long ticksToMicros(uint16_t ticks, uint32_t multiplier) {
+  // ticks * multiplier could need 48 bits, so the whole and fractional parts are multiplied separately. Neither
+  // product can be bigger than 32 bits. Adding 0x8000 (half of 65536) rounds the fraction to the nearest microsecond.
+  return ticks * (multiplier >> 16) + (((uint32_t)ticks * (multiplier & 0xFFFF) + 0x8000) >> 16);
+}
+
+/// Turns a TickMelody into notes (in milliseconds) one at a time. Can be used as a source for StreamPlayer (see
+/// stream_player.hpp).
+struct TickStream {
+
+  /// Constructs a stream that plays the given melody from the beginning.
+  explicit TickStream(const TickMelody& melody);
+
+  /// Goes back to the beginning of the melody.
+  void rewind();
+
+  /// Changes the tempo from the next note on, until the melody's next tempo change.
+  void setTempo(uint16_t beatsPerMinute) { m_multiplier = tickMultiplier(beatsPerMinute); }
+
+  /// Stores the next note in note, or returns false if there are no more. See stream_player.hpp.
+  bool next(Note& note);
+
+private:
+
+  const TickMelody& m_melody;
+  uint16_t m_nextNote;
+  uint8_t m_nextTempo;
+  uint32_t m_multiplier;
+  // The position of the latest note in ticks, and its time in microseconds.
+  uint32_t m_tick;
+  unsigned long m_time;
+
+};
+
+#endif /* TICKS_HPP */
@@ -0,0 +1,49 @@
+// Implementations for the things declared in ticks.hpp. See melody.ino for an explanation of why they're separated.
+#include "ticks.hpp"
+
+uint32_t tickMultiplier(uint16_t beatsPerMinute) {
+  if (beatsPerMinute < MIN_TICK_TEMPO) {
+    beatsPerMinute = MIN_TICK_TEMPO;
+  }
+  // 625000 << 16 doesn't fit in 32 bits, so the whole microseconds and the fraction are worked out separately. The
+  // remainder is less than beatsPerMinute, so shifting it by 16 fits.
+  uint32_t whole = 625000UL / beatsPerMinute;
+  uint32_t remainder = 625000UL % beatsPerMinute;
+  return whole << 16 | (remainder << 16) / beatsPerMinute;
+}
+
+TickStream::TickStream(const TickMelody& melody) : m_melody(melody) {
+  rewind();
+}
+
+void TickStream::rewind() {
+  m_nextNote = 0;
+  m_nextTempo = 0;
+  m_multiplier = tickMultiplier(120);
+  m_tick = 0;
+  m_time = 0;
+}
+
+bool TickStream::next(Note& note) {
+  if (m_nextNote >= m_melody.noteCount) {
+    return false;
+  }
+  const TickNote& tickNote = m_melody.notes[m_nextNote++];
+  uint32_t target = m_tick + tickNote.delta;
+  // Move forward to the note one tempo at a time: each part of the gap between notes is converted at the tempo in
+  // effect during it.
+  while (m_nextTempo < m_melody.tempoCount && m_melody.tempos[m_nextTempo].tick <= target) {
+    const TempoChange& change = m_melody.tempos[m_nextTempo++];
+    if (change.tick > m_tick) {
+      m_time += ticksToMicros(change.tick - m_tick, m_multiplier);
+      m_tick = change.tick;
+    }
+    m_multiplier = tickMultiplier(change.beatsPerMinute);
+  }
+  m_time += ticksToMicros(target - m_tick, m_multiplier);
+  m_tick = target;
+  // The offset keeps its fraction of a millisecond (see note.hpp). Adding 500 before dividing by 1000 rounds the
+  // duration to the nearest millisecond, since tone() can't play anything shorter.
+  note = noteAtMicros(tickNote.frequency, m_time, (ticksToMicros(tickNote.duration, m_multiplier) + 500) / 1000);
+  return true;
+}
@@ -0,0 +1,80 @@
+/// Defines tunings, which turn the MIDI note numbers of phrases, bytecode, and live MIDI into frequencies.
+
+// See note.hpp for an explanation of header guards.
+#ifndef TUNING_HPP
+#define TUNING_HPP
+
+// pitches.hpp tunes every note the same way: 12-tone equal temperament, where each semitone is exactly the same step.
+// That's the tuning pianos use, but it isn't the only one. In just intonation, the notes of a scale are whole-number
+// ratios of its first note (a fifth is exactly 3/2 of it, a major third exactly 5/4), which makes chords and arpeggios
+// in that key ring more sweetly, at the cost of sounding worse in other keys. Other tunings split the octave into more
+// than 12 steps, like the quarter tones of Arabic and Turkish music, or 19 or 31 equal steps.
+//
+// The melodies that store MIDI note numbers instead of frequencies (a PhraseMelody, bytecode, and a LiveInstrument)
+// only say which step of which octave a note is: number 60 is step 0 (C) of octave 4. A Tuning turns that into a
+// frequency while the melody plays, so switching tunings with setTuning() changes the very next note, and the melodies
+// stay exactly as small as they were. In a tuning with more than 12 steps per octave, a note number is still the octave
+// (+ 1) times the steps per octave plus the step, and transposing a phrase moves it by steps instead of semitones.
+//
+// A tuning is a table of the frequencies of one octave's steps, in order from C. Each octave down is half of the one
+// above, so the table holds the top octave (C8 and up) and a lower note is the table entry divided by 2 once for each
+// octave it's below. Dividing by a power of 2 is a shift, which is fast even on an Arduino. The entries are in
+// quarters of a Hertz, which keeps the frequencies a few octaves down exact to well under 1 Hz.
+//
+// melody_creator prints tables for any equal temperament, for just intonation in any key, and for scales from Scala
+// files (see melody_creator/melody_creator/tuning.py).
+
+/// The octave (with C4 as middle C) whose frequencies a tuning's table holds.
+const uint8_t TUNING_TOP_OCTAVE = 8;
+/// How many bits of a tuning's table entries are below the point: the entries are in quarters of a Hertz.
+const uint8_t TUNING_FRACTION_BITS = 2;
+
+/// A way of tuning the notes of every octave.
+struct Tuning {
+  /// The frequency of each step of the top octave, from C8 up, in quarters of a Hertz.
+  const uint16_t* steps;
+  /// How many steps there are per octave (12 for the usual scales).
+  uint8_t size;
+
+  /// Returns the frequency in Hertz of the given note number.
+  uint16_t frequency(int pitch) const;
+};
+
+// These tables were printed by melody_creator. Of the two entries closest to each exact frequency, it picks the one
+// that rounds to the nearest Hertz in the most octaves, so EQUAL_TEMPERAMENT gives the same frequencies as pitches.hpp
+// (except for F#2, which pitches.hpp rounds up to 93 instead of down to 92).
+/// The frequencies of 12-tone equal temperament with A4 at 440 Hz, as in pitches.hpp.
+const uint16_t EQUAL_TEMPERAMENT_STEPS[12] = {
+  16744, 17739, 18795, 19912, 21096, 22351, 23679, 25087, 26579, 28159, 29834, 31609,
+};
+/// 12-tone equal temperament, the tuning of pitches.hpp. It's the tuning until setTuning() is called.
+const Tuning EQUAL_TEMPERAMENT = {EQUAL_TEMPERAMENT_STEPS, 12};
+
+// The ratios to C are 1, 16/15, 9/8, 6/5, 5/4, 4/3, 45/32, 3/2, 8/5, 5/3, 9/5, and 15/8, with C where it is in equal
+// temperament.
+/// The frequencies of 5-limit just intonation in C.
+const uint16_t JUST_INTONATION_STEPS[12] = {
+  16744, 17860, 18837, 20093, 20930, 22325, 23546, 25116, 26790, 27907, 30139, 31395,
+};
+/// Just intonation in C, which makes music in C major and A minor sound its sweetest.
+const Tuning JUST_INTONATION = {JUST_INTONATION_STEPS, 12};
+
+/// The frequencies of 24-tone equal temperament with A4 at 440 Hz.
+const uint16_t QUARTER_TONES_STEPS[24] = {
+  16744, 17235, 17739, 18259, 18795, 19345, 19912, 20495, 21096, 21714, 22351, 23005,
+  23679, 24373, 25087, 25823, 26579, 27358, 28159, 28985, 29834, 30709, 31609, 32535,
+};
+/// Quarter tones: 24 equal steps per octave, so note number 120 is C4 and 121 is a quarter tone above it.
+const Tuning QUARTER_TONES = {QUARTER_TONES_STEPS, 24};
+
+// The tuning is only read when a note starts, so switching doesn't retune a note that's already playing.
+/// Makes every melody that plays note numbers use the given tuning from its next note on. The tuning must stay alive.
+void setTuning(const Tuning& tuning);
+
+/// Returns the tuning that note numbers are played in.
+const Tuning& currentTuning();
+
+/// Returns the frequency in Hertz of the given note number in the current tuning.
+uint16_t tunedFrequency(int pitch);
+
+#endif /* TUNING_HPP */
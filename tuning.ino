@@ -0,0 +1,36 @@
+// Implementations for the things declared in tuning.hpp. See melody.ino for an explanation of why they're separated.
+#include "tuning.hpp"
+
+// The tuning note numbers are played in. It's a pointer so that switching tunings doesn't copy the table.
+const Tuning* activeTuning = &EQUAL_TEMPERAMENT;
+
+uint16_t Tuning::frequency(int pitch) const {
+  if (pitch < 0) {
+    pitch = 0;
+  }
+  // Note number 0 is in octave -1, so the octave + 1 is how many whole octaves fit below the note.
+  unsigned int octaves = pitch / size;
+  uint8_t step = pitch - octaves * size;
+  // The table entry is divided by 2 for every octave below the top one, and by 4 more to get rid of the quarters.
+  // Notes above the top octave are played in it, like pitchFrequency() moves pitches above its table to the end of it.
+  if (octaves > TUNING_TOP_OCTAVE + 1) {
+    octaves = TUNING_TOP_OCTAVE + 1;
+  }
+  uint8_t shift = TUNING_TOP_OCTAVE + 1 + TUNING_FRACTION_BITS - octaves;
+  // Shifting one bit less, adding 1, and shifting the last bit away rounds to the nearest Hertz instead of down.
+  uint16_t frequency = ((((unsigned long)steps[step] << 1) >> shift) + 1) >> 1;
+  // tone() can't play anything lower than 31 Hz.
+  return frequency < 31 ? 31 : frequency;
+}
+
+void setTuning(const Tuning& tuning) {
+  activeTuning = &tuning;
+}
+
+const Tuning& currentTuning() {
+  return *activeTuning;
+}
+
+uint16_t tunedFrequency(int pitch) {
+  return activeTuning->frequency(pitch);
+}